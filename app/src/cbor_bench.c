@@ -0,0 +1,294 @@
+// © 2025 Unit Circle Inc.
+//
+// CBOR decode benchmarks.  Enable with CONFIG_APP_CBOR_BENCH=y, results are
+// logged at startup.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "zephyr/kernel.h"
+#include "zephyr/logging/log.h"
+#include "zephyr/timing/timing.h"
+
+#include <cbor.h>
+#include <cbor_index.h>
+#include <cbor_schema.h>
+#include <cbor_view.h>
+
+#include "cbor_bench.h"
+
+LOG_MODULE_REGISTER(cbor_bench);
+
+#define BENCH_REPEAT (100)
+#define BENCH_MAX_KEYS (40)
+#define BENCH_UNPACK_KEYS (20)
+
+static uint8_t msg[1024];
+
+// Representative RPC message: n keys "k00".."kNN" with small uint values
+static size_t make_msg(size_t n) {
+  cbor_stream_t s;
+  cbor_init(&s, msg, sizeof(msg));
+  cbor_write_map(&s, n);
+  for (size_t i = 0; i < n; i++) {
+    char k[4];
+    snprintf(k, sizeof(k), "k%02u", (unsigned) i);
+    cbor_write_text(&s, k);
+    cbor_write_uint64(&s, 1000 + i);
+  }
+  return cbor_read_avail(&s);
+}
+
+static uint64_t bench_get(size_t n, size_t len) {
+  uint32_t sum = 0;
+  timing_t start = timing_counter_get();
+  for (size_t r = 0; r < BENCH_REPEAT; r++) {
+    cbor_stream_t s, map_s;
+    size_t map_n;
+    cbor_init(&s, msg, len);
+    cbor_read_map(&s, &map_s, &map_n);
+    for (size_t i = 0; i < n; i++) {
+      char k[4];
+      uint32_t u;
+      snprintf(k, sizeof(k), "k%02u", (unsigned) i);
+      if (cbor_get_uint32(&map_s, map_n, k, &u) == CBOR_ERROR_NONE) sum += u;
+    }
+  }
+  timing_t end = timing_counter_get();
+  (void) sum;
+  return timing_cycles_get(&start, &end) / BENCH_REPEAT;
+}
+
+static uint64_t bench_index_get(size_t n, size_t len) {
+  uint32_t sum = 0;
+  timing_t start = timing_counter_get();
+  for (size_t r = 0; r < BENCH_REPEAT; r++) {
+    cbor_stream_t s, map_s;
+    size_t map_n;
+    cbor_index_entry_t e[CBOR_INDEX_ENTRIES(BENCH_MAX_KEYS)];
+    cbor_index_t idx;
+    cbor_init(&s, msg, len);
+    cbor_read_map(&s, &map_s, &map_n);
+    cbor_index_map(&idx, e, sizeof(e)/sizeof(e[0]), &map_s, map_n);
+    for (size_t i = 0; i < n; i++) {
+      char k[4];
+      uint32_t u;
+      snprintf(k, sizeof(k), "k%02u", (unsigned) i);
+      if (cbor_index_get_uint32(&idx, k, &u) == CBOR_ERROR_NONE) sum += u;
+    }
+  }
+  timing_t end = timing_counter_get();
+  (void) sum;
+  return timing_cycles_get(&start, &end) / BENCH_REPEAT;
+}
+
+// Unpack the last BENCH_UNPACK_KEYS keys of the message (worst case for a
+// linear search), or index the map and get the same keys from the index
+#define K(n) ".k" #n ":I"
+#define U(i) &u[i], &u[i + 1], &u[i + 2], &u[i + 3], &u[i + 4]
+static uint64_t bench_unpack(size_t n, size_t len, bool indexed) {
+  uint32_t u[BENCH_UNPACK_KEYS];
+  const char* fmt = n == 20 ?
+    "{" K(00) "," K(01) "," K(02) "," K(03) "," K(04) "," K(05) "," K(06) ","
+        K(07) "," K(08) "," K(09) "," K(10) "," K(11) "," K(12) "," K(13) ","
+        K(14) "," K(15) "," K(16) "," K(17) "," K(18) "," K(19) "}" :
+    "{" K(20) "," K(21) "," K(22) "," K(23) "," K(24) "," K(25) "," K(26) ","
+        K(27) "," K(28) "," K(29) "," K(30) "," K(31) "," K(32) "," K(33) ","
+        K(34) "," K(35) "," K(36) "," K(37) "," K(38) "," K(39) "}";
+  cbor_index_entry_t e[CBOR_INDEX_ENTRIES(BENCH_MAX_KEYS)];
+  timing_t start = timing_counter_get();
+  for (size_t r = 0; r < BENCH_REPEAT; r++) {
+    cbor_stream_t s;
+    cbor_init(&s, msg, len);
+    if (indexed) {
+      cbor_stream_t map_s;
+      size_t map_n;
+      cbor_index_t idx;
+      cbor_read_map(&s, &map_s, &map_n);
+      cbor_index_map(&idx, e, sizeof(e)/sizeof(e[0]), &map_s, map_n);
+      for (size_t i = 0; i < BENCH_UNPACK_KEYS; i++) {
+        char k[4];
+        snprintf(k, sizeof(k), "k%02u", (unsigned) (n - BENCH_UNPACK_KEYS + i));
+        cbor_index_get_uint32(&idx, k, &u[i]);
+      }
+    }
+    else {
+      cbor_unpack(&s, fmt, U(0), U(5), U(10), U(15));
+    }
+  }
+  timing_t end = timing_counter_get();
+  return timing_cycles_get(&start, &end) / BENCH_REPEAT;
+}
+#undef U
+#undef K
+
+// Same message as a compiled schema and as a cbor_pack/unpack format.
+// Code size of each: arm-none-eabi-nm --size-sort on cbor_bench.c.obj
+// (rpc_status_pack/unpack vs cbor_pack/cbor_unpack and callees).
+#define RPC_STATUS(F) \
+  F(id, U32, 0) \
+  F(seq, U32, 0) \
+  F(temp, I32, 0) \
+  F(ok, BOOL, 0) \
+  F(name, TEXT, 16) \
+  F(data, BYTES, 32)
+
+CBOR_SCHEMA_DEFINE(rpc_status, RPC_STATUS);
+
+#define RPC_STATUS_PACK "{.id:I,.seq:I,.temp:i,.ok:?,.name:s,.data:b}"
+#define RPC_STATUS_UNPACK "{.id:I,.seq:I,.temp:i,.ok:+,.name:s,.data:b}"
+
+static uint64_t bench_schema_pack(size_t* len) {
+  static const struct rpc_status v = {
+    .id = 1234, .seq = 100000, .temp = -40, .ok = true, .name = "sensor-1",
+    .data = { .n = 20, .b = { 1, 2, 3 } },
+  };
+  cbor_stream_t s;
+  timing_t start = timing_counter_get();
+  for (size_t r = 0; r < BENCH_REPEAT; r++) {
+    cbor_init(&s, msg, sizeof(msg));
+    rpc_status_pack(&s, &v);
+  }
+  timing_t end = timing_counter_get();
+  *len = cbor_read_avail(&s);
+  return timing_cycles_get(&start, &end) / BENCH_REPEAT;
+}
+
+static uint64_t bench_fmt_pack(void) {
+  static const uint8_t data[20] = { 1, 2, 3 };
+  timing_t start = timing_counter_get();
+  for (size_t r = 0; r < BENCH_REPEAT; r++) {
+    cbor_stream_t s;
+    cbor_init(&s, msg, sizeof(msg));
+    cbor_pack(&s, RPC_STATUS_PACK, 1234, 100000, -40, true, "sensor-1", data, sizeof(data));
+  }
+  timing_t end = timing_counter_get();
+  return timing_cycles_get(&start, &end) / BENCH_REPEAT;
+}
+
+static uint64_t bench_schema_unpack(size_t len) {
+  struct rpc_status v;
+  timing_t start = timing_counter_get();
+  for (size_t r = 0; r < BENCH_REPEAT; r++) {
+    cbor_stream_t s;
+    cbor_init(&s, msg, len);
+    rpc_status_unpack(&s, &v);
+  }
+  timing_t end = timing_counter_get();
+  return timing_cycles_get(&start, &end) / BENCH_REPEAT;
+}
+
+static uint64_t bench_fmt_unpack(size_t len) {
+  uint32_t id, seq;
+  int32_t temp;
+  bool ok;
+  char name[16];
+  uint8_t data[32];
+  timing_t start = timing_counter_get();
+  for (size_t r = 0; r < BENCH_REPEAT; r++) {
+    cbor_stream_t s;
+    size_t name_n = sizeof(name);
+    size_t data_n = sizeof(data);
+    cbor_init(&s, msg, len);
+    cbor_unpack(&s, RPC_STATUS_UNPACK, &id, &seq, &temp, &ok, name, &name_n, data, &data_n);
+  }
+  timing_t end = timing_counter_get();
+  return timing_cycles_get(&start, &end) / BENCH_REPEAT;
+}
+
+// Mostly ASCII text message: BENCH_TEXT_KEYS keys "t00".."tNN" with ~50
+// byte values, one containing a multi-byte character.
+#define BENCH_TEXT_KEYS (16)
+#define BENCH_TEXT_LEN (64)
+
+static size_t make_text_msg(void) {
+  cbor_stream_t s;
+  cbor_init(&s, msg, sizeof(msg));
+  cbor_write_map(&s, BENCH_TEXT_KEYS);
+  for (size_t i = 0; i < BENCH_TEXT_KEYS; i++) {
+    char k[4];
+    char t[BENCH_TEXT_LEN + 1];
+    snprintf(k, sizeof(k), "t%02u", (unsigned) i);
+    snprintf(t, sizeof(t), "sensor %02u temperature reading %s ok status",
+             (unsigned) i, i == 3 ? "21.5\xc2\xb0" "C" : "21.5 C");
+    cbor_write_text(&s, k);
+    cbor_write_text(&s, t);
+  }
+  return cbor_read_avail(&s);
+}
+
+static uint64_t bench_text_copy(size_t len) {
+  char t[BENCH_TEXT_LEN + 1];
+  timing_t start = timing_counter_get();
+  for (size_t r = 0; r < BENCH_REPEAT; r++) {
+    cbor_stream_t s, map_s;
+    size_t map_n;
+    cbor_init(&s, msg, len);
+    cbor_read_map(&s, &map_s, &map_n);
+    for (size_t i = 0; i < BENCH_TEXT_KEYS; i++) {
+      char k[4];
+      cbor_stream_t ts;
+      size_t n;
+      snprintf(k, sizeof(k), "t%02u", (unsigned) i);
+      if ((cbor_get_text(&map_s, map_n, k, &ts, &n) == CBOR_ERROR_NONE) && (n < sizeof(t))) {
+        cbor_memmove(t, &ts, n);
+      }
+    }
+  }
+  timing_t end = timing_counter_get();
+  return timing_cycles_get(&start, &end) / BENCH_REPEAT;
+}
+
+static uint64_t bench_text_view(size_t len, bool check) {
+  size_t sum = 0;
+  timing_t start = timing_counter_get();
+  for (size_t r = 0; r < BENCH_REPEAT; r++) {
+    cbor_stream_t s, map_s;
+    size_t map_n;
+    cbor_init(&s, msg, len);
+    cbor_read_map(&s, &map_s, &map_n);
+    for (size_t i = 0; i < BENCH_TEXT_KEYS; i++) {
+      char k[4];
+      cbor_view_t v;
+      snprintf(k, sizeof(k), "t%02u", (unsigned) i);
+      if ((cbor_get_text_view(&map_s, map_n, k, &v) == CBOR_ERROR_NONE) &&
+          (!check || cbor_view_text_valid(&v))) {
+        sum += v.n;
+      }
+    }
+  }
+  timing_t end = timing_counter_get();
+  (void) sum;
+  return timing_cycles_get(&start, &end) / BENCH_REPEAT;
+}
+
+void cbor_bench(void) {
+  static const size_t sizes[] = { 8, 20, 40 };
+  timing_init();
+  timing_start();
+  for (size_t i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++) {
+    size_t n = sizes[i];
+    size_t len = make_msg(n);
+    LOG_INF("cbor map %u keys %u bytes: get %llu cycles index+get %llu cycles",
+            (unsigned) n, (unsigned) len, bench_get(n, len), bench_index_get(n, len));
+    if (n >= BENCH_UNPACK_KEYS) {
+      LOG_INF("cbor map %u keys: unpack %u keys %llu indexed %llu cycles",
+              (unsigned) n, BENCH_UNPACK_KEYS, bench_unpack(n, len, false),
+              bench_unpack(n, len, true));
+    }
+  }
+
+  size_t len;
+  uint64_t fmt_pack = bench_fmt_pack();
+  uint64_t schema_pack = bench_schema_pack(&len);
+  LOG_INF("cbor rpc_status %u bytes (max %u): pack schema %llu fmt %llu cycles",
+          (unsigned) len, (unsigned) rpc_status_max_size, schema_pack, fmt_pack);
+  LOG_INF("cbor rpc_status: unpack schema %llu fmt %llu cycles",
+          bench_schema_unpack(len), bench_fmt_unpack(len));
+
+  len = make_text_msg();
+  LOG_INF("cbor text %u keys %u bytes: get+copy %llu view %llu view+check %llu cycles",
+          BENCH_TEXT_KEYS, (unsigned) len, bench_text_copy(len), bench_text_view(len, false),
+          bench_text_view(len, true));
+  timing_stop();
+}
@@ -0,0 +1,45 @@
+// © 2025 Unit Circle Inc.
+//
+// Reliable port echo.  Enable with CONFIG_APP_FRAG_ECHO=y and run
+// scripts/logchantest.py against a LogServer started with
+// --reliable <CONFIG_APP_FRAG_ECHO_PORT>.
+//
+// Each message is held (no credits for the host) until its echo has been
+// sent, so the host can't overrun the single buffer.
+
+#include <stdint.h>
+#include "zephyr/kernel.h"
+#include "zephyr/logging/log.h"
+
+#include "frag_echo.h"
+
+LOG_MODULE_REGISTER(frag_echo);
+
+#define PORT (CONFIG_APP_FRAG_ECHO_PORT)
+
+static uint8_t buf[CONFIG_APP_FRAG_ECHO_SIZE];
+static size_t buf_n;
+
+// log_tx_frag() waits for ACKs from the log thread so can't be called from
+// the port handler
+static void echo_work_handler(struct k_work* work) {
+  (void) work;
+  if (!log_tx_frag(PORT, buf, buf_n)) {
+    LOG_WRN("echo of %u bytes failed", (unsigned) buf_n);
+  }
+  log_frag_release(PORT);
+}
+
+K_WORK_DEFINE(echo_work, echo_work_handler);
+
+static void echo_rx(const uint8_t* b, size_t n, void* ctx) {
+  (void) b;
+  (void) ctx;
+  buf_n = n;
+  log_frag_hold(PORT);
+  k_work_submit(&echo_work);
+}
+
+void frag_echo_init(void) {
+  log_frag_notify(PORT, buf, sizeof(buf), echo_rx, NULL);
+}
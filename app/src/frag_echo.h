@@ -0,0 +1,5 @@
+// © 2025 Unit Circle Inc.
+
+#pragma once
+
+void frag_echo_init(void);
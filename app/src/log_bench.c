@@ -0,0 +1,144 @@
+// © 2025 Unit Circle Inc.
+//
+// Log message cost.  Enable with CONFIG_APP_LOG_BENCH=y, results are logged
+// at startup.  Build with and without CONFIG_UC_LOG_COMPRESS to compare -
+// with it the compression ratio of the run is logged too.
+//
+// Messages are logged in batches that fit the TX ring, with a sleep between
+// batches to let the UART drain, so no message is dropped and only the
+// logging call is timed.
+//
+// First the port TX ring is overrun with TX suspended: every port send must
+// return (and fail) rather than wait for a UART that isn't draining.  And a
+// TX queue with the log's quanta must drain a short port frame queued
+// behind a max size one (ucuart_txq_pick() once gave up on the ring).
+
+#include <stdint.h>
+#include <string.h>
+#include "zephyr/kernel.h"
+#include "zephyr/logging/log.h"
+#include "zephyr/timing/timing.h"
+
+#include "log_cbor.h"
+#include "cb.h"
+#include "ucuart_txq.h"
+#include "log_bench.h"
+
+LOG_MODULE_REGISTER(log_bench);
+
+#define BENCH_BATCH (16)
+#define BENCH_BATCHES (32)
+
+// Typical sensor / state machine traffic - few arguments change between
+// messages from the same call site
+static size_t log_batch(uint32_t i) {
+  size_t n = 0;
+  for (size_t j = 0; j < BENCH_BATCH / 4; j++, i++) {
+    const char* state = i % 50 ? "idle" : "running";
+    LOG_INF("bench tick");
+    LOG_INF("bench adc %u %u %d", 1000 + (i % 7), 2048, -5 + (int) (i % 3));
+    LOG_INF("bench state %s %u", state, i);
+    LOG_INF("bench ts %llu seq %u", (unsigned long long) i * 1000, i);
+    // Pointer then arguments, strings are copied with their '\0'
+    n += 4 + (4 + 12) + (4 + strlen(state) + 1 + 4) + (4 + 8 + 4);
+  }
+  return n;
+}
+
+#define OVERRUN_PORT (5)
+#define OVERRUN_SENDS (3 * CONFIG_UC_LOG_PORT_BUF_SIZE / LOG_MAX_PACKET_SIZE + 2)
+
+static void log_overrun(void) {
+  static uint8_t m[LOG_MAX_PACKET_SIZE];
+  for (size_t i = 0; i < sizeof(m); i++) {
+    m[i] = i % 3 ? (uint8_t) i : 0;
+  }
+  uint32_t failed = 0;
+  int64_t start = k_uptime_get();
+  log_tx_suspend();
+  for (uint32_t i = 0; i < OVERRUN_SENDS; i++) {
+    log_tx(OVERRUN_PORT, m, sizeof(m));
+    failed += !log_tx_frame_(3, OVERRUN_PORT, NULL, 0, m, sizeof(m), NULL, 0);
+    log_tx_stream_t ts;
+    log_tx_begin(&ts, OVERRUN_PORT);
+    log_tx_bytes(&ts, m, sizeof(m));
+    failed += !log_tx_end(&ts);
+  }
+  log_tx_resume();
+  LOG_INF("log overrun %u sends, %u failed in %lld ms", 3 * OVERRUN_SENDS, failed,
+          k_uptime_get() - start);
+}
+
+static void txq_frame(cb_t* cb, uint8_t* f, size_t n) {
+  f[0] = 0;
+  memset(f + 1, 0x55, n);
+  f[n + 1] = 0;
+  cb_write(cb, f, n + 2);
+}
+
+static void log_txq_drain(void) {
+  static uint8_t urgent_b[64], port_b[2 * LOG_MAX_PACKET_SIZE], log_b[64];
+  static uint8_t f[LOG_MAX_PACKET_SIZE + 2];
+  cb_t urgent, port, log;
+  cb_init(&urgent, urgent_b, sizeof(urgent_b));
+  cb_init(&port, port_b, sizeof(port_b));
+  cb_init(&log, log_b, sizeof(log_b));
+  ucuart_txq_t q;
+  ucuart_txq_init(&q);
+  ucuart_txq_add(&q, &urgent, 0);
+  ucuart_txq_add(&q, &port,
+      CONFIG_UC_LOG_TX_QUANTUM * CONFIG_UC_LOG_TX_PORT_SHARE / 100);
+  ucuart_txq_add(&q, &log,
+      CONFIG_UC_LOG_TX_QUANTUM * (100 - CONFIG_UC_LOG_TX_PORT_SHARE) / 100);
+  txq_frame(&port, f, LOG_MAX_PACKET_SIZE);
+  txq_frame(&port, f, 100);
+  const uint8_t* p;
+  size_t n;
+  size_t sent = 0;
+  while ((n = ucuart_txq_peek(&q, &p)) > 0) {
+    ucuart_txq_skip(&q, n);
+    sent += n;
+  }
+  size_t left = ucuart_txq_read_avail(&q);
+  if (left != 0) {
+    LOG_ERR("log txq stranded %u bytes after %u", (unsigned) left, (unsigned) sent);
+  }
+  else {
+    LOG_INF("log txq drained %u bytes", (unsigned) sent);
+  }
+}
+
+void log_bench(void) {
+  log_overrun();
+  log_txq_drain();
+
+  uint64_t cycles = 0;
+  size_t bytes = 0;
+#if defined(CONFIG_UC_LOG_COMPRESS)
+  log_compress_stats_t before, after;
+  log_compress_stats(&before);
+#endif
+  timing_init();
+  timing_start();
+  for (uint32_t b = 0; b < BENCH_BATCHES; b++) {
+    k_sleep(K_MSEC(50));
+    timing_t start = timing_counter_get();
+    bytes += log_batch(b * BENCH_BATCH / 4);
+    timing_t end = timing_counter_get();
+    cycles += timing_cycles_get(&start, &end);
+  }
+  timing_stop();
+  k_sleep(K_MSEC(50));
+
+  uint32_t records = BENCH_BATCH * BENCH_BATCHES;
+  LOG_INF("log %u records %u bytes: %llu cycles/record %llu cycles/100 bytes",
+          records, (unsigned) bytes, cycles / records, cycles * 100 / bytes);
+#if defined(CONFIG_UC_LOG_COMPRESS)
+  log_compress_stats(&after);
+  uint32_t raw = after.raw - before.raw;
+  uint32_t sent = after.sent - before.sent;
+  LOG_INF("log compress %u keyframes %u deltas: %u -> %u bytes, ratio %u.%02u",
+          after.keyframes - before.keyframes, after.deltas - before.deltas,
+          raw, sent, raw / sent, (raw % sent) * 100 / sent);
+#endif
+}
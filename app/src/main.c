@@ -9,6 +9,22 @@
 
 #include <stdarg.h>
 
+#if defined(CONFIG_APP_CBOR_BENCH)
+#include "cbor_bench.h"
+#endif
+
+#if defined(CONFIG_APP_LOG_BENCH)
+#include "log_bench.h"
+#endif
+
+#if defined(CONFIG_APP_FRAG_ECHO)
+#include "frag_echo.h"
+#endif
+
+#if defined(CONFIG_APP_RPC_ECHO)
+#include "rpc_echo.h"
+#endif
+
 LOG_MODULE_REGISTER(main);
 
 void my_work_handler(struct k_work *work) {
@@ -43,6 +59,18 @@ int main(void) {
   LOG_WRN("warn");
   LOG_INF("info");
   LOG_DBG("debug");
+#if defined(CONFIG_APP_CBOR_BENCH)
+  cbor_bench();
+#endif
+#if defined(CONFIG_APP_LOG_BENCH)
+  log_bench();
+#endif
+#if defined(CONFIG_APP_FRAG_ECHO)
+  frag_echo_init();
+#endif
+#if defined(CONFIG_APP_RPC_ECHO)
+  rpc_echo_init();
+#endif
   //printk("xxx %s %d\n", "hello", 2);
   //LOG_PRINTK("hello\n"); // calls Z_LOG_PRINTK - can easily fake it
   timing_init();
@@ -0,0 +1,57 @@
+// © 2025 Unit Circle Inc.
+//
+// RPC latency target.  Enable with CONFIG_APP_RPC_ECHO=y and run
+// scripts/logrpcbench.py against a LogServer.
+//
+// Messages on CONFIG_APP_RPC_ECHO_PORT are echoed straight back from the
+// port handler.  A message 'L' + little endian uint32 also sets the rate
+// (LOG_INF() messages per second, 0 to stop) of a background log load, so
+// the round trip can be timed with the UART full of log output.
+
+#include <stdint.h>
+#include "zephyr/kernel.h"
+#include "zephyr/logging/log.h"
+
+#include "rpc_echo.h"
+
+LOG_MODULE_REGISTER(rpc_echo);
+
+#define PORT (CONFIG_APP_RPC_ECHO_PORT)
+
+static volatile uint32_t load_rate;
+
+static void load_thread(void* p1, void* p2, void* p3) {
+  (void) p1;
+  (void) p2;
+  (void) p3;
+  uint32_t i = 0;
+  uint32_t acc = 0;
+  while (true) {
+    uint32_t rate = load_rate;
+    if (rate == 0) {
+      acc = 0;
+      k_sleep(K_MSEC(100));
+      continue;
+    }
+    acc += rate;
+    for (; acc >= 1000; acc -= 1000) {
+      LOG_INF("load %u", i++);
+    }
+    k_sleep(K_MSEC(1));
+  }
+}
+
+K_THREAD_DEFINE(rpc_load, 1024, load_thread, NULL, NULL, NULL,
+                K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
+
+static void rpc_rx(const uint8_t* b, size_t n, void* ctx) {
+  (void) ctx;
+  if ((n == 5) && (b[0] == 'L')) {
+    load_rate = b[1] | (b[2] << 8) | (b[3] << 16) | ((uint32_t) b[4] << 24);
+  }
+  log_tx(PORT, b, n);
+}
+
+void rpc_echo_init(void) {
+  log_notify(PORT, rpc_rx, NULL);
+}
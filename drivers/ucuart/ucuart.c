@@ -42,7 +42,8 @@ struct ucuart_config {
 struct ucuart_data {
   atomic_t tx_active;
   atomic_t rx_active;
-  cb_t* tx_cb;
+  ucuart_txq_t* txq;
+  ucuart_txq_t tx_cb_q;  // txq for set_tx_cb()
   uint32_t last_error;
 
   struct k_event event;
@@ -97,12 +98,13 @@ static void uart_handler(const struct device* dev) {
 
   if (nrf_uarte_event_check(config->regs, NRF_UARTE_EVENT_TXSTOPPED)) {
     nrf_uarte_event_clear(config->regs, NRF_UARTE_EVENT_TXSTOPPED);
-    cb_skip(data->tx_cb, data->n);
+    ucuart_txq_skip(data->txq, data->n);
 
     // If there is more data then send it now
-    size_t n = cb_peek_avail(data->tx_cb);
+    const uint8_t* p;
+    size_t n = ucuart_txq_peek(data->txq, &p);
     if (n > 0) {
-      nrf_uarte_tx_buffer_set(config->regs, cb_peek(data->tx_cb), n);
+      nrf_uarte_tx_buffer_set(config->regs, p, n);
       data->n = n;
       nrf_uarte_task_trigger(config->regs, NRF_UARTE_TASK_STARTTX);
     }
@@ -144,24 +146,27 @@ static int tx_schedule(const struct device *dev, const uint8_t* prefix, size_t p
   const struct ucuart_config * config = ZEPHYR_DEVICE_MEMBER(dev, config);
   struct ucuart_data * data = ZEPHYR_DEVICE_MEMBER(dev, data);
 
-  if (data->tx_cb) {
+  if (data->txq) {
     bool got = atomic_cas(&data->tx_active, false, true);
     if (got) {
       nrf_uarte_event_clear(config->regs, NRF_UARTE_EVENT_ENDTX);
       nrf_uarte_event_clear(config->regs, NRF_UARTE_EVENT_TXSTOPPED);
-      size_t n = cb_peek_avail(data->tx_cb);
       if ((prefix != NULL) && (pn > 0)) {
         nrf_uarte_tx_buffer_set(config->regs, prefix, pn);
         data->n = 0;
         nrf_uarte_task_trigger(config->regs, NRF_UARTE_TASK_STARTTX);
       }
-      else if (n > 0) {
-        nrf_uarte_tx_buffer_set(config->regs, cb_peek(data->tx_cb), n);
-        data->n = n;
-        nrf_uarte_task_trigger(config->regs, NRF_UARTE_TASK_STARTTX);
-      }
       else {
-        atomic_set(&data->tx_active, false);
+        const uint8_t* p;
+        size_t n = ucuart_txq_peek(data->txq, &p);
+        if (n > 0) {
+          nrf_uarte_tx_buffer_set(config->regs, p, n);
+          data->n = n;
+          nrf_uarte_task_trigger(config->regs, NRF_UARTE_TASK_STARTTX);
+        }
+        else {
+          atomic_set(&data->tx_active, false);
+        }
       }
     }
   }
@@ -171,27 +176,36 @@ static int tx_schedule(const struct device *dev, const uint8_t* prefix, size_t p
 static int tx(const struct device *dev, const uint8_t* b, size_t n) {
   const struct ucuart_data * data = ZEPHYR_DEVICE_MEMBER(dev, data);
 
-  if (data->tx_cb == NULL) return -EIO;
+  if (data->txq == NULL) return -EIO;
 
-  cb_write(data->tx_cb, b, n);
+  cb_write(data->txq->cb[data->txq->n - 1], b, n);
   return tx_schedule(dev, NULL, 0);
 }
 
 static int tx_buffer(const struct device *dev, const uint8_t* b, size_t n) {
   const struct ucuart_data * data = ZEPHYR_DEVICE_MEMBER(dev, data);
 
-  if (data->tx_cb == NULL) return -EIO;
+  if (data->txq == NULL) return -EIO;
 
-  cb_write(data->tx_cb, b, n);
+  cb_write(data->txq->cb[data->txq->n - 1], b, n);
   return 0;
 }
 
-static int set_tx_cb(const struct device *dev, cb_t* cb) {
+static int set_tx_queue(const struct device *dev, ucuart_txq_t* q) {
   struct ucuart_data * data = ZEPHYR_DEVICE_MEMBER(dev, data);
-  data->tx_cb = cb;
+  if ((q != NULL) && (q->n == 0)) return -EINVAL;
+  data->txq = q;
   return 0;
 }
 
+static int set_tx_cb(const struct device *dev, cb_t* cb) {
+  struct ucuart_data * data = ZEPHYR_DEVICE_MEMBER(dev, data);
+  if (cb == NULL) return set_tx_queue(dev, NULL);
+  ucuart_txq_init(&data->tx_cb_q);
+  ucuart_txq_add(&data->tx_cb_q, cb, 0);
+  return set_tx_queue(dev, &data->tx_cb_q);
+}
+
 #if 0
 // TODO Add to API perhaps should be an error or a function to convert
 // error code to error string for those that want it.
@@ -287,6 +301,7 @@ static const struct ucuart_driver_api ucuart_api = {
   .tx_buffer = tx_buffer,
   .tx_schedule = tx_schedule,
   .set_tx_cb = set_tx_cb,
+  .set_tx_queue = set_tx_queue,
   .rx_start = rx_start,
   .rx_stop = rx_stop,
   .rx_avail = rx_avail,
@@ -404,7 +419,7 @@ static void irq_config##i(const struct device *dev) {               \
   static struct ucuart_data data##i = {                             \
     .tx_active = false,                                             \
     .rx_active = false,                                             \
-    .tx_cb = NULL,                                                  \
+    .txq = NULL,                                                    \
     .last_error = 0,                                                \
     .n = 0U,                                                        \
   };                                                                \
@@ -420,7 +420,8 @@ static size_t tx_n;
 static uint8_t rx_temp_buf[NRF_USBD_COMMON_EPSIZE];
 static uint8_t rx_buf[1000];
 static cb_t rx_cb = CB_INIT(rx_buf);
-static cb_t* tx_cb = NULL;
+static ucuart_txq_t* txq = NULL;
+static ucuart_txq_t tx_cb_q;  // txq for usb_set_tx_cb()
 struct k_event event;
 
 // uclog sends ping packets at this rate
@@ -610,7 +611,7 @@ static void send_device_info(void) {
   atomic_set(&tx_active, true);
 
   LOG_INFO("Sending device info");
-  tx_n = 0; // not peeking from tx_cb for this transfer
+  tx_n = 0; // not peeking from txq for this transfer
   NRF_USBD_COMMON_TRANSFER_IN(tx, device_info_tx_buf, device_info_len, 0);
   nrfx_err_t e = nrf_usbd_common_ep_transfer(NRF_USBD_COMMON_EPIN2, &tx);
   if (e != NRFX_SUCCESS) LOG_ERROR("nrf_usbd_common_ep_transfer() %08x", e);
@@ -676,18 +677,27 @@ void usb_rx_skip(const struct device *dev, size_t n) {
   cb_skip(&rx_cb, n);
 }
 
-int usb_set_tx_cb(const struct device *dev, cb_t* cb) {
+int usb_set_tx_queue(const struct device *dev, ucuart_txq_t* q) {
   (void) dev;
-  tx_cb = cb;
+  if ((q != NULL) && (q->n == 0)) return -EINVAL;
+  txq = q;
   return 0;
 }
 
+int usb_set_tx_cb(const struct device *dev, cb_t* cb) {
+  if (cb == NULL) return usb_set_tx_queue(dev, NULL);
+  ucuart_txq_init(&tx_cb_q);
+  ucuart_txq_add(&tx_cb_q, cb, 0);
+  return usb_set_tx_queue(dev, &tx_cb_q);
+}
+
 int usb_tx_schedule(const struct device *dev, const uint8_t* prefix, size_t pn) {
   (void) dev;
-  if (tx_cb && atomic_get(&host_ready) && atomic_get(&received_packet)) {
+  if (txq && atomic_get(&host_ready) && atomic_get(&received_packet)) {
     bool got = atomic_cas(&tx_active, false, true);
     if (got) {
-      size_t n = cb_peek_avail(tx_cb);
+      const uint8_t* p;
+      size_t n = ucuart_txq_peek(txq, &p);
       // if ((prefix != NULL) && (pn > 0)) {
       //   tx_n = 0;
       //   NRF_USBD_COMMON_TRANSFER_IN(tx, prefix, pn, 0);
@@ -697,7 +707,7 @@ int usb_tx_schedule(const struct device *dev, const uint8_t* prefix, size_t pn)
       // else 
       if (n > 0) {
         tx_n = n;
-        NRF_USBD_COMMON_TRANSFER_IN(tx, cb_peek(tx_cb), n, 0);
+        NRF_USBD_COMMON_TRANSFER_IN(tx, p, n, 0);
         nrfx_err_t e = nrf_usbd_common_ep_transfer(NRF_USBD_COMMON_EPIN2, &tx);
         if (e != NRFX_SUCCESS) LOG_ERROR("nrf_usbd_common_ep_transfer() %08x", e);
       }
@@ -706,10 +716,10 @@ int usb_tx_schedule(const struct device *dev, const uint8_t* prefix, size_t pn)
       }
     }
     if (panic_mode && (!panic_timed_out)) {
-      for (int i = 0; (i < 10000) && (cb_read_avail(tx_cb) > 0); i++) {
+      for (int i = 0; (i < 10000) && (ucuart_txq_read_avail(txq) > 0); i++) {
         nrf_usbd_common_irq_handler();
       }
-      if (cb_read_avail(tx_cb) > 0) panic_timed_out = true;
+      if (ucuart_txq_read_avail(txq) > 0) panic_timed_out = true;
     }
   }
   return 0;
@@ -882,22 +892,23 @@ static void usbd_event_handler(nrf_usbd_common_evt_t const *const p_event) {
       }
       else if (p_event->data.eptransfer.ep == NRF_USBD_COMMON_EPIN2) {
         if (p_event->data.eptransfer.status == NRF_USBD_COMMON_EP_OK) {
-          if (tx_cb == NULL) {
+          if (txq == NULL) {
             // No tx buffer set yet. We can get here via send_device_info() xfer
             atomic_set(&tx_active, false);
           } else {
-            if (cb_peek_avail(tx_cb) < tx_n) {
+            if (cb_peek_avail(txq->cb[txq->cur]) < tx_n) {
               LOG_FATAL("we are trying to double read");
             }
             if (tx_n > 0) {
-              cb_skip(tx_cb, tx_n);
+              ucuart_txq_skip(txq, tx_n);
             }
-            size_t n = cb_peek_avail(tx_cb);
+            const uint8_t* p;
+            size_t n = ucuart_txq_peek(txq, &p);
             bool ready = atomic_get(&host_ready);
             if ((n > 0) && ready) {
               atomic_set(&tx_active, true);
               tx_n = n;
-              NRF_USBD_COMMON_TRANSFER_IN(tx, cb_peek(tx_cb), n, 0);
+              NRF_USBD_COMMON_TRANSFER_IN(tx, p, n, 0);
               nrfx_err_t e = nrf_usbd_common_ep_transfer(NRF_USBD_COMMON_EPIN2, &tx);
               if (e != NRFX_SUCCESS) LOG_ERROR("nrf_usbd_common_ep_transfer() %08x", e);
             }
@@ -906,7 +917,7 @@ static void usbd_event_handler(nrf_usbd_common_evt_t const *const p_event) {
               // sending - then let other end know we are done sending
               // by sending a 0 length packet
               tx_n = 0;
-              NRF_USBD_COMMON_TRANSFER_IN(tx, cb_peek(tx_cb), 0, 0);
+              NRF_USBD_COMMON_TRANSFER_IN(tx, device_info_tx_buf, 0, 0);
               nrfx_err_t e = nrf_usbd_common_ep_transfer(NRF_USBD_COMMON_EPIN2, &tx);
               if (e != NRFX_SUCCESS) LOG_ERROR("nrf_usbd_common_ep_transfer() %08x", e);
             }
@@ -978,6 +989,7 @@ static const struct ucuart_driver_api ucusb_api = {
   .tx_buffer = usb_tx_buffer,
   .tx_schedule = usb_tx_schedule,
   .set_tx_cb = usb_set_tx_cb,
+  .set_tx_queue = usb_set_tx_queue,
   .rx_start = usb_rx_start,
   .rx_stop = usb_rx_stop,
   .rx_avail = usb_rx_avail,
@@ -1016,7 +1028,8 @@ static void fill_device_info(void) {
   uint8_t *cbor_output = &device_info_tx_buf[cbor_offset];
 
   cbor_stream_t cbor_stream;
-  cbor_init(&cbor_stream, cbor_output, MAX_LOG_TX_SIZE);
+  // Room for the port byte and frame check
+  cbor_init(&cbor_stream, cbor_output, MAX_LOG_TX_SIZE - 1 - LOG_CRC_SIZE);
 
 #ifdef CONFIG_SIGNED_IMAGE
   const uint8_t *app_hash__ = sbl_app_hash();
@@ -1035,11 +1048,14 @@ static void fill_device_info(void) {
   }
 
   size_t cbor_len = cbor_read_avail(&cbor_stream);
+  size_t len = cbor_len + 1;
+  len += log_crc_put(&device_info_tx_buf[port_offset + len],
+      log_crc(LOG_CRC_INIT, &device_info_tx_buf[port_offset], len));
 
   // Encode COBS
   size_t cobs_len = cobs_enc(&device_info_tx_buf[1],
       &device_info_tx_buf[port_offset],
-      cbor_len + 1);
+      len);
 
   // Frame
   device_info_tx_buf[0] = '\0';
@@ -0,0 +1,114 @@
+// © 2025 Unit Circle Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <cbor.h>
+
+// Map indexes are in lib/cbor_index.c
+#if defined(__ZEPHYR__) && !defined(CONFIG_UC_CBOR)
+#error "cbor_index.h needs CONFIG_UC_CBOR"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Map index
+//
+// cbor_get_*() rescans a map from the start for every key, so reading k keys
+// from an n entry map is O(k*n).  An index walks the map once and records a
+// hash of each key with the offset of the key within the map.  Lookups
+// then hash the wanted key, probe the table and compare only the candidate
+// key(s) - O(1) expected.
+//
+// Indexing is opt-in: cbor_unpack() and cbor_get_*() are uccomm's and
+// still search linearly.  Code reading many keys of a large map indexes it
+// and reads with cbor_index_get_*() instead.
+//
+//   cbor_index_entry_t e[CBOR_INDEX_ENTRIES(32)];
+//   cbor_index_t idx;
+//   cbor_read_map(&s, &map_s, &map_n);
+//   cbor_index_map(&idx, e, ARRAY_SIZE(e), &map_s, map_n);
+//   cbor_index_get_uint32(&idx, "id", &id);
+//
+// The index points into the map - it is only valid while the map buffer is.
+// Text and int keys are indexed, other keys are skipped.  Maps with a key
+// 64 KiB or more from their start or with indefinite length text keys
+// return CBOR_ERROR_CANT_CONVERT_TYPE and should be searched with
+// cbor_get_*().
+// Duplicate keys behave as with cbor_get_*() - the first one wins.
+//
+// Define CBOR_NO_INDEX to remove indexing.
+
+#define CBOR_INDEX_EMPTY (0xffff)
+
+// Table slots needed for a map of n keys (load factor <= 2/3).  Power of 2.
+#define CBOR_INDEX_ENTRIES(n) \
+  (((n) + (n)/2) <= 4 ? 4 : \
+   ((n) + (n)/2) <= 8 ? 8 : \
+   ((n) + (n)/2) <= 16 ? 16 : \
+   ((n) + (n)/2) <= 32 ? 32 : \
+   ((n) + (n)/2) <= 64 ? 64 : \
+   ((n) + (n)/2) <= 128 ? 128 : \
+   ((n) + (n)/2) <= 256 ? 256 : 512)
+
+typedef struct {
+  uint16_t hash;  // upper 16 bits of key hash
+  uint16_t off;   // offset of key from start of map, CBOR_INDEX_EMPTY if unused
+} cbor_index_entry_t;
+
+typedef struct {
+  cbor_stream_t map;
+  size_t n;
+  cbor_index_entry_t* e;
+  size_t mask;
+} cbor_index_t;
+
+cbor_error_t cbor_index_map(cbor_index_t* idx, cbor_index_entry_t* e, size_t size,
+                            const cbor_stream_t* map, size_t n);
+
+// Position st at the value for key k (like cbor_unpack "v")
+cbor_error_t cbor_index_find_textn(const cbor_index_t* idx, const char* k, size_t key_n, cbor_stream_t* st);
+cbor_error_t cbor_index_find_int(const cbor_index_t* idx, int64_t k, cbor_stream_t* st);
+
+cbor_error_t cbor_index_get_any(const cbor_index_t* idx, const char* k, cbor_value_t* v);
+
+cbor_error_t cbor_index_get_uint64(const cbor_index_t* idx, const char* k, uint64_t* u);
+cbor_error_t cbor_index_get_uint32(const cbor_index_t* idx, const char* k, uint32_t* u);
+cbor_error_t cbor_index_get_uint16(const cbor_index_t* idx, const char* k, uint16_t* u);
+cbor_error_t cbor_index_get_uint8(const cbor_index_t* idx, const char* k, uint8_t* u);
+cbor_error_t cbor_index_get_int64(const cbor_index_t* idx, const char* k, int64_t* u);
+cbor_error_t cbor_index_get_int32(const cbor_index_t* idx, const char* k, int32_t* u);
+cbor_error_t cbor_index_get_int16(const cbor_index_t* idx, const char* k, int16_t* u);
+cbor_error_t cbor_index_get_int8(const cbor_index_t* idx, const char* k, int8_t* u);
+cbor_error_t cbor_index_get_bool(const cbor_index_t* idx, const char* k, bool* u);
+cbor_error_t cbor_index_get_null(const cbor_index_t* idx, const char* k);
+cbor_error_t cbor_index_get_undefined(const cbor_index_t* idx, const char* k);
+cbor_error_t cbor_index_get_simple(const cbor_index_t* idx, const char* k, uint8_t* u);
+cbor_error_t cbor_index_get_float64(const cbor_index_t* idx, const char* k, float64_t* u);
+cbor_error_t cbor_index_get_datetime(const cbor_index_t* idx, const char* k, float64_t* u);
+cbor_error_t cbor_index_get_tag(const cbor_index_t* idx, const char* k, cbor_stream_t* m, uint64_t* tag);
+cbor_error_t cbor_index_get_text(const cbor_index_t* idx, const char* k, cbor_stream_t* m, size_t* n);
+cbor_error_t cbor_index_get_bytes(const cbor_index_t* idx, const char* k, cbor_stream_t* m, size_t* n);
+cbor_error_t cbor_index_get_array(const cbor_index_t* idx, const char* k, cbor_stream_t* m, size_t* n);
+cbor_error_t cbor_index_get_map(const cbor_index_t* idx, const char* k, cbor_stream_t* m, size_t* n);
+
+#ifdef __cplusplus
+}
+#endif
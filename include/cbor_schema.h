@@ -0,0 +1,179 @@
+// © 2025 Unit Circle Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <cbor.h>
+
+// Schemas are in lib/cbor_index.c
+#if defined(__ZEPHYR__) && !defined(CONFIG_UC_CBOR)
+#error "cbor_schema.h needs CONFIG_UC_CBOR"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Compiled CBOR schemas
+//
+// cbor_pack()/cbor_unpack() interpret their format string on every call.
+// For fixed messages a schema can be described once with an X-macro and
+// turned into a C struct plus straight-line pack/unpack functions:
+//
+//   #define RPC_STATUS(F) F(id, U32, 0) F(temp, I32, 0) F(name, TEXT, 16) ...
+//                         F(data, BYTES, 32) F(ok, BOOL, 0)
+//
+//   CBOR_SCHEMA_DEFINE(rpc_status, RPC_STATUS)
+//
+// gives
+//
+//   struct rpc_status { uint32_t id; int32_t temp; char name[16];
+//                       struct { size_t n; uint8_t b[32]; } data; bool ok; };
+//   cbor_error_t rpc_status_pack(cbor_stream_t* s, const struct rpc_status* v);
+//   cbor_error_t rpc_status_unpack(cbor_stream_t* s, struct rpc_status* v);
+//   rpc_status_max_size  - worst case encoded size (compile time constant)
+//
+// which is equivalent to cbor_pack/unpack with "{.id:I,.temp:i,.name:s,...}".
+// Use CBOR_SCHEMA_DECLARE() in a header and CBOR_SCHEMA_DEFINE() in one
+// source file if the schema is shared.
+//
+// Field types: U8 U16 U32 U64 I8 I16 I32 I64 BOOL F64 (size 0), TEXT (size
+// of char buffer including NUL) and BYTES (size of buffer).  All fields are
+// required on unpack; unknown keys are ignored.  Keys must be < 24 chars.
+//
+// Unpack expects keys in schema order (as pack writes them) and falls back
+// to a search of the map for out of order keys.
+
+// Encoded size of a CBOR head for argument n
+#define CBOR_SCHEMA_HEAD(n) \
+  ((n) < 24 ? 1 : (n) < 0x100 ? 2 : (n) < 0x10000 ? 3 : 5)
+
+// Per type: C declaration, worst case value size, pack and unpack
+#define CBOR_SCHEMA_DECL_U8(f, size)    uint8_t f;
+#define CBOR_SCHEMA_DECL_U16(f, size)   uint16_t f;
+#define CBOR_SCHEMA_DECL_U32(f, size)   uint32_t f;
+#define CBOR_SCHEMA_DECL_U64(f, size)   uint64_t f;
+#define CBOR_SCHEMA_DECL_I8(f, size)    int8_t f;
+#define CBOR_SCHEMA_DECL_I16(f, size)   int16_t f;
+#define CBOR_SCHEMA_DECL_I32(f, size)   int32_t f;
+#define CBOR_SCHEMA_DECL_I64(f, size)   int64_t f;
+#define CBOR_SCHEMA_DECL_BOOL(f, size)  bool f;
+#define CBOR_SCHEMA_DECL_F64(f, size)   float64_t f;
+#define CBOR_SCHEMA_DECL_TEXT(f, size)  char f[size];
+#define CBOR_SCHEMA_DECL_BYTES(f, size) struct { size_t n; uint8_t b[size]; } f;
+
+#define CBOR_SCHEMA_MAX_U8(size)    2
+#define CBOR_SCHEMA_MAX_U16(size)   3
+#define CBOR_SCHEMA_MAX_U32(size)   5
+#define CBOR_SCHEMA_MAX_U64(size)   9
+#define CBOR_SCHEMA_MAX_I8(size)    2
+#define CBOR_SCHEMA_MAX_I16(size)   3
+#define CBOR_SCHEMA_MAX_I32(size)   5
+#define CBOR_SCHEMA_MAX_I64(size)   9
+#define CBOR_SCHEMA_MAX_BOOL(size)  1
+#define CBOR_SCHEMA_MAX_F64(size)   9
+#define CBOR_SCHEMA_MAX_TEXT(size)  (CBOR_SCHEMA_HEAD((size) - 1) + (size) - 1)
+#define CBOR_SCHEMA_MAX_BYTES(size) (CBOR_SCHEMA_HEAD(size) + (size))
+
+#define CBOR_SCHEMA_PACK_U8(s, x, size)    cbor_write_uint64(s, x)
+#define CBOR_SCHEMA_PACK_U16(s, x, size)   cbor_write_uint64(s, x)
+#define CBOR_SCHEMA_PACK_U32(s, x, size)   cbor_write_uint64(s, x)
+#define CBOR_SCHEMA_PACK_U64(s, x, size)   cbor_write_uint64(s, x)
+#define CBOR_SCHEMA_PACK_I8(s, x, size)    cbor_write_int64(s, x)
+#define CBOR_SCHEMA_PACK_I16(s, x, size)   cbor_write_int64(s, x)
+#define CBOR_SCHEMA_PACK_I32(s, x, size)   cbor_write_int64(s, x)
+#define CBOR_SCHEMA_PACK_I64(s, x, size)   cbor_write_int64(s, x)
+#define CBOR_SCHEMA_PACK_BOOL(s, x, size)  cbor_write_bool(s, x)
+#define CBOR_SCHEMA_PACK_F64(s, x, size)   cbor_write_float64(s, x)
+#define CBOR_SCHEMA_PACK_TEXT(s, x, size)  cbor_schema_write_text(s, x, size)
+#define CBOR_SCHEMA_PACK_BYTES(s, x, size) cbor_schema_write_bytes(s, (x).b, (x).n, size)
+
+#define CBOR_SCHEMA_AS_U8(v, x, size)    cbor_as_uint8(v, &(x))
+#define CBOR_SCHEMA_AS_U16(v, x, size)   cbor_as_uint16(v, &(x))
+#define CBOR_SCHEMA_AS_U32(v, x, size)   cbor_as_uint32(v, &(x))
+#define CBOR_SCHEMA_AS_U64(v, x, size)   cbor_as_uint64(v, &(x))
+#define CBOR_SCHEMA_AS_I8(v, x, size)    cbor_as_int8(v, &(x))
+#define CBOR_SCHEMA_AS_I16(v, x, size)   cbor_as_int16(v, &(x))
+#define CBOR_SCHEMA_AS_I32(v, x, size)   cbor_as_int32(v, &(x))
+#define CBOR_SCHEMA_AS_I64(v, x, size)   cbor_as_int64(v, &(x))
+#define CBOR_SCHEMA_AS_BOOL(v, x, size)  cbor_as_bool(v, &(x))
+#define CBOR_SCHEMA_AS_F64(v, x, size)   cbor_as_float64(v, &(x))
+#define CBOR_SCHEMA_AS_TEXT(v, x, size)  cbor_schema_as_text(v, x, size)
+#define CBOR_SCHEMA_AS_BYTES(v, x, size) cbor_schema_as_bytes(v, (x).b, &(x).n, size)
+
+#define CBOR_SCHEMA_CHECK(x) do { \
+  cbor_error_t e_ = x; \
+  if (e_ != CBOR_ERROR_NONE) return e_; \
+} while (false)
+
+// X-macro expanders
+#define CBOR_SCHEMA_X_DECL(f, type, size) CBOR_SCHEMA_DECL_ ## type(f, size)
+#define CBOR_SCHEMA_X_COUNT(f, type, size) + 1
+#define CBOR_SCHEMA_X_MAX(f, type, size) \
+  + 1 + sizeof(#f) - 1 + CBOR_SCHEMA_MAX_ ## type(size)
+#define CBOR_SCHEMA_X_PACK(f, type, size) \
+  CBOR_SCHEMA_CHECK(cbor_write_textn(s, #f, sizeof(#f) - 1)); \
+  CBOR_SCHEMA_CHECK(CBOR_SCHEMA_PACK_ ## type(s, v->f, size));
+#define CBOR_SCHEMA_X_UNPACK(f, type, size) \
+  CBOR_SCHEMA_CHECK(cbor_schema_field(&map_s, &cur, #f, sizeof(#f) - 1, &fv)); \
+  CBOR_SCHEMA_CHECK(CBOR_SCHEMA_AS_ ## type(&fv, v->f, size));
+
+#define CBOR_SCHEMA_DECLARE(name, FIELDS) \
+  struct name { \
+    FIELDS(CBOR_SCHEMA_X_DECL) \
+  }; \
+  enum { \
+    name ## _fields = 0 FIELDS(CBOR_SCHEMA_X_COUNT), \
+    name ## _max_size = CBOR_SCHEMA_HEAD(0 FIELDS(CBOR_SCHEMA_X_COUNT)) \
+                        FIELDS(CBOR_SCHEMA_X_MAX), \
+  }; \
+  cbor_error_t name ## _pack(cbor_stream_t* s, const struct name* v); \
+  cbor_error_t name ## _unpack(cbor_stream_t* s, struct name* v)
+
+#define CBOR_SCHEMA_DEFINE(name, FIELDS) \
+  CBOR_SCHEMA_DECLARE(name, FIELDS); \
+  cbor_error_t name ## _pack(cbor_stream_t* s, const struct name* v) { \
+    CBOR_SCHEMA_CHECK(cbor_write_map(s, name ## _fields)); \
+    FIELDS(CBOR_SCHEMA_X_PACK) \
+    return CBOR_ERROR_NONE; \
+  } \
+  cbor_error_t name ## _unpack(cbor_stream_t* s, struct name* v) { \
+    cbor_stream_t map_s; \
+    cbor_stream_t cur; \
+    cbor_value_t fv; \
+    size_t map_n; \
+    CBOR_SCHEMA_CHECK(cbor_read_map(s, &map_s, &map_n)); \
+    cur = map_s; \
+    FIELDS(CBOR_SCHEMA_X_UNPACK) \
+    return CBOR_ERROR_NONE; \
+  }
+
+// Helpers used by the generated code (lib/cbor_index.c)
+
+// Find value for key k.  cur is where the previous key's value ended - the
+// key there is tried first.
+cbor_error_t cbor_schema_field(const cbor_stream_t* map, cbor_stream_t* cur,
+                               const char* k, size_t key_n, cbor_value_t* v);
+cbor_error_t cbor_schema_write_text(cbor_stream_t* s, const char* t, size_t size);
+cbor_error_t cbor_schema_write_bytes(cbor_stream_t* s, const uint8_t* b, size_t n, size_t size);
+cbor_error_t cbor_schema_as_text(const cbor_value_t* v, char* t, size_t size);
+cbor_error_t cbor_schema_as_bytes(const cbor_value_t* v, uint8_t* b, size_t* n, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,68 @@
+// © 2025 Unit Circle Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <cbor.h>
+
+// Views are in lib/cbor_index.c
+#if defined(__ZEPHYR__) && !defined(CONFIG_UC_CBOR)
+#error "cbor_view.h needs CONFIG_UC_CBOR"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Zero copy text and bytes
+//
+// cbor_get_text() + cbor_memmove() copies a string out of the message.  A
+// view instead points at the string's contents in the message buffer:
+//
+//   cbor_view_t name;
+//   if ((cbor_get_text_view(&map_s, map_n, "name", &name) == CBOR_ERROR_NONE) &&
+//       cbor_view_text_valid(&name)) {
+//     LOG_INF("%.*s", (int) name.n, (const char*) name.b);
+//   }
+//
+// A view is only valid while the message buffer is and is not NUL
+// terminated.  Only definite length strings can be viewed - indefinite
+// length (chunked) strings return CBOR_ERROR_CANT_CONVERT_TYPE and must be
+// copied with cbor_memmove().
+//
+// cbor_read_text_view() and cbor_get_text_view() don't check the UTF-8 of
+// the viewed text - call cbor_view_text_valid() before using it, so text
+// that is only skipped over or compared is never checked.
+// cbor_as_text_view() views a value cbor_read_any() has already checked.
+
+typedef struct {
+  const uint8_t* b;
+  size_t n;
+} cbor_view_t;
+
+cbor_error_t cbor_as_text_view(const cbor_value_t* v, cbor_view_t* r);
+cbor_error_t cbor_as_bytes_view(const cbor_value_t* v, cbor_view_t* r);
+cbor_error_t cbor_read_text_view(cbor_stream_t* s, cbor_view_t* r);
+cbor_error_t cbor_read_bytes_view(cbor_stream_t* s, cbor_view_t* r);
+cbor_error_t cbor_get_text_view(cbor_stream_t* s, size_t n, const char* k, cbor_view_t* r);
+cbor_error_t cbor_get_bytes_view(cbor_stream_t* s, size_t n, const char* k, cbor_view_t* r);
+bool cbor_view_text_valid(const cbor_view_t* r);
+
+#ifdef __cplusplus
+}
+#endif
@@ -17,6 +17,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <sys/types.h>
 
 #include "ucuart.h"
 
@@ -32,10 +33,23 @@ extern "C" {
 #define CONFIG_UC_LOG_SAVE (0)
 #endif
 
+#if !defined(CONFIG_UC_LOG_FRAG)
+#define CONFIG_UC_LOG_FRAG (0)
+#endif
+
 #if !defined(LOG_MAX_PACKET_SIZE)
 #define LOG_MAX_PACKET_SIZE (1500)
 #endif
 
+// Frame check trailer bytes - see log_crc()
+#if defined(CONFIG_UC_LOG_CRC32)
+#define LOG_CRC_SIZE (4)
+#elif defined(CONFIG_UC_LOG_CRC16)
+#define LOG_CRC_SIZE (2)
+#else
+#define LOG_CRC_SIZE (0)
+#endif
+
 
 // Override/overload zephyr logging macros
 #if defined(CONFIG_LOG_CUSTOM_HEADER)
@@ -143,14 +157,41 @@ void log_init(uart_t* uart);
 #define TOSTR_(x_)  TOSTR1_(x_)
 #define TOSTR1_(x_) #x_
 
+// Log compression marks messages in bits 2-3 of the .logstr pointer (of the
+// call site index with CONFIG_UC_LOG_CALLSITE_ID, so the strings are packed)
+#if defined(CONFIG_UC_LOG_CALLSITE_ID)
+#define LOG_STRING_ALIGN 1
+#elif defined(CONFIG_UC_LOG_COMPRESS)
+#define LOG_STRING_ALIGN 16
+#else
+#define LOG_STRING_ALIGN 4
+#endif
+
+#if defined(CONFIG_UC_LOG_CALLSITE_ID)
+// The call site is its entry in .logidx, an array of pointers to the
+// strings packed together by lib/log.ld, and its index there is sent
+// instead of the string's address (see lib/log.c).  Neither section is
+// loaded on the target.
+#define LOG_STRING_(x_)                                                        \
+  (__extension__({                                                             \
+    static const                                                               \
+        __attribute__((__aligned__(LOG_STRING_ALIGN),                          \
+                       __section__(".logstr." TOSTR_(__LINE__)))) char c__[] = \
+            (x_);                                                              \
+    static const char* const                                                   \
+        __attribute__((__section__(".logidx." TOSTR_(__LINE__)))) e__ = c__;   \
+    (const char *)&e__;                                                        \
+  }))
+#else
 #define LOG_STRING_(x_)                                                        \
   (__extension__({                                                             \
     static const                                                               \
-        __attribute__((__aligned__(4),                                         \
+        __attribute__((__aligned__(LOG_STRING_ALIGN),                          \
                        __section__(".logstr." TOSTR_(__LINE__)))) char c__[] = \
             (x_);                                                              \
     (const char *)&c__;                                                        \
   }))
+#endif
 
 #define LOG_DEBUG(...) LOG_(LOG_LVL_DEBUG, VA_SEL(__VA_ARGS__), __VA_ARGS__)
 #define LOG_INFO(...)  LOG_(LOG_LVL_INFO , VA_SEL(__VA_ARGS__), __VA_ARGS__)
@@ -168,7 +209,7 @@ void log_init(uart_t* uart);
 #define LOG1_(c_, fmt_)  \
   do { \
     log_fmt_chk_(fmt_); \
-    log_log1_( \
+    log_log1_(c_, \
       LOG_STRING_(#c_ ":" __FILE__ ":" TOSTR_(__LINE__) ":" fmt_)); \
   } while (false)
 
@@ -176,11 +217,55 @@ void log_init(uart_t* uart);
   do  { \
     const char mfmt_[] = { MAP(typechar, __VA_ARGS__) 0 }; \
     log_fmt_chk_(fmt_, __VA_ARGS__); \
-    log_logn_(mfmt_, \
+    log_logn_(c_, mfmt_, \
         LOG_STRING_(#c_ ":" __FILE__ ":" TOSTR_(__LINE__) ":" fmt_), \
         __VA_ARGS__); \
   } while (false)
 
+// Structured log records - a message and named, typed fields:
+//
+//   LOG_KV_INFO("adc sample", (ch, "%u", channel), (mv, "%d", millivolts));
+//
+// Each field is (name, format, value) with one printf conversion, which may
+// be an {enum:...} or {sym} one.  The names are kept in the call site's
+// .logstr string as "{@name}" tags ahead of their conversions - here
+// "adc sample {@ch}%u {@mv}%d" - and the values are sent as for LOG_INFO().
+// The host hands out the values by name (uclog.py --json, logexport.py
+// columns) and only renders "adc sample ch=3 mv=-12" when text is wanted.
+// "{@name}" tags work in the format of any LOG_* call too.
+#define LOG_KV_DEBUG(...) LOG_KV_(LOG_LVL_DEBUG, VA_SEL(__VA_ARGS__), __VA_ARGS__)
+#define LOG_KV_INFO(...)  LOG_KV_(LOG_LVL_INFO , VA_SEL(__VA_ARGS__), __VA_ARGS__)
+#define LOG_KV_WARN(...)  LOG_KV_(LOG_LVL_WARN , VA_SEL(__VA_ARGS__), __VA_ARGS__)
+#define LOG_KV_ERROR(...) LOG_KV_(LOG_LVL_ERROR, VA_SEL(__VA_ARGS__), __VA_ARGS__)
+#define LOG_KV_FATAL(...) do { \
+  log_panic_(); \
+  LOG_KV_(LOG_LVL_FATAL, VA_SEL(__VA_ARGS__), __VA_ARGS__); \
+  log_fatal_(); \
+} while (false)
+
+#define LOG_KV_(c_,s_,...)      LOG_KV_IMPL_(c_,s_,__VA_ARGS__)
+#define LOG_KV_IMPL_(c_,s_,...) LOGKV##s_##_(c_,__VA_ARGS__)
+
+#define LOGKV1_(c_, msg_) LOG1_(c_, msg_)
+
+#define LOGKVN_(c_, msg_, ...)  \
+  do  { \
+    const char mfmt_[] = { MAP(LOG_KV_TYPE_, __VA_ARGS__) 0 }; \
+    log_fmt_chk_(msg_ MAP(LOG_KV_FMT_, __VA_ARGS__) \
+        MAP(LOG_KV_ARG_, __VA_ARGS__)); \
+    log_logn_(c_, mfmt_, \
+        LOG_STRING_(#c_ ":" __FILE__ ":" TOSTR_(__LINE__) ":" msg_ \
+            MAP(LOG_KV_FMT_, __VA_ARGS__)) \
+        MAP(LOG_KV_ARG_, __VA_ARGS__)); \
+  } while (false)
+
+#define LOG_KV_FMT_(f_)             LOG_KV_FMT1_ f_
+#define LOG_KV_FMT1_(n_, f_, v_)    " {@" #n_ "}" f_
+#define LOG_KV_TYPE_(f_)            LOG_KV_TYPE1_ f_
+#define LOG_KV_TYPE1_(n_, f_, v_)   typechar(v_)
+#define LOG_KV_ARG_(f_)             LOG_KV_ARG1_ f_
+#define LOG_KV_ARG1_(n_, f_, v_)    , v_
+
 #define LOG_MEM_DEBUG(_fmt, _buf, _n) LOG_MEM_(LOG_LVL_DEBUG, _fmt, _buf, _n)
 #define LOG_MEM_INFO(_fmt, _buf, _n)  LOG_MEM_(LOG_LVL_INFO,  _fmt, _buf, _n)
 #define LOG_MEM_WARN(_fmt, _buf, _n)  LOG_MEM_(LOG_LVL_WARN,  _fmt, _buf, _n)
@@ -194,7 +279,7 @@ void log_init(uart_t* uart);
 
 #define LOG_MEM_IMPL_(_c, _fmt, _buf, _n) \
   do { \
-    log_mem_( \
+    log_mem_(_c, \
       LOG_STRING_(#_c ":" __FILE__ ":" TOSTR_(__LINE__) ":" _fmt), _buf, _n); \
   } while (false)
 
@@ -209,9 +294,9 @@ typedef struct {
   size_t   tx_n;
 } log_msg_t;
 
-void log_log1_(const char *prefix);
-void log_logn_(const char* n, const char *prefix,  ...);
-void log_mem_(const char *prefix,  const void* b, size_t n);
+void log_log1_(uint8_t level, const char *prefix);
+void log_logn_(uint8_t level, const char* n, const char *prefix,  ...);
+void log_mem_(uint8_t level, const char *prefix,  const void* b, size_t n);
 
 void log_panic_(void);
 __attribute__((noreturn)) void log_fatal_(void);
@@ -219,6 +304,63 @@ __attribute__((noreturn)) void log_fatal_(void);
 void log_tx(uint8_t port, const uint8_t* data, size_t n);
 size_t log_tx_avail(void);
 
+// Frame of the given type (low 2 bits of the first byte) made up of header
+// h, data and trailer t.  Used by the log server fragmentation layer.
+bool log_tx_frame_(uint8_t type, uint8_t port, const uint8_t* h, size_t hn,
+                   const uint8_t* data, size_t n, const uint8_t* t, size_t tn);
+
+// Frame check (CONFIG_UC_LOG_CRC) - every frame in both directions ends
+// with a LOG_CRC_SIZE byte little endian CRC of the rest of the frame,
+// before COBS encoding.  CRC-16/CCITT-FALSE or CRC-32 (as zlib).
+//   crc = log_crc(LOG_CRC_INIT, b, n);   // and more log_crc(crc, ...)
+//   n += log_crc_put(b + n, crc);
+// log_crc_check() is true if b[0..n) ends with the right trailer.
+#if LOG_CRC_SIZE
+#define LOG_CRC_INIT (LOG_CRC_SIZE == 2 ? 0xffffU : 0xffffffffU)
+uint32_t log_crc(uint32_t crc, const void* b, size_t n);
+size_t log_crc_put(uint8_t* t, uint32_t crc);
+bool log_crc_check(const uint8_t* b, size_t n);
+#else
+#define LOG_CRC_INIT (0U)
+static inline uint32_t log_crc(uint32_t crc, const void* b, size_t n) {
+  (void) b;
+  (void) n;
+  return crc;
+}
+static inline size_t log_crc_put(uint8_t* t, uint32_t crc) {
+  (void) t;
+  (void) crc;
+  return 0;
+}
+static inline bool log_crc_check(const uint8_t* b, size_t n) {
+  (void) b;
+  (void) n;
+  return true;
+}
+#endif
+
+// COBS (lib/logcobs.c) - log_cobs_enc() writes at most n + n / 254 + 1
+// bytes, without the frame delimiters, and may encode in place with out =
+// in - 1 when n <= 254.  log_cobs_dec() may decode in place (out = in) and
+// returns -1 if in isn't valid COBS.  log_cobs_zero() is the index of the
+// first zero in b[0..n), n if there is none.
+#define LOG_COBS_ENC_SIZE(n) ((n) + (n) / 254 + 1)
+size_t log_cobs_enc(uint8_t* out, const uint8_t* in, size_t n);
+ssize_t log_cobs_dec(uint8_t* out, const uint8_t* in, size_t n);
+size_t log_cobs_zero(const uint8_t* b, size_t n);
+
+#if defined(CONFIG_UC_LOG_COMPRESS)
+// Log messages compressed (see lib/log.c) since reset
+typedef struct {
+  uint32_t records;
+  uint32_t keyframes;
+  uint32_t deltas;
+  uint32_t raw;       // bytes before compression (no framing)
+  uint32_t sent;      // and after
+} log_compress_stats_t;
+void log_compress_stats(log_compress_stats_t* stats);
+#endif
+
 void log_tx_suspend(void);
 void log_tx_resume(void);
 
@@ -228,6 +370,25 @@ int log_is_host_ready(bool *host_ready);
 size_t log_rx(uint8_t port, uint8_t* data, size_t n);
 typedef void log_cb_t(const uint8_t* rx, size_t rx_n, void* ctx);
 void log_notify(uint8_t port, log_cb_t* task, void* ctx);
+
+// Frames received from the host.  A resync is a good frame after one or
+// more bad ones.
+typedef struct {
+  uint32_t frames;
+  uint32_t cobs_errors;  // undecodable or longer than the RX buffer
+  uint32_t crc_errors;
+  uint32_t resyncs;
+} log_rx_stats_t;
+void log_rx_stats(log_rx_stats_t* stats);
+
+#if CONFIG_UC_LOG_FRAG
+// Large messages and reliable (acknowledged, flow controlled) port
+// channels - see lib/logserver.c
+bool log_tx_frag(uint8_t port, const uint8_t* data, size_t n);
+void log_frag_notify(uint8_t port, uint8_t* b, size_t size, log_cb_t* task, void* ctx);
+void log_frag_hold(uint8_t port);
+void log_frag_release(uint8_t port);
+#endif
 #endif
 
 #define LOG_APP_HASH_SIZE 64
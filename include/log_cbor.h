@@ -0,0 +1,92 @@
+// © 2025 Unit Circle Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <cbor.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Streaming CBOR replies on a log server port
+//
+// log_tx() needs the whole message in a buffer.  A tx stream instead COBS
+// encodes straight into the log TX ring as the message is written, so a
+// reply needs only a small CBOR scratch buffer (CONFIG_UC_LOG_TX_CHUNK) and
+// can be larger than LOG_MAX_PACKET_SIZE:
+//
+//   log_tx_stream_t ts;
+//   cbor_stream_t* s = log_tx_begin(&ts, port);
+//   cbor_write_map_start(s);
+//   for (size_t i = 0; i < n; i++) {
+//     s = log_tx_cbor(&ts, 16);       // flush if < 16 bytes free
+//     cbor_write_uint64(s, i);
+//     log_tx_bytes(&ts, rec[i].b, rec[i].n);
+//   }
+//   cbor_write_end(log_tx_cbor(&ts, 1));
+//   if (!log_tx_end(&ts)) ...
+//
+// Each CBOR item written to the stream must fit in the scratch buffer -
+// use log_tx_cbor() before each item.  Strings of any length can be sent
+// with log_tx_text()/log_tx_bytes(), which COBS encode the contents straight
+// from the caller's buffer.  Use the indefinite length
+// cbor_write_map_start()/cbor_write_array_start() + cbor_write_end() when the
+// number of entries isn't known up front.
+//
+// The stream owns the port TX ring from begin to end.  Port messages from
+// other threads wait, from ISRs they are dropped (and counted in a warning
+// at the end).  The UART won't send log messages part way through the
+// frame either, so don't block while a stream is open.  If the ring fills the
+// stream waits for the UART to drain (thread context and host connected)
+// or the frame is cut short and log_tx_end() returns false - the cut frame
+// ends in an invalid COBS block, so the host drops it as a bad frame.
+
+#if !defined(CONFIG_UC_LOG_TX_CHUNK)
+#define CONFIG_UC_LOG_TX_CHUNK (64)
+#endif
+
+// COBS encoder writing in place into the TX ring
+typedef struct {
+  bool     error;
+  uint8_t  code;      // COBS code for the current block
+  size_t   code_pos;  // ring offset of the current block's code byte
+  size_t   w;         // ring offset of the next byte
+  uint32_t crc;       // frame check (LOG_CRC_SIZE) so far
+} log_tx_sink_t;
+
+typedef struct {
+  log_tx_sink_t sink;
+  cbor_stream_t s;
+  uint8_t  b[CONFIG_UC_LOG_TX_CHUNK];
+} log_tx_stream_t;
+
+cbor_stream_t* log_tx_begin(log_tx_stream_t* ts, uint8_t port);
+
+// Stream for the next item(s) - flushed first if less than n bytes free
+cbor_stream_t* log_tx_cbor(log_tx_stream_t* ts, size_t n);
+
+void log_tx_text(log_tx_stream_t* ts, const char* t, size_t n);
+void log_tx_bytes(log_tx_stream_t* ts, const uint8_t* b, size_t n);
+
+// Returns false if any of the message was lost
+bool log_tx_end(log_tx_stream_t* ts);
+
+#ifdef __cplusplus
+}
+#endif
@@ -7,6 +7,7 @@
 #include <zephyr/toolchain.h>
 #include <zephyr/kernel.h>
 #include "cb.h"
+#include "ucuart_txq.h"
 
 #define ZEPHYR_DEVICE_MEMBER(dev, member) ((dev)->member)
 
@@ -20,6 +21,7 @@ typedef int (*ucuart_tx_no_wait_t)(const struct device *dev, const uint8_t* b, s
 typedef int (*ucuart_tx_buffer_t)(const struct device *dev, const uint8_t* b, size_t n);
 typedef int (*ucuart_tx_schedule_t)(const struct device *dev, const uint8_t* prefix, size_t pn);
 typedef int (*ucuart_set_tx_cb_t)(const struct device *dev, cb_t* cb);
+typedef int (*ucuart_set_tx_queue_t)(const struct device *dev, ucuart_txq_t* q);
 
 
 typedef void (*ucuart_rx_start_t)(const struct device *dev);
@@ -50,6 +52,7 @@ __subsystem struct ucuart_driver_api {
   ucuart_tx_buffer_t tx_buffer;
   ucuart_tx_schedule_t tx_schedule;
   ucuart_set_tx_cb_t set_tx_cb;
+  ucuart_set_tx_queue_t set_tx_queue;
 
   ucuart_rx_start_t rx_start;
   ucuart_rx_stop_t rx_stop;
@@ -144,6 +147,27 @@ static inline int z_impl_ucuart_set_tx_cb(const struct device *dev, cb_t* cb)
         return api->set_tx_cb(dev, cb);
 }
 
+/**
+ * @brief Set several tx circular buffers, sent at frame boundaries in
+ *        priority/weighted order - see ucuart_txq.h.  Replaces set_tx_cb.
+ *        tx_no_wait/tx_buffer write to the last ring added.
+ *
+ * @param dev UcUart device instance.
+ * @param q   tx queue instance.
+ *
+ * @retval 0 On success.
+ * @retval -errno Other negative errno in case of failure.
+ */
+__syscall int ucuart_set_tx_queue(const struct device *dev, ucuart_txq_t* q);
+
+static inline int z_impl_ucuart_set_tx_queue(const struct device *dev, ucuart_txq_t* q)
+{
+        const struct ucuart_driver_api *api =
+                (const struct ucuart_driver_api *)ZEPHYR_DEVICE_MEMBER(dev, api);
+
+        return api->set_tx_queue(dev, q);
+}
+
 __syscall void ucuart_rx_start(const struct device *dev);
 
 static inline void z_impl_ucuart_rx_start(const struct device *dev) {
@@ -0,0 +1,176 @@
+// © 2025 Unit Circle Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "cb.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// TX queue - several TX rings sharing one UART
+//
+// Each ring holds whole "\0 cobs \0" frames.  The driver asks for the next
+// span to DMA with ucuart_txq_peek() and reports it sent with
+// ucuart_txq_skip().  Rings are only switched at frame boundaries, so frames
+// from different rings never interleave on the wire.
+//
+// Rings with a quantum of 0 have strict priority (in the order they were
+// added).  The others share what is left by deficit round robin: each turn a
+// ring may send frames until it has used its quantum of bytes, so when all
+// are busy ring i gets quantum[i] / sum(quantum) of the bandwidth.  An idle
+// ring gives up its turn.
+//
+// A writer may commit part of a frame (e.g. the log tx streams).  The ring
+// then keeps the UART until the rest of the frame has been sent.
+//
+// peek/skip must only be called by whoever owns the current transfer (the
+// driver's tx_active).
+
+#define UCUART_TXQ_MAX (4)
+
+typedef struct {
+  cb_t*    cb[UCUART_TXQ_MAX];
+  uint16_t quantum[UCUART_TXQ_MAX];   // bytes per turn, 0 = strict priority
+  int32_t  deficit[UCUART_TXQ_MAX];
+  bool     in_frame[UCUART_TXQ_MAX];  // part way through a frame
+  uint32_t sent[UCUART_TXQ_MAX];      // bytes sent (wraps)
+  uint8_t  n;
+  uint8_t  rr;     // ring whose turn it is
+  uint8_t  cur;    // ring of the span from the last peek
+  bool     span_in_frame;
+} ucuart_txq_t;
+
+static inline void ucuart_txq_init(ucuart_txq_t* q) {
+  memset(q, 0, sizeof(*q));
+}
+
+// Returns the ring index or -1 if the queue is full
+static inline int ucuart_txq_add(ucuart_txq_t* q, cb_t* cb, uint16_t quantum) {
+  if (q->n == UCUART_TXQ_MAX) return -1;
+  q->cb[q->n] = cb;
+  q->quantum[q->n] = quantum;
+  return q->n++;
+}
+
+static inline size_t ucuart_txq_read_avail(const ucuart_txq_t* q) {
+  size_t n = 0;
+  for (size_t i = 0; i < q->n; i++) n += cb_read_avail(q->cb[i]);
+  return n;
+}
+
+// Ring to send from next at a frame boundary, -1 if all are empty
+static inline int ucuart_txq_pick(ucuart_txq_t* q) {
+  for (size_t i = 0; i < q->n; i++) {
+    if ((q->quantum[i] == 0) && (cb_read_avail(q->cb[i]) > 0)) return i;
+  }
+  // One round of topping up deficits
+  bool busy = false;
+  for (size_t k = 0; k < q->n; k++) {
+    uint8_t i = q->rr;
+    if ((q->quantum[i] != 0) && (cb_read_avail(q->cb[i]) > 0)) {
+      if (q->deficit[i] > 0) return i;
+      q->deficit[i] += q->quantum[i];
+      if (q->deficit[i] > 0) return i;
+      busy = true;
+    }
+    else {
+      q->deficit[i] = 0;
+    }
+    q->rr = (i + 1) % q->n;
+  }
+  if (!busy) return -1;
+
+  // Every ring with data is still more than a quantum behind - a whole
+  // frame is always sent, so one larger than the quantum can leave its ring
+  // several quanta in debt.  Give them all the rounds the nearest needs.
+  uint32_t rounds = UINT32_MAX;
+  for (size_t i = 0; i < q->n; i++) {
+    if ((q->quantum[i] != 0) && (cb_read_avail(q->cb[i]) > 0)) {
+      uint32_t r = (uint32_t) -q->deficit[i] / q->quantum[i] + 1;
+      if (r < rounds) rounds = r;
+    }
+  }
+  for (size_t i = 0; i < q->n; i++) {
+    if ((q->quantum[i] != 0) && (cb_read_avail(q->cb[i]) > 0)) {
+      q->deficit[i] += (int32_t) (rounds * q->quantum[i]);
+    }
+  }
+  for (size_t k = 0; k < q->n; k++) {
+    uint8_t i = q->rr;
+    if ((q->quantum[i] != 0) && (cb_read_avail(q->cb[i]) > 0) && (q->deficit[i] > 0)) {
+      return i;
+    }
+    q->rr = (i + 1) % q->n;
+  }
+  return -1;  // not reached
+}
+
+// Length of p[0..n) to send: whole frames up to budget bytes (at least one),
+// or to the end of p if it ends part way through a frame
+static inline size_t ucuart_txq_span(const uint8_t* p, size_t n, size_t budget,
+                                     bool* in_frame) {
+  size_t m = 0;
+  bool in = *in_frame;
+  while (m < n) {
+    if (!in) {
+      // Skip delimiters between frames
+      if (p[m++] != 0) in = true;
+      continue;
+    }
+    const uint8_t* z = memchr(p + m, 0, n - m);
+    if (z == NULL) {
+      m = n;
+      break;
+    }
+    m = z - p + 1;
+    in = false;
+    if (m >= budget) break;
+  }
+  *in_frame = in;
+  return m;
+}
+
+// Next span to send, 0 if there is nothing
+static inline size_t ucuart_txq_peek(ucuart_txq_t* q, const uint8_t** p) {
+  if (q->n == 0) return 0;
+
+  int i = q->cur;
+  if (!q->in_frame[i]) {
+    i = ucuart_txq_pick(q);
+    if (i < 0) return 0;
+  }
+  q->cur = i;
+
+  // A ring finishing a frame after its turn is over sends just that frame
+  size_t n = cb_peek_avail(q->cb[i]);
+  size_t budget = n;
+  if (q->quantum[i] != 0) budget = q->deficit[i] > 0 ? (size_t) q->deficit[i] : 1U;
+  q->span_in_frame = q->in_frame[i];
+  *p = cb_peek(q->cb[i]);
+  return ucuart_txq_span(*p, n, budget, &q->span_in_frame);
+}
+
+// The span from the last peek (n bytes of it) has been sent
+static inline void ucuart_txq_skip(ucuart_txq_t* q, size_t n) {
+  if (n == 0) return;
+  uint8_t i = q->cur;
+  cb_skip(q->cb[i], n);
+  q->sent[i] += n;
+  q->in_frame[i] = q->span_in_frame;
+  if (q->quantum[i] != 0) {
+    q->deficit[i] -= n;
+    // Turn over - next ring gets its quantum
+    if (!q->in_frame[i] && (q->deficit[i] <= 0)) q->rr = (i + 1) % q->n;
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,379 @@
+// © 2025 Unit Circle Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Map indexes (cbor_index.h), compiled schema helpers (cbor_schema.h) and
+// zero copy views (cbor_view.h).  These only use uccomm's public cbor.h API
+// so uccomm's cbor.c is built and used unchanged.
+//
+// The following flags can be defined
+// CBOR_NO_UTF8            - disables UTF8 checking of text views (as in
+//                           uccomm's cbor.c)
+// CBOR_NO_INDEX           - disables map indexing
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <cbor.h>
+#include <cbor_index.h>
+#include <cbor_schema.h>
+#include <cbor_view.h>
+
+#if !defined(CBOR_NO_UTF8)
+#include "utf8valid.h"
+#endif
+
+#define RET_ERROR(s, e) do { \
+  s->error = e; \
+  return e; \
+} while (false)
+
+#define CHECK(x) do { \
+  cbor_error_t e = x; \
+  if (e != CBOR_ERROR_NONE) { \
+    return e; \
+  } \
+} while(false)
+
+// Linear search of a map (as cbor_get_*() and cbor_unpack() do), for keys
+// that aren't in schema order.  st is left at the value following the key.
+static cbor_error_t get_textn_stream(const cbor_stream_t *s,
+                               const char* k, size_t key_n, cbor_stream_t* st) {
+  cbor_stream_t s2 = *s;
+  while (true) {
+    cbor_value_t v;
+    cbor_error_t e = cbor_read_any(&s2, &v);
+    if (e != CBOR_ERROR_NONE) {
+      if (e == CBOR_ERROR_END_OF_STREAM) return CBOR_ERROR_KEY_NOT_FOUND;
+      return e;
+    }
+    if ((v.type == CBOR_TYPE_TEXT) && (v.value.stream_v.n == key_n) &&
+        (cbor_memcmp(k, &(v.value.stream_v.s), key_n) == 0)) {
+      *st = s2;
+      return CBOR_ERROR_NONE;
+    }
+    CHECK(cbor_read_any(&s2, &v));
+  }
+}
+
+
+#if !defined(CBOR_NO_INDEX)
+// FNV-1a
+static uint32_t index_hash(const uint8_t* b, size_t n) {
+  uint32_t h = 2166136261U;
+  while (n-- > 0) {
+    h = (h ^ *b++) * 16777619U;
+  }
+  return h;
+}
+
+static uint32_t index_hash_int(int64_t k) {
+  uint8_t b[8];
+  uint64_t u = (uint64_t) k;
+  for (size_t i = 0; i < sizeof(b); i++) {
+    b[i] = (uint8_t) u;
+    u >>= 8;
+  }
+  return index_hash(b, sizeof(b));
+}
+
+// Hash of a key as read by cbor_read_any().  Returns false if the key is not
+// a type that can be looked up.
+static bool index_key_hash(const cbor_value_t* v, uint32_t* h) {
+  if (v->type == CBOR_TYPE_TEXT) {
+    const cbor_stream_t* ks = &(v->value.stream_v.s);
+    *h = index_hash(ks->b + ks->n - v->value.stream_v.n, v->value.stream_v.n);
+    return true;
+  }
+  if ((v->type == CBOR_TYPE_UINT) || (v->type == CBOR_TYPE_NINT)) {
+    int64_t k;
+    if (cbor_as_int64(v, &k) != CBOR_ERROR_NONE) return false;
+    *h = index_hash_int(k);
+    return true;
+  }
+  return false;
+}
+
+cbor_error_t cbor_index_map(cbor_index_t* idx, cbor_index_entry_t* e, size_t size,
+                            const cbor_stream_t* map, size_t n) {
+  if ((idx == NULL) || (e == NULL) || (map == NULL)) return CBOR_ERROR_NULL;
+  idx->e = NULL;
+  size_t slots = 4;
+  while (slots < n + n/2) slots <<= 1;
+  if (slots > size) return CBOR_ERROR_BUFFER_TOO_SMALL;
+
+  for (size_t i = 0; i < slots; i++) {
+    e[i].off = CBOR_INDEX_EMPTY;
+  }
+  cbor_stream_t s2 = *map;
+  for (size_t i = 0; i < n; i++) {
+    cbor_value_t v;
+    // map->n is what is left of the whole message, not the map's size, so
+    // the limit is on where the keys are
+    if ((size_t) (s2.b - map->b) >= CBOR_INDEX_EMPTY) return CBOR_ERROR_CANT_CONVERT_TYPE;
+    uint16_t off = (uint16_t) (s2.b - map->b);
+    // Indefinite length text keys can't be hashed in place
+    if ((s2.n > 0) && (s2.b[0] == 0x7f)) return CBOR_ERROR_CANT_CONVERT_TYPE;
+    CHECK(cbor_read_any(&s2, &v));
+    uint32_t h;
+    if (index_key_hash(&v, &h)) {
+      size_t slot = h & (slots - 1);
+      while (e[slot].off != CBOR_INDEX_EMPTY) {
+        slot = (slot + 1) & (slots - 1);
+      }
+      e[slot].hash = (uint16_t) (h >> 16);
+      e[slot].off = off;
+    }
+    CHECK(cbor_read_any(&s2, &v));
+  }
+  idx->map = *map;
+  idx->n = n;
+  idx->mask = slots - 1;
+  idx->e = e;
+  return CBOR_ERROR_NONE;
+}
+
+// Probe for hash h, calling match() on each candidate key until it returns
+// true.  st is left at the value following the key.
+static cbor_error_t index_find(const cbor_index_t* idx, uint32_t h,
+                               bool (*match)(const cbor_value_t*, const void*, size_t),
+                               const void* k, size_t key_n, cbor_stream_t* st) {
+  if ((idx == NULL) || (idx->e == NULL)) return CBOR_ERROR_NULL;
+  size_t slot = h & idx->mask;
+  while (idx->e[slot].off != CBOR_INDEX_EMPTY) {
+    if (idx->e[slot].hash == (uint16_t) (h >> 16)) {
+      cbor_stream_t s2 = idx->map;
+      cbor_value_t v;
+      s2.b += idx->e[slot].off;
+      s2.n -= idx->e[slot].off;
+      CHECK(cbor_read_any(&s2, &v));
+      if (match(&v, k, key_n)) {
+        *st = s2;
+        return CBOR_ERROR_NONE;
+      }
+    }
+    slot = (slot + 1) & idx->mask;
+  }
+  return CBOR_ERROR_KEY_NOT_FOUND;
+}
+
+static bool match_textn(const cbor_value_t* v, const void* k, size_t key_n) {
+  if (v->type != CBOR_TYPE_TEXT) return false;
+  if (v->value.stream_v.n != key_n) return false;
+  cbor_stream_t ks = v->value.stream_v.s;
+  return cbor_memcmp(k, &ks, key_n) == 0;
+}
+
+static bool match_int(const cbor_value_t* v, const void* k, size_t key_n) {
+  int64_t kk;
+  (void) key_n;
+  if ((v->type != CBOR_TYPE_UINT) && (v->type != CBOR_TYPE_NINT)) return false;
+  if (cbor_as_int64(v, &kk) != CBOR_ERROR_NONE) return false;
+  return kk == *(const int64_t*) k;
+}
+
+cbor_error_t cbor_index_find_textn(const cbor_index_t* idx, const char* k, size_t key_n, cbor_stream_t* st) {
+  uint32_t h = index_hash((const uint8_t*) k, key_n);
+  return index_find(idx, h, match_textn, k, key_n, st);
+}
+
+cbor_error_t cbor_index_find_int(const cbor_index_t* idx, int64_t k, cbor_stream_t* st) {
+  return index_find(idx, index_hash_int(k), match_int, &k, 0, st);
+}
+
+cbor_error_t cbor_index_get_any(const cbor_index_t* idx, const char* k, cbor_value_t* v) {
+  cbor_stream_t s2;
+  CHECK(cbor_index_find_textn(idx, k, strlen(k), &s2));
+  return cbor_read_any(&s2, v);
+}
+
+#define CBOR_INDEX_GET_0(name) \
+  cbor_error_t cbor_index_get_ ## name(const cbor_index_t* idx, const char* k) { \
+    cbor_value_t v; \
+    CHECK(cbor_index_get_any(idx, k, &v)); \
+    return cbor_as_ ## name(&v); \
+  }
+
+#define CBOR_INDEX_GET_1(name, type) \
+  cbor_error_t cbor_index_get_ ## name(const cbor_index_t* idx, const char* k, type* u) { \
+    cbor_value_t v; \
+    CHECK(cbor_index_get_any(idx, k, &v)); \
+    return cbor_as_ ## name(&v, u); \
+  }
+
+#define CBOR_INDEX_GET_2(name, type1, type2) \
+  cbor_error_t cbor_index_get_ ## name(const cbor_index_t* idx, const char* k, type1* r1, type2* r2) { \
+    cbor_value_t v; \
+    CHECK(cbor_index_get_any(idx, k, &v)); \
+    return cbor_as_ ## name(&v, r1, r2); \
+  }
+
+CBOR_INDEX_GET_1(uint64, uint64_t)
+CBOR_INDEX_GET_1(uint32, uint32_t)
+CBOR_INDEX_GET_1(uint16, uint16_t)
+CBOR_INDEX_GET_1(uint8, uint8_t)
+CBOR_INDEX_GET_1(int64, int64_t)
+CBOR_INDEX_GET_1(int32, int32_t)
+CBOR_INDEX_GET_1(int16, int16_t)
+CBOR_INDEX_GET_1(int8, int8_t)
+CBOR_INDEX_GET_1(bool, bool)
+CBOR_INDEX_GET_0(null)
+CBOR_INDEX_GET_0(undefined)
+CBOR_INDEX_GET_1(simple, uint8_t)
+CBOR_INDEX_GET_1(float64, float64_t)
+CBOR_INDEX_GET_1(datetime, float64_t)
+CBOR_INDEX_GET_2(tag, cbor_stream_t, uint64_t)
+CBOR_INDEX_GET_2(text, cbor_stream_t, size_t)
+CBOR_INDEX_GET_2(bytes, cbor_stream_t, size_t)
+CBOR_INDEX_GET_2(array, cbor_stream_t, size_t)
+CBOR_INDEX_GET_2(map, cbor_stream_t, size_t)
+
+#endif
+
+
+cbor_error_t cbor_schema_field(const cbor_stream_t* map, cbor_stream_t* cur,
+                               const char* k, size_t key_n, cbor_value_t* v) {
+  cbor_stream_t s2 = *cur;
+  // Fast path - keys in schema order
+  if (s2.n > 0) {
+    CHECK(cbor_read_any(&s2, v));
+    if ((v->type == CBOR_TYPE_TEXT) && (v->value.stream_v.n == key_n) &&
+        (cbor_memcmp(k, &(v->value.stream_v.s), key_n) == 0)) {
+      CHECK(cbor_read_any(&s2, v));
+      *cur = s2;
+      return CBOR_ERROR_NONE;
+    }
+  }
+  CHECK(get_textn_stream(map, k, key_n, &s2));
+  CHECK(cbor_read_any(&s2, v));
+  *cur = s2;
+  return CBOR_ERROR_NONE;
+}
+
+cbor_error_t cbor_schema_write_text(cbor_stream_t* s, const char* t, size_t size) {
+  size_t n = strnlen(t, size);
+  if (n == size) RET_ERROR(s, CBOR_ERROR_BUFFER_TOO_SMALL);
+  return cbor_write_textn(s, t, n);
+}
+
+cbor_error_t cbor_schema_write_bytes(cbor_stream_t* s, const uint8_t* b, size_t n, size_t size) {
+  if (n > size) RET_ERROR(s, CBOR_ERROR_BUFFER_TOO_SMALL);
+  return cbor_write_bytes(s, b, n);
+}
+
+cbor_error_t cbor_schema_as_text(const cbor_value_t* v, char* t, size_t size) {
+  cbor_stream_t ts;
+  size_t n;
+  CHECK(cbor_as_text(v, &ts, &n));
+  if (n >= size) return CBOR_ERROR_BUFFER_TOO_SMALL;
+  CHECK(cbor_memmove(t, &ts, n));
+  t[n] = '\0';
+  return CBOR_ERROR_NONE;
+}
+
+cbor_error_t cbor_schema_as_bytes(const cbor_value_t* v, uint8_t* b, size_t* n, size_t size) {
+  cbor_stream_t bs;
+  CHECK(cbor_as_bytes(v, &bs, n));
+  if (*n > size) return CBOR_ERROR_BUFFER_TOO_SMALL;
+  return cbor_memmove(b, &bs, *n);
+}
+
+
+bool cbor_view_text_valid(const cbor_view_t* r) {
+#if !defined(CBOR_NO_UTF8)
+  return is_valid_utf8((const char*) r->b, r->n);
+#else
+  (void) r;
+  return true;
+#endif
+}
+
+static cbor_error_t as_view(const cbor_value_t* v, cbor_type_t ty, cbor_view_t* r) {
+  if (v->type != ty) return CBOR_ERROR_CANT_CONVERT_TYPE;
+  const cbor_stream_t* vs = &(v->value.stream_v.s);
+  // Indefinite length strings are in chunks - they have to be copied
+  if ((vs->b[0] & 0x1f) == 31) return CBOR_ERROR_CANT_CONVERT_TYPE;
+  r->b = vs->b + vs->n - v->value.stream_v.n;
+  r->n = v->value.stream_v.n;
+  return CBOR_ERROR_NONE;
+}
+
+cbor_error_t cbor_as_text_view(const cbor_value_t* v, cbor_view_t* r) {
+  return as_view(v, CBOR_TYPE_TEXT, r);
+}
+
+cbor_error_t cbor_as_bytes_view(const cbor_value_t* v, cbor_view_t* r) {
+  return as_view(v, CBOR_TYPE_BYTES, r);
+}
+
+// View of the definite length string of major type mt at the start of s.
+// The head is decoded here rather than by cbor_read_any() so text isn't
+// UTF-8 checked until cbor_view_text_valid().  Anything else is skipped, as
+// cbor_read_text()/cbor_read_bytes() do.
+static cbor_error_t read_view(cbor_stream_t* s, uint8_t mt, cbor_view_t* r) {
+  if (s->n < 1) RET_ERROR(s, CBOR_ERROR_END_OF_STREAM);
+  uint8_t ai = s->b[0] & 0x1f;
+  if (((s->b[0] >> 5) != mt) || (ai >= 28)) {
+    cbor_value_t v;
+    CHECK(cbor_read_any(s, &v));
+    return CBOR_ERROR_CANT_CONVERT_TYPE;
+  }
+  size_t h = 1;
+  uint64_t n = ai;
+  if (ai >= 24) {
+    size_t w = 1U << (ai - 24U);
+    if (s->n < 1 + w) RET_ERROR(s, CBOR_ERROR_END_OF_STREAM);
+    n = 0;
+    while (h <= w) {
+      n = (n << 8) + s->b[h++];
+    }
+  }
+  if (n > s->n - h) RET_ERROR(s, CBOR_ERROR_END_OF_STREAM);
+  r->b = s->b + h;
+  r->n = (size_t) n;
+  s->b += h + n;
+  s->n -= h + n;
+  return CBOR_ERROR_NONE;
+}
+
+cbor_error_t cbor_read_text_view(cbor_stream_t* s, cbor_view_t* r) {
+  return read_view(s, 3, r);
+}
+
+cbor_error_t cbor_read_bytes_view(cbor_stream_t* s, cbor_view_t* r) {
+  return read_view(s, 2, r);
+}
+
+// Key lookup as cbor_get_any() over the n entries of s
+static cbor_error_t get_view(cbor_stream_t* s, size_t n, const char* k, uint8_t mt, cbor_view_t* r) {
+  cbor_stream_t s2 = *s;
+  size_t key_n = strlen(k);
+  while (n-- > 0) {
+    cbor_value_t v;
+    CHECK(cbor_read_any(&s2, &v));
+    if ((v.type == CBOR_TYPE_TEXT) && (v.value.stream_v.n == key_n) &&
+        (cbor_memcmp(k, &(v.value.stream_v.s), key_n) == 0)) {
+      return read_view(&s2, mt, r);
+    }
+    CHECK(cbor_read_any(&s2, &v));
+  }
+  return CBOR_ERROR_KEY_NOT_FOUND;
+}
+
+cbor_error_t cbor_get_text_view(cbor_stream_t* s, size_t n, const char* k, cbor_view_t* r) {
+  return get_view(s, n, k, 3, r);
+}
+
+cbor_error_t cbor_get_bytes_view(cbor_stream_t* s, size_t n, const char* k, cbor_view_t* r) {
+  return get_view(s, n, k, 2, r);
+}
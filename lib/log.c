@@ -18,7 +18,7 @@
 #include <stdint.h>
 
 #include "log.h"
-#include "cobs.h"
+#include "log_cbor.h"
 #include "cb.h"
 
 #if CONFIG_UC_LOG_SAVE
@@ -34,6 +34,8 @@
 typedef struct {
   const uart_t* uart;
   bool    tx_enabled;
+  const log_tx_sink_t* tx_owner;  // tx stream that owns port_cb
+  uint32_t tx_dropped;            // port messages dropped while it did
 } log_data_t;
 
 static log_data_t log_data;
@@ -42,40 +44,295 @@ static log_data_t log_data;
 #define CONFIG_UC_LOG_BUF_SIZE (4096*2)
 #endif
 
+#if !defined(CONFIG_UC_LOG_URGENT_BUF_SIZE)
+#define CONFIG_UC_LOG_URGENT_BUF_SIZE (512)
+#endif
+
+#if !defined(CONFIG_UC_LOG_PORT_BUF_SIZE)
+#define CONFIG_UC_LOG_PORT_BUF_SIZE (4096)
+#endif
+
+#if !defined(CONFIG_UC_LOG_TX_PORT_SHARE)
+#define CONFIG_UC_LOG_TX_PORT_SHARE (50)
+#endif
+
+#if !defined(CONFIG_UC_LOG_TX_QUANTUM)
+#define CONFIG_UC_LOG_TX_QUANTUM (512)
+#endif
+
+// Both weighted rings need a quantum that fits ucuart_txq_add()'s uint16_t
+// and doesn't round down to 0 (which would make the ring strict priority)
+#define LOG_TX_PORT_QUANTUM \
+  (CONFIG_UC_LOG_TX_QUANTUM * CONFIG_UC_LOG_TX_PORT_SHARE / 100)
+#define LOG_TX_LOG_QUANTUM \
+  (CONFIG_UC_LOG_TX_QUANTUM * (100 - CONFIG_UC_LOG_TX_PORT_SHARE) / 100)
+#if (LOG_TX_PORT_QUANTUM < 1) || (LOG_TX_PORT_QUANTUM > 65535) || \
+    (LOG_TX_LOG_QUANTUM < 1) || (LOG_TX_LOG_QUANTUM > 65535)
+#error "CONFIG_UC_LOG_TX_QUANTUM * CONFIG_UC_LOG_TX_PORT_SHARE gives a TX quantum outside 1..65535"
+#endif
+
+// TX rings, sent by the UART driver at frame boundaries (ucuart_txq.h):
+//   urgent_cb - ERROR/FATAL log messages, strict priority
+//   port_cb   - log server port messages, CONFIG_UC_LOG_TX_PORT_SHARE % of
+//               the UART when the log is busy too
+//   tx_cb     - all other log messages, the rest
+// so a burst of log output can't hold up an RPC reply (or the other way
+// around) for more than a CONFIG_UC_LOG_TX_QUANTUM byte turn.
 static NOCLEAR cb_t    tx_cb;
 static NOCLEAR uint8_t tx_buf[CONFIG_UC_LOG_BUF_SIZE];
+static NOCLEAR cb_t    urgent_cb;
+static NOCLEAR uint8_t urgent_buf[CONFIG_UC_LOG_URGENT_BUF_SIZE];
+static cb_t    port_cb;
+static uint8_t port_buf[CONFIG_UC_LOG_PORT_BUF_SIZE];
+static ucuart_txq_t tx_q;
 
 static size_t strnlen_s (const char* s, size_t n) {
   const char* found = memchr(s, '\0', n);
   return found ? (size_t)(found-s) : n;
 }
 
+static void sink_cut(const log_tx_sink_t* k);
+
 void log_panic_(void) {
+  // Abandon any tx stream so the fatal message gets out
+  if (log_data.tx_owner != NULL) {
+    sink_cut(log_data.tx_owner);
+    log_data.tx_owner = NULL;
+  }
   if (log_data.uart != NULL) {
     ucuart_panic(log_data.uart);
   }
 }
 
-static void tx_buffer(const uint8_t* b, size_t n);
+// Call sites
+//
+// A log message starts with its call site and type (0 log, 1 memory) - the
+// address of its .logstr string with the type in bits 0-1, or with
+// CONFIG_UC_LOG_CALLSITE_ID a LEB128 varint of index << 4 | type, where
+// index is the call site's entry in .logidx (see include/log.h and
+// lib/log.ld).  The indices are dense so the first 8 call sites linked in
+// take 1 byte and the first 1024 2 bytes.  Bits 2-3 are left clear for log
+// compression either way.  uclog.py --callsite-ids reads the varints.
+#if defined(CONFIG_UC_LOG_CALLSITE_ID)
+#define LOG_SITE_SIZE (5)
+
+extern const char* const _slogidx[];
+
+static inline uint32_t site_index(const char* prefix) {
+  return (const char* const*) prefix - _slogidx;
+}
+
+static size_t put_site(uint8_t* b, const char* prefix, uint8_t type) {
+  uint32_t v = (site_index(prefix) << 4) | type;
+  size_t n = 0;
+  while (v >= 0x80) {
+    b[n++] = (v & 0x7f) | 0x80;
+    v >>= 7;
+  }
+  b[n++] = v;
+  return n;
+}
+#else
+#define LOG_SITE_SIZE (4)
+
+static inline uint32_t site_index(const char* prefix) {
+  return (uintptr_t) prefix >> 4;
+}
 
-void log_log1_(const char *prefix) {
+static size_t put_site(uint8_t* b, const char* prefix, uint8_t type) {
   union {
     const void* p;
     uint8_t v[sizeof(const void*)];
   } v;
-  uint8_t b[5+2];
 
   v.p = prefix;
-  v.v[0] = (v.v[0] & 0xfc) | 0x00;
-  memmove(b+2, v.v, 4);
-  size_t n = cobs_enc(b+1, b+2, 4); // inplace
+  v.v[0] = (v.v[0] & 0xfc) | type;
+  memmove(b, v.v, 4);
+  return 4;
+}
+#endif
+
+#if defined(CONFIG_UC_LOG_COMPRESS)
+// Log compression
+//
+// High rate log messages come from a few call sites with much the same
+// arguments each time, so a message is sent as a delta against the previous
+// one from its call site when that is smaller:
+//
+//   plain     ptr[4] args              bits 2-3 of ptr clear
+//   keyframe  ptr[4] slot seq args     bit 2 of ptr set - host keeps the
+//                                      args
+//   delta     hdr slot map changed     hdr = seq << 4 | 0x08, bit i of map
+//                                      set if args byte i changed, then the
+//                                      changed bytes
+//
+// .logstr is LOG_STRING_ALIGN (16) byte aligned so bits 2-3 of ptr are free.
+// With CONFIG_UC_LOG_CALLSITE_ID ptr is the call site varint instead.  A call
+// site uses slot site_index() % CONFIG_UC_LOG_COMPRESS_SLOTS.  seq counts
+// the messages sent from the slot (mod 16), so the host can tell when it has
+// lost one (ring overrun, frame check error) and drops deltas until the next
+// keyframe.  At least every CONFIG_UC_LOG_COMPRESS_KEY_INTERVAL messages from
+// a call site is a keyframe.
+//
+// Messages with more than CONFIG_UC_LOG_COMPRESS_MAX argument bytes, memory
+// dumps and ERROR/FATAL messages (sent from another ring, so out of order
+// with the rest) are sent plain.  A slot is busy from when it is updated
+// until the message is in the TX ring, so deltas reach the host in order -
+// a message for a busy slot (an ISR logging while the slot's call site is
+// part way through) is sent plain too.  uclog.py --compress expands them.
+
+#if !defined(CONFIG_UC_LOG_COMPRESS_SLOTS)
+#define CONFIG_UC_LOG_COMPRESS_SLOTS (32)
+#endif
+
+#if !defined(CONFIG_UC_LOG_COMPRESS_MAX)
+#define CONFIG_UC_LOG_COMPRESS_MAX (32)
+#endif
+
+#if !defined(CONFIG_UC_LOG_COMPRESS_KEY_INTERVAL)
+#define CONFIG_UC_LOG_COMPRESS_KEY_INTERVAL (16)
+#endif
+
+#define LOG_KEYFRAME (0x04)
+#define LOG_DELTA    (0x08)
+#define LOG_KEY_SPARE (2) // keyframe slot and seq bytes
+
+typedef struct {
+  const char* prefix;   // call site
+  bool    busy;
+  uint8_t seq;          // messages sent from the slot (mod 16)
+  uint8_t run;          // deltas since the keyframe
+  uint8_t n;            // argument bytes
+  uint8_t b[CONFIG_UC_LOG_COMPRESS_MAX];
+} log_ref_t;
+
+static log_ref_t log_refs[CONFIG_UC_LOG_COMPRESS_SLOTS];
+static log_compress_stats_t compress_stats;
+
+void log_compress_stats(log_compress_stats_t* stats) {
+  uint32_t key = irq_lock();
+  *stats = compress_stats;
+  irq_unlock(key);
+}
+
+// r holds a log message of *n bytes (hn byte call site then arguments) with
+// room for LOG_KEY_SPARE more.  Rewritten in place as a keyframe or delta,
+// unless it is to be sent plain.  Returns the slot to release once the
+// message is in the TX ring, NULL if none.
+static log_ref_t* compress(uint8_t level, const char* prefix, uint8_t* r, size_t hn,
+                           size_t* n) {
+  size_t raw = *n;
+  const uint8_t* a = r + hn;
+  size_t an = raw - hn;
+  log_ref_t* ref = &log_refs[site_index(prefix) % CONFIG_UC_LOG_COMPRESS_SLOTS];
+
+  uint32_t key = irq_lock();
+  compress_stats.records++;
+  compress_stats.raw += raw;
+  if ((level >= LOG_LVL_ERROR) || (an > CONFIG_UC_LOG_COMPRESS_MAX) || ref->busy) {
+    compress_stats.sent += raw;
+    irq_unlock(key);
+    return NULL;
+  }
+  ref->busy = true;
+  irq_unlock(key);
+
+  // The slot is ours until compress_done()
+  uint8_t d[2 + (CONFIG_UC_LOG_COMPRESS_MAX + 7) / 8 + CONFIG_UC_LOG_COMPRESS_MAX];
+  size_t dn = 0;
+  ref->seq = (ref->seq + 1) & 0xf;
+  if ((ref->prefix == prefix) && (ref->n == an) &&
+      (ref->run + 1 < CONFIG_UC_LOG_COMPRESS_KEY_INTERVAL)) {
+    size_t mn = (an + 7) / 8;
+    d[0] = (ref->seq << 4) | LOG_DELTA;
+    d[1] = ref - log_refs;
+    memset(d + 2, 0, mn);
+    dn = 2 + mn;
+    for (size_t i = 0; i < an; i++) {
+      if (a[i] != ref->b[i]) {
+        d[2 + i / 8] |= 1 << (i % 8);
+        d[dn++] = a[i];
+      }
+    }
+    // No smaller than a keyframe
+    if (dn >= raw + LOG_KEY_SPARE) dn = 0;
+  }
+  ref->prefix = prefix;
+  ref->n = an;
+  memmove(ref->b, a, an);
+  if (dn != 0) {
+    ref->run++;
+    memmove(r, d, dn);
+    *n = dn;
+  }
+  else {
+    ref->run = 0;
+    memmove(r + hn + 2, r + hn, an);
+    r[0] |= LOG_KEYFRAME;
+    r[hn] = ref - log_refs;
+    r[hn + 1] = ref->seq;
+    *n = raw + LOG_KEY_SPARE;
+  }
+
+  key = irq_lock();
+  if (dn != 0) compress_stats.deltas++;
+  else compress_stats.keyframes++;
+  compress_stats.sent += *n;
+  irq_unlock(key);
+  return ref;
+}
+
+// Called with interrupts locked
+static void compress_done(log_ref_t* ref) {
+  if (ref != NULL) ref->busy = false;
+}
+
+#else
+
+#define LOG_KEY_SPARE (0)
+
+typedef struct {
+  bool busy;
+} log_ref_t;
+
+static inline log_ref_t* compress(uint8_t level, const char* prefix, uint8_t* r, size_t hn,
+                                  size_t* n) {
+  (void) level;
+  (void) prefix;
+  (void) r;
+  (void) hn;
+  (void) n;
+  return NULL;
+}
+
+static inline void compress_done(log_ref_t* ref) {
+  (void) ref;
+}
+
+#endif
+
+static void tx_buffer(uint8_t level, const uint8_t* b, size_t n, log_ref_t* ref);
+
+// b+2 holds a log message of n bytes (hn byte call site first) with room for
+// LOG_KEY_SPARE + LOG_CRC_SIZE more, b[0..1] are for the framing
+static void tx_log(uint8_t level, const char* prefix, uint8_t* b, size_t hn, size_t n) {
+  log_ref_t* ref = compress(level, prefix, b+2, hn, &n);
+  n += log_crc_put(b+2+n, log_crc(LOG_CRC_INIT, b+2, n));
+  n = log_cobs_enc(b+1, b+2, n); // inplace
   b[0] = 0x00;
   b[1+n] = 0x00;
-  tx_buffer(b, n+2);
+  tx_buffer(level, b, n+2, ref);
   if (log_data.tx_enabled) ucuart_tx_schedule(log_data.uart, NULL, 0);
 }
 
-void log_logn_(const char* fmt, const char *prefix,  ...) {
+void log_log1_(uint8_t level, const char *prefix) {
+  uint8_t b[LOG_SITE_SIZE+1+2+LOG_KEY_SPARE+LOG_CRC_SIZE];
+
+  size_t hn = put_site(b+2, prefix, 0x00);
+  tx_log(level, prefix, b, hn, hn);
+}
+
+void log_logn_(uint8_t level, const char* fmt, const char *prefix,  ...) {
   union {
     unsigned int u;
     unsigned long long int ull;
@@ -86,14 +343,12 @@ void log_logn_(const char* fmt, const char *prefix,  ...) {
   } v;
 
   uint8_t b[100]; // Limits total packet size - code below expect less than 253
-  size_t n = sizeof(b)-1-2;
+  size_t n = sizeof(b)-1-2-LOG_KEY_SPARE-LOG_CRC_SIZE;
   uint8_t* bb = b+1+1;
   size_t sn;
 
-  v.p = prefix;
-  v.v[0] = (v.v[0] & 0xfc) | 0x00;
-  memmove(bb, v.v, 4);
-  bb += 4; n -= 4;
+  size_t hn = put_site(bb, prefix, 0x00);
+  bb += hn; n -= hn;
 
   va_list args;
   va_start(args, prefix);
@@ -143,32 +398,29 @@ void log_logn_(const char* fmt, const char *prefix,  ...) {
     }
   }
 done:
-  n = cobs_enc(b+1, b+1+1, sizeof(b) -2 - 1 - n); // inplace
-  b[0] = 0x00;
-  b[1+n] = 0x00;
-  tx_buffer(b, n+2);
-  if (log_data.tx_enabled) ucuart_tx_schedule(log_data.uart, NULL, 0);
+  va_end(args);
+  tx_log(level, prefix, b, hn, bb-(b+2));
 }
 
-void log_mem_(const char *prefix, const void* b, size_t n) {
+void log_mem_(uint8_t level, const char *prefix, const void* b, size_t n) {
   union {
     const void* p;
     uint8_t v[sizeof(const void*)];
   } v;
   uint8_t bb[100];
 
-  if (n + 8 + 1 + 2> 100) n = 100 - 8 - 1 - 2;
+  size_t hn = put_site(bb+2, prefix, 0x01);
+  if (n + hn + 4 + 1 + 2 + LOG_CRC_SIZE > 100) n = 100 - hn - 4 - 1 - 2 - LOG_CRC_SIZE;
 
-  v.p = prefix;
-  v.v[0] = (v.v[0] & 0xfc) | 0x01;
-  memmove(bb+2, v.v, 4);
   v.p = b;
-  memmove(bb+2+4, v.v, 4);
-  memmove(bb+2+8, b, n);
-  n = cobs_enc(bb+1, bb+2, 8+n); // inplace
+  memmove(bb+2+hn, v.v, 4);
+  memmove(bb+2+hn+4, b, n);
+  n += hn + 4;
+  n += log_crc_put(bb+2+n, log_crc(LOG_CRC_INIT, bb+2, n));
+  n = log_cobs_enc(bb+1, bb+2, n); // inplace
   bb[0] = 0x00;
   bb[1+n] = 0x00;
-  tx_buffer(bb, n+2);
+  tx_buffer(level, bb, n+2, NULL);
   if (log_data.tx_enabled) ucuart_tx_schedule(log_data.uart, NULL, 0);
 }
 
@@ -179,13 +431,15 @@ void log_tx_suspend(void) {
 
 void log_tx_resume(void) {
   log_data.tx_enabled = true;
-  static uint8_t b[1+LOG_APP_HASH_SIZE+1+2];
+  static uint8_t b[1+LOG_APP_HASH_SIZE+1+2+LOG_CRC_SIZE];
 
   // A app hash on each resume to identify the device
   // so that the correct uclog decoder file can be loaded
   b[2] = (63 << 2) | 3;
   memmove(b + 3, log_app_hash(NULL), LOG_APP_HASH_SIZE);
-  size_t n = cobs_enc(b + 1, b + 2, LOG_APP_HASH_SIZE + 1);
+  size_t n = LOG_APP_HASH_SIZE + 1;
+  n += log_crc_put(b + 2 + n, log_crc(LOG_CRC_INIT, b + 2, n));
+  n = log_cobs_enc(b + 1, b + 2, n);
   b[0] = '\0';
   b[n+1] = '\0';
   ucuart_tx_schedule(log_data.uart, b, n+2);
@@ -210,28 +464,295 @@ __attribute__((noreturn)) void log_fatal_(void) {
   NVIC_SystemReset();
 }
 
-static void tx_buffer(const uint8_t* b, size_t n) {
+static void tx_buffer(uint8_t level, const uint8_t* b, size_t n, log_ref_t* ref) {
+  cb_t* cb = level >= LOG_LVL_ERROR ? &urgent_cb : &tx_cb;
+  uint32_t key = irq_lock();
+  cb_write(cb, b, n);
+  compress_done(ref);
+  irq_unlock(key);
+}
+
+// TX streams
+//
+// Port frames are COBS encoded in place in port_cb.  The code byte of each
+// block is reserved when the block starts and filled in when it ends;
+// complete blocks are committed (port_cb.write) so the UART can send the
+// start of a long frame while the rest is being encoded.  Nothing else may
+// write to port_cb while this happens - see tx_claim().  The UART won't
+// switch rings part way through the frame, so log messages wait too.
+
+static size_t ring_next(size_t i) {
+  return i + 1 == port_cb.n ? 0 : i + 1;
+}
+
+// Bytes that can be written from w on
+static size_t ring_free(size_t w) {
+  size_t r = port_cb.read;
+  return (r > w ? r : r + port_cb.n) - w - 1;
+}
+
+// Room for one more byte at k->w, keeping one spare after it for the frame
+// delimiter (or sink_cut()'s 0xff before it)
+static bool sink_room(log_tx_sink_t* k) {
+  while (ring_free(k->w) < 2) {
+    port_cb.write = k->code_pos;
+    if (!log_data.tx_enabled || k_is_in_isr() || (port_cb.read == k->code_pos)) {
+      return false;
+    }
+    ucuart_tx_schedule(log_data.uart, NULL, 0);
+    k_sleep(K_MSEC(1));
+  }
+  return true;
+}
+
+static void sink_byte(log_tx_sink_t* k, uint8_t c) {
+  if (k->error) return;
+  if (!sink_room(k)) {
+    k->error = true;
+    return;
+  }
+  ((uint8_t*) port_cb.b)[k->w] = c;
+  k->w = ring_next(k->w);
+}
+
+// Copy b[0..n) to the ring, as much at a time as fits before the end of the
+// ring or the read pointer
+static void sink_bytes(log_tx_sink_t* k, const uint8_t* b, size_t n) {
+  while ((n > 0) && !k->error) {
+    if (!sink_room(k)) {
+      k->error = true;
+      return;
+    }
+    size_t m = ring_free(k->w) - 1;
+    if (m > port_cb.n - k->w) m = port_cb.n - k->w;
+    if (m > n) m = n;
+    memmove((uint8_t*) port_cb.b + k->w, b, m);
+    k->w += m;
+    if (k->w == port_cb.n) k->w = 0;
+    b += m;
+    n -= m;
+  }
+}
+
+// End the current COBS block and start the next.  The next code byte must
+// fit first, so on overrun code_pos is still an open block for sink_cut().
+static void sink_block(log_tx_sink_t* k) {
+  if (k->error) return;
+  if (!sink_room(k)) {
+    k->error = true;
+    return;
+  }
+  ((uint8_t*) port_cb.b)[k->code_pos] = k->code;
+  k->code_pos = k->w;
+  k->code = 1;
+  sink_byte(k, 0); // code placeholder
+  port_cb.write = k->code_pos;
+}
+
+// Runs of non zero bytes are found a word at a time and copied in one go.
+// Once the ring has overrun (k->error) code is stale and nothing is written,
+// so stop.
+static void sink_cobs(log_tx_sink_t* k, const uint8_t* b, size_t n) {
+  while ((n > 0) && !k->error) {
+    size_t lim = 0xff - k->code;
+    if (lim > n) lim = n;
+    size_t m = log_cobs_zero(b, lim);
+    sink_bytes(k, b, m);
+    k->code += m;
+    b += m;
+    n -= m;
+    if (k->code == 0xff) {
+      sink_block(k);
+    }
+    else if (m < lim) {
+      sink_block(k); // b[0] is a zero
+      b++;
+      n--;
+    }
+  }
+}
+
+static void sink_put(log_tx_sink_t* k, const uint8_t* b, size_t n) {
+  k->crc = log_crc(k->crc, b, n);
+  sink_cobs(k, b, n);
+}
+
+static void sink_start(log_tx_sink_t* k, uint8_t h) {
+  k->error = false;
+  k->crc = LOG_CRC_INIT;
+  k->w = port_cb.write;
+  k->code_pos = k->w;
+  sink_byte(k, 0);
+  k->code_pos = k->w;
+  k->code = 1;
+  sink_byte(k, 0); // code placeholder
+  sink_put(k, &h, 1);
+}
+
+// Drop the partial block and end the frame so the UART can move on to the
+// other rings.  The complete blocks already committed would decode as a
+// valid (short) frame, so they are followed by a 0xff code byte with no data
+// after it, which every COBS decoder rejects.  sink_room()'s spare byte makes
+// room for both, except when the first code byte didn't fit - then the frame
+// is left empty.
+static void sink_cut(const log_tx_sink_t* k) {
+  port_cb.write = k->code_pos;
+  size_t room = ring_free(port_cb.write);
+  if (room >= 2) {
+    ((uint8_t*) port_cb.b)[port_cb.write] = 0xff;
+    port_cb.write = ring_next(port_cb.write);
+  }
+  if (room >= 1) {
+    ((uint8_t*) port_cb.b)[port_cb.write] = 0;
+    port_cb.write = ring_next(port_cb.write);
+  }
+}
+
+static void sink_end(log_tx_sink_t* k) {
+#if LOG_CRC_SIZE
+  uint8_t t[LOG_CRC_SIZE];
+  sink_cobs(k, t, log_crc_put(t, k->crc));
+#endif
+  if (k->error) {
+    sink_cut(k);
+    return;
+  }
+  ((uint8_t*) port_cb.b)[k->code_pos] = k->code;
+  ((uint8_t*) port_cb.b)[k->w] = 0; // in the spare sink_room() kept
+  port_cb.write = ring_next(k->w);
+}
+
+// Take ownership of port_cb.  Threads wait for another stream to finish, an
+// ISR can't so its message is dropped.
+static bool tx_claim(const log_tx_sink_t* k) {
+  while (true) {
+    uint32_t key = irq_lock();
+    bool owned = log_data.tx_owner != NULL;
+    if (owned) {
+      if (k_is_in_isr()) log_data.tx_dropped++;
+    }
+    else {
+      log_data.tx_owner = k;
+    }
+    irq_unlock(key);
+    if (!owned) return true;
+    if (k_is_in_isr()) return false;
+    k_sleep(K_MSEC(1));
+  }
+}
+
+static void tx_release(void) {
   uint32_t key = irq_lock();
-  cb_write(&tx_cb, b, n);
+  uint32_t dropped = log_data.tx_dropped;
+  log_data.tx_owner = NULL;
+  log_data.tx_dropped = 0;
   irq_unlock(key);
+  if (dropped != 0) LOG_WARN("%u port messages dropped during tx", (unsigned) dropped);
+  if (log_data.tx_enabled) ucuart_tx_schedule(log_data.uart, NULL, 0);
 }
 
 void log_tx(uint8_t port, const uint8_t* data, size_t n) {
-  static uint8_t b[COBS_ENC_SIZE(LOG_MAX_PACKET_SIZE+1)+2];
+  log_tx_sink_t k;
 
   if (n > LOG_MAX_PACKET_SIZE) LOG_FATAL("tx message too long %zu", n);
   if (63 < port) LOG_FATAL("invalid port %d", port);
-  b[sizeof(b)-(LOG_MAX_PACKET_SIZE+1)] = (port << 2) | 3;
-  memmove(b+sizeof(b)-LOG_MAX_PACKET_SIZE, data, n);
-  n = cobs_enc(b+1, b+sizeof(b)-(LOG_MAX_PACKET_SIZE+1), n + 1);
-  b[0] = '\0';
-  b[n+1] = '\0';
-  tx_buffer(b, n+2);
-  if (log_data.tx_enabled) ucuart_tx_schedule(log_data.uart, NULL, 0);
+  if (!tx_claim(&k)) return;
+  sink_start(&k, (port << 2) | 3);
+  sink_put(&k, data, n);
+  sink_end(&k);
+  tx_release();
+}
+
+bool log_tx_frame_(uint8_t type, uint8_t port, const uint8_t* h, size_t hn,
+                   const uint8_t* data, size_t n, const uint8_t* t, size_t tn) {
+  log_tx_sink_t k;
+
+  if (!tx_claim(&k)) return false;
+  sink_start(&k, (port << 2) | type);
+  sink_put(&k, h, hn);
+  sink_put(&k, data, n);
+  sink_put(&k, t, tn);
+  sink_end(&k);
+  tx_release();
+  return !k.error;
+}
+
+cbor_stream_t* log_tx_begin(log_tx_stream_t* ts, uint8_t port) {
+  if (63 < port) LOG_FATAL("invalid port %d", port);
+  cbor_init(&ts->s, ts->b, sizeof(ts->b));
+  if (tx_claim(&ts->sink)) {
+    sink_start(&ts->sink, (port << 2) | 3);
+  }
+  else {
+    // Nothing will be sent
+    ts->sink.error = true;
+  }
+  return &ts->s;
+}
+
+static void tx_flush(log_tx_stream_t* ts) {
+  if (ts->s.error != CBOR_ERROR_NONE) ts->sink.error = true;
+  sink_put(&ts->sink, ts->b, cbor_read_avail(&ts->s));
+  cbor_init(&ts->s, ts->b, sizeof(ts->b));
+}
+
+cbor_stream_t* log_tx_cbor(log_tx_stream_t* ts, size_t n) {
+  if (ts->s.n < n) tx_flush(ts);
+  return &ts->s;
+}
+
+// Definite length string - head, then contents straight from b
+static void tx_string(log_tx_stream_t* ts, uint8_t mt, const uint8_t* b, size_t n) {
+  uint8_t h[5];
+  size_t hn;
+  mt <<= 5;
+  if (n < 24) {
+    h[0] = mt | n;
+    hn = 1;
+  }
+  else if (n < 0x100) {
+    h[0] = mt | 24;
+    h[1] = n;
+    hn = 2;
+  }
+  else if (n < 0x10000) {
+    h[0] = mt | 25;
+    h[1] = n >> 8;
+    h[2] = n;
+    hn = 3;
+  }
+  else {
+    h[0] = mt | 26;
+    h[1] = n >> 24;
+    h[2] = n >> 16;
+    h[3] = n >> 8;
+    h[4] = n;
+    hn = 5;
+  }
+  tx_flush(ts);
+  sink_put(&ts->sink, h, hn);
+  sink_put(&ts->sink, b, n);
+}
+
+void log_tx_text(log_tx_stream_t* ts, const char* t, size_t n) {
+  tx_string(ts, 3, (const uint8_t*) t, n);
+}
+
+void log_tx_bytes(log_tx_stream_t* ts, const uint8_t* b, size_t n) {
+  tx_string(ts, 2, b, n);
+}
+
+bool log_tx_end(log_tx_stream_t* ts) {
+  bool owner = log_data.tx_owner == &ts->sink;
+  tx_flush(ts);
+  if (!owner) return false;
+  sink_end(&ts->sink);
+  tx_release();
+  return !ts->sink.error;
 }
 
 size_t log_tx_avail(void) {
-  return cb_write_avail(&tx_cb);
+  return cb_write_avail(&port_cb);
 }
 
 #define LOG_APP_HASH_SIZE 64
@@ -251,7 +772,7 @@ static const __attribute__((section(".apphash"))) uint8_t app_hash__[LOG_APP_HAS
 static NOCLEAR uint8_t app_hash[LOG_APP_HASH_SIZE];
 
 static uint8_t saved_app_hash[LOG_APP_HASH_SIZE];
-static uint8_t saved_log[CONFIG_UC_LOG_BUF_SIZE];
+static uint8_t saved_log[CONFIG_UC_LOG_BUF_SIZE + CONFIG_UC_LOG_URGENT_BUF_SIZE];
 static size_t saved_log_n;
 
 const uint8_t* log_saved_log(size_t* n) {
@@ -264,36 +785,37 @@ const uint8_t* log_saved_app_hash(size_t* n) {
   return saved_app_hash;
 }
 
+static bool cb_valid(const cb_t* cb, const uint8_t* b, size_t n) {
+  return (cb->write < cb->n) && (cb->read < cb->n) &&
+         (cb->n == n)        && (cb->b == b);
+}
+
 // app_hash__ and app_hash will only be different on a code change.
 // We don't want previous log details for code changes.
 static bool log_valid(void) {
-  return (tx_cb.write < tx_cb.n)     && (tx_cb.read < tx_cb.n) &&
-         (tx_cb.n == sizeof(tx_buf)) && (tx_cb.b == tx_buf) &&
+  return cb_valid(&tx_cb, tx_buf, sizeof(tx_buf)) &&
+         cb_valid(&urgent_cb, urgent_buf, sizeof(urgent_buf)) &&
          (memcmp(log_app_hash(NULL), app_hash, sizeof(app_hash)) == 0);
 }
 
-static void log_save(void) {
-  saved_log_n = cb_read_avail(&tx_cb);
-
+static size_t log_save_cb(cb_t* cb, uint8_t* save) {
   // If it is empty then "force" dumping the entire contents
-  if (saved_log_n == 0) {
-    cb_skip(&tx_cb, 1);
-    saved_log_n = cb_read_avail(&tx_cb);
+  if (cb_read_avail(cb) == 0) cb_skip(cb, 1);
+
+  size_t saved = 0;
+  for (int i = 0; i < 2; i++) {
+    size_t n = cb_peek_avail(cb);
+    memmove(save + saved, cb_peek(cb), n);
+    saved += n;
+    cb_skip(cb, n);
   }
-  if (saved_log_n > sizeof(saved_log)) saved_log_n = sizeof(saved_log);
-
-  uint8_t* save = saved_log;
-  size_t log_rem = saved_log_n;
-  size_t n = cb_peek_avail(&tx_cb);
-  if (n > log_rem) n = log_rem;
-  memmove(save, cb_peek(&tx_cb), n);
-  save += n;
-  cb_skip(&tx_cb, n);
-  log_rem -= n;
-  n = cb_peek_avail(&tx_cb);
-  if (n > log_rem) n = log_rem;
-  memmove(save, cb_peek(&tx_cb), n);
-  cb_skip(&tx_cb, n);
+  return saved;
+}
+
+static void log_save(void) {
+  // ERROR/FATAL messages follow the rest of the log
+  saved_log_n = log_save_cb(&tx_cb, saved_log);
+  saved_log_n += log_save_cb(&urgent_cb, saved_log + saved_log_n);
 
   // Save the app_hash associated with the log.
   memmove(saved_app_hash, app_hash, sizeof(app_hash));
@@ -321,6 +843,14 @@ void log_pre_init(void) {
   log_data.uart = NULL;
   memset(tx_buf, 0, sizeof(tx_buf));
   cb_init(&tx_cb, tx_buf, sizeof(tx_buf));
+  memset(urgent_buf, 0, sizeof(urgent_buf));
+  cb_init(&urgent_cb, urgent_buf, sizeof(urgent_buf));
+  cb_init(&port_cb, port_buf, sizeof(port_buf));
+
+  ucuart_txq_init(&tx_q);
+  ucuart_txq_add(&tx_q, &urgent_cb, 0);
+  ucuart_txq_add(&tx_q, &port_cb, LOG_TX_PORT_QUANTUM);
+  ucuart_txq_add(&tx_q, &tx_cb, LOG_TX_LOG_QUANTUM);
   log_tx_suspend();
   LOG_INFO("log-pre-init");
 }
@@ -329,7 +859,7 @@ void log_init(uart_t* uart) {
   if (uart == NULL) return;
 
   log_data.uart = uart;
-  ucuart_set_tx_cb(log_data.uart, &tx_cb);
+  ucuart_set_tx_queue(log_data.uart, &tx_q);
 #if !defined(CONFIG_UC_LOG_SERVER)
   // If there is no server then assume we can send at all times after init
   // completes.
@@ -349,7 +879,7 @@ void log_init(uart_t* uart) {
 
 #if defined(CONFIG_STDOUT_CONSOLE) || defined(CONFIG_PRINTK)
 
-static char line[100-3-1]; // To allow for log_logn_ overheads
+static char line[100-3-1-LOG_KEY_SPARE-LOG_CRC_SIZE]; // To allow for log_logn_ overheads
 static size_t  line_idx = 0;
 static int console_out(int c) {
   if (line_idx < sizeof(line)-1) {
@@ -0,0 +1,83 @@
+// © 2025 Unit Circle Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// COBS for the log frames - see include/log.h
+//
+// Encoding is a search for the next zero byte and a copy of the bytes before
+// it.  The search looks at a word at a time: v has a zero byte iff
+// (v - 0x01010101) & ~v & 0x80808080 is non zero, which is three ALU ops per
+// four bytes on a Cortex-M instead of a load, compare and branch per byte.
+// The copies are memmove()s.  Output is the same as scripts/cobs.py.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "log.h"
+
+size_t log_cobs_zero(const uint8_t* b, size_t n) {
+  size_t i = 0;
+  for (; (i < n) && (((uintptr_t) (b + i)) & 3); i++) {
+    if (b[i] == 0) return i;
+  }
+  for (; i + 4 <= n; i += 4) {
+    uint32_t v;
+    memcpy(&v, b + i, 4); // aligned - a single load
+    if ((v - 0x01010101U) & ~v & 0x80808080U) break;
+  }
+  for (; i < n; i++) {
+    if (b[i] == 0) return i;
+  }
+  return n;
+}
+
+size_t log_cobs_enc(uint8_t* out, const uint8_t* in, size_t n) {
+  const uint8_t* end = in + n;
+  uint8_t* o = out;
+  while (true) {
+    size_t k = end - in;
+    if (k > 254) k = 254;
+    size_t z = log_cobs_zero(in, k);
+    memmove(o + 1, in, z);
+    in += z;
+    if (z == 254) {
+      *o = 0xff;
+      o += 1 + z;
+      // No need to send the code for the "fake" zero at the end
+      if (in == end) break;
+    }
+    else {
+      *o = z + 1;
+      o += 1 + z;
+      if (in == end) break;
+      in++; // the zero
+    }
+  }
+  return o - out;
+}
+
+ssize_t log_cobs_dec(uint8_t* out, const uint8_t* in, size_t n) {
+  const uint8_t* end = in + n;
+  uint8_t* o = out;
+  while (in < end) {
+    size_t code = *in++;
+    if ((code == 0) || (code - 1 > (size_t) (end - in))) return -1;
+    memmove(o, in, code - 1);
+    o += code - 1;
+    in += code - 1;
+    if ((code < 0xff) && (in < end)) *o++ = 0;
+  }
+  return o - out;
+}
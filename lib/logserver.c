@@ -18,12 +18,12 @@
 #include <stdint.h>
 
 #include "log.h"
-#include "cobs.h"
 #include "cb.h"
 
 #if defined(CONFIG_LOG_CUSTOM_HEADER)
 #include <zephyr/kernel.h>
 #include <zephyr/init.h>
+#include <zephyr/sys/crc.h>
 #endif
 
 // Allow others to implement a watchdog timer if needed
@@ -38,12 +38,112 @@ __weak void log_watchdog_register(const void* thread) {
 #define CONFIG_UC_LOG_SERVER_PORTS (8)
 #endif
 
+#if CONFIG_UC_LOG_FRAG
+// Fragmentation and reliable port channels
+//
+// Messages larger than LOG_MAX_PACKET_SIZE, and any message on a port the
+// application treats as reliable, are sent as a series of LOG_TYPE_FRAG
+// (2) frames on the port:
+//
+//   byte 0     (port << 2) | 2
+//   byte 1     flags - FRAG_FIRST, FRAG_LAST, FRAG_ACK, FRAG_NACK
+//   byte 2     message id
+//   byte 3-4   fragment sequence number (little endian)
+//   byte 5-8   offset of the fragment in the message (little endian)
+//   byte 9..   fragment data
+//   last 2     CRC-16/CCITT-FALSE of the frame up to here (little endian)
+//
+// With CONFIG_UC_LOG_CRC there is no fragment CRC - the link frame check
+// already covers the whole frame and is checked and removed before
+// frag_rx() sees it.  The host must be run with the same --crc.
+//
+// The receiver accepts fragments in order only and answers each with an ACK
+// frame (flags FRAG_ACK, id, seq = next fragment wanted, byte 5 = credits -
+// the number of fragments it can take unacknowledged, then the CRC).  A
+// gap or a bad CRC is answered once with FRAG_NACK so the sender goes back
+// without waiting for its timeout.  The sender keeps up to the credits (and
+// its own window) of fragments in flight and goes back to the first
+// unacknowledged one if no ACK arrives in time.
+//
+// Credits are 0 while the application holds the receive buffer
+// (log_frag_hold()).  The sender then stops, probing with one fragment per
+// timeout, until log_frag_release() sends fresh credits.  scripts/uclog.py
+// implements the same protocol on the host.
+
+#if !defined(CONFIG_UC_LOG_FRAG_WINDOW)
+#define CONFIG_UC_LOG_FRAG_WINDOW (4)
+#endif
+
+#if !defined(CONFIG_UC_LOG_FRAG_RX_WINDOW)
+#define CONFIG_UC_LOG_FRAG_RX_WINDOW (2)
+#endif
+
+#if !defined(CONFIG_UC_LOG_FRAG_TIMEOUT_MS)
+#define CONFIG_UC_LOG_FRAG_TIMEOUT_MS (200)
+#endif
+
+#if !defined(CONFIG_UC_LOG_FRAG_RETRIES)
+#define CONFIG_UC_LOG_FRAG_RETRIES (10)
+#endif
+
+// Port TX ring space kept free for other ports while fragments are queued
+#if !defined(CONFIG_UC_LOG_FRAG_TX_RESERVE)
+#define CONFIG_UC_LOG_FRAG_TX_RESERVE (1024)
+#endif
+
+#define FRAG_FIRST (0x01)
+#define FRAG_LAST  (0x02)
+#define FRAG_ACK   (0x04)
+#define FRAG_NACK  (0x08)
+#define FRAG_HDR   (8)
+#define FRAG_ACK_HDR (5)
+#if LOG_CRC_SIZE
+#define FRAG_CRC   (0)
+#else
+#define FRAG_CRC   (2)
+#endif
+#define FRAG_SIZE  (LOG_MAX_PACKET_SIZE - 1 - FRAG_HDR - FRAG_CRC)
+
+// A fragment as queued in the port TX ring - COBS encoded with the link
+// frame check and both delimiters
+#define FRAG_TX_FRAME (LOG_COBS_ENC_SIZE(LOG_MAX_PACKET_SIZE + LOG_CRC_SIZE) + 2)
+
+// Otherwise frag_tx_room() never finds room and every fragment times out
+#if defined(CONFIG_UC_LOG_PORT_BUF_SIZE) && \
+    (FRAG_TX_FRAME + CONFIG_UC_LOG_FRAG_TX_RESERVE >= CONFIG_UC_LOG_PORT_BUF_SIZE)
+#error "UC_LOG_PORT_BUF_SIZE must exceed a fragment frame plus UC_LOG_FRAG_TX_RESERVE"
+#endif
+
+typedef struct {
+  // Receive - message is assembled in place in b
+  uint8_t*  b;
+  size_t    size;
+  size_t    n;
+  uint16_t  seq;      // next fragment wanted
+  uint8_t   id;
+  bool      started;
+  bool      nacked;   // NACK sent for the current gap
+  bool      held;     // application still has b - no credits
+  bool      waiting;  // a message was refused while held
+  uint8_t   wait_id;
+  log_cb_t* handler;
+  void*     context;
+  // Transmit
+  uint8_t   tx_id;
+  uint8_t   tx_window;
+  bool      tx_nack;
+  uint16_t  tx_acked; // fragments acknowledged
+} log_frag_t;
+#endif
+
 
 typedef struct {
   const struct device* uart;
-  uint8_t buf[COBS_ENC_SIZE(LOG_MAX_PACKET_SIZE)+3];
+  uint8_t buf[LOG_COBS_ENC_SIZE(LOG_MAX_PACKET_SIZE+LOG_CRC_SIZE)+3];
   cb_t    cb;
   bool    overrun;
+  bool    rx_bad;     // last frame was bad
+  log_rx_stats_t stats;
   uint8_t* hash[LOG_APP_HASH_SIZE + 2];
 #if CONFIG_UC_LOG_SERVER_PORTS> 0
   log_cb_t* handlers[CONFIG_UC_LOG_SERVER_PORTS];
@@ -54,8 +154,14 @@ typedef struct {
   uint8_t* rx_data;
   size_t   rx_n;
 #endif
+#if CONFIG_UC_LOG_FRAG
+  log_frag_t frag[CONFIG_UC_LOG_SERVER_PORTS];
+#endif
 #if defined(CONFIG_LOG_CUSTOM_HEADER)
   struct k_event rx_event;
+#if CONFIG_UC_LOG_FRAG
+  struct k_event frag_event; // bit per port - ACK received
+#endif
   K_KERNEL_STACK_MEMBER(thread_stack, CONFIG_UC_LOG_STACK_SIZE);
   struct k_thread thread;
 #endif
@@ -95,6 +201,231 @@ void log_notify(uint8_t port, log_cb_t* task, void* ctx) {
   server.contexts[port] = ctx;
 }
 
+#if CONFIG_UC_LOG_FRAG
+void log_frag_notify(uint8_t port, uint8_t* b, size_t size, log_cb_t* task, void* ctx) {
+  if (port >= CONFIG_UC_LOG_SERVER_PORTS) {
+    LOG_FATAL("port out of range: %d", port);
+  }
+  log_frag_t* f = &server.frag[port];
+  f->b = b;
+  f->size = size;
+  f->started = false;
+  f->held = false;
+  f->handler = task;
+  f->context = ctx;
+}
+
+static void frag_tx(uint8_t port, const uint8_t* h, size_t hn, const uint8_t* data, size_t n) {
+#if FRAG_CRC
+  uint8_t b[1] = { (port << 2) | 2 };
+  uint16_t crc = crc16_itu_t(0xffff, b, 1);
+  crc = crc16_itu_t(crc, h, hn);
+  crc = crc16_itu_t(crc, data, n);
+  uint8_t t[FRAG_CRC] = { crc, crc >> 8 };
+  log_tx_frame_(2, port, h, hn, data, n, t, sizeof(t));
+#else
+  log_tx_frame_(2, port, h, hn, data, n, NULL, 0);
+#endif
+}
+
+static void frag_ack(uint8_t port, uint8_t flags, uint8_t id, uint16_t seq, uint8_t credits) {
+  uint8_t h[FRAG_ACK_HDR] = { FRAG_ACK | flags, id, seq, seq >> 8, credits };
+  frag_tx(port, h, sizeof(h), NULL, 0);
+}
+
+static uint8_t frag_credits(const log_frag_t* f) {
+  return f->held ? 0 : CONFIG_UC_LOG_FRAG_RX_WINDOW;
+}
+
+// Keep the fragment buffer after the handler returns.  The host is given
+// no credits (so stops sending on the port) until log_frag_release().
+void log_frag_hold(uint8_t port) {
+  if (port >= CONFIG_UC_LOG_SERVER_PORTS) {
+    LOG_FATAL("port out of range: %d", port);
+  }
+  server.frag[port].held = true;
+}
+
+void log_frag_release(uint8_t port) {
+  if (port >= CONFIG_UC_LOG_SERVER_PORTS) {
+    LOG_FATAL("port out of range: %d", port);
+  }
+  log_frag_t* f = &server.frag[port];
+  unsigned int key = irq_lock();
+  bool waiting = f->waiting;
+  f->held = false;
+  f->waiting = false;
+  irq_unlock(key);
+  if (waiting) {
+    // Credits for the message that was refused
+    frag_ack(port, 0, f->wait_id, 0, frag_credits(f));
+  }
+}
+
+// Wait (up to the ACK timeout) for room for a fragment in the port TX ring
+// while leaving CONFIG_UC_LOG_FRAG_TX_RESERVE for other port messages
+static bool frag_tx_room(void) {
+  for (int i = 0; i < CONFIG_UC_LOG_FRAG_TIMEOUT_MS; i++) {
+    if (log_tx_avail() >= FRAG_TX_FRAME + CONFIG_UC_LOG_FRAG_TX_RESERVE) {
+      return true;
+    }
+    k_sleep(K_MSEC(1));
+  }
+  return false;
+}
+
+// Send n bytes as fragments and wait until they have all been acknowledged.
+// Must not be called from the log thread (or a port handler) as that is
+// where ACKs are received.
+bool log_tx_frag(uint8_t port, const uint8_t* data, size_t n) {
+  if (port >= CONFIG_UC_LOG_SERVER_PORTS) {
+    LOG_FATAL("port out of range: %d", port);
+  }
+  log_frag_t* f = &server.frag[port];
+  size_t frags = n == 0 ? 1 : (n + FRAG_SIZE - 1) / FRAG_SIZE;
+  if (frags > 0xffff) return false;
+
+  unsigned int key = irq_lock();
+  uint8_t id = ++f->tx_id;
+  f->tx_acked = 0;
+  f->tx_window = 1;  // until the receiver says otherwise
+  f->tx_nack = false;
+  irq_unlock(key);
+
+  size_t next = 0;
+  unsigned retries = 0;
+  bool probe = false;
+  while (f->tx_acked < frags) {
+    size_t window = f->tx_window;
+    if (window > CONFIG_UC_LOG_FRAG_WINDOW) window = CONFIG_UC_LOG_FRAG_WINDOW;
+    if (probe && (window == 0)) window = 1;
+    probe = false;
+    while ((next < frags) && (next < f->tx_acked + window) && frag_tx_room()) {
+      size_t off = next * FRAG_SIZE;
+      size_t m = n - off < FRAG_SIZE ? n - off : FRAG_SIZE;
+      uint8_t h[FRAG_HDR] = {
+        (next == 0 ? FRAG_FIRST : 0) | (next == frags - 1 ? FRAG_LAST : 0),
+        id, next, next >> 8, off, off >> 8, off >> 16, off >> 24,
+      };
+      frag_tx(port, h, sizeof(h), data + off, m);
+      next++;
+    }
+#if defined(CONFIG_LOG_CUSTOM_HEADER)
+    uint32_t r = k_event_wait(&server.frag_event, BIT(port), false,
+                              K_MSEC(CONFIG_UC_LOG_FRAG_TIMEOUT_MS));
+    k_event_clear(&server.frag_event, BIT(port));
+#else
+    // Non-zephyr "wait for event"
+#endif
+    if (r != 0) {
+      retries = 0;
+      if (f->tx_nack) {
+        f->tx_nack = false;
+        next = f->tx_acked;
+      }
+    }
+    else if (++retries > CONFIG_UC_LOG_FRAG_RETRIES) {
+      LOG_WARN("port %d fragment %d not acknowledged", port, f->tx_acked);
+      return false;
+    }
+    else {
+      // Go back to the first unacknowledged fragment (probe if no credits)
+      next = f->tx_acked;
+      probe = true;
+    }
+  }
+  return true;
+}
+
+static void frag_rx(log_server_data_t* data, const uint8_t* b, size_t n) {
+  uint8_t port = data->port;
+  if ((port >= CONFIG_UC_LOG_SERVER_PORTS) || (n < 1 + FRAG_ACK_HDR + FRAG_CRC)) {
+    LOG_ERROR("invalid fragment port: %d n: %d", port, (int) n);
+    return;
+  }
+  log_frag_t* f = &data->frag[port];
+#if FRAG_CRC
+  n -= FRAG_CRC;
+  if (crc16_itu_t(0xffff, b, n) != (b[n] | (b[n + 1] << 8))) {
+    LOG_WARN("port %d fragment CRC error", port);
+    if (f->started && !f->nacked) {
+      f->nacked = true;
+      frag_ack(port, FRAG_NACK, f->id, f->seq, frag_credits(f));
+    }
+    return;
+  }
+#endif
+  b++;
+  n--;
+  uint8_t flags = b[0];
+  uint8_t id = b[1];
+  uint16_t seq = b[2] | (b[3] << 8);
+
+  if ((flags & FRAG_ACK) != 0) {
+    if ((id == f->tx_id) && (seq >= f->tx_acked)) {
+      f->tx_acked = seq;
+      f->tx_window = b[4];
+      f->tx_nack = (flags & FRAG_NACK) != 0;
+#if defined(CONFIG_LOG_CUSTOM_HEADER)
+      k_event_post(&data->frag_event, BIT(port));
+#endif
+    }
+    return;
+  }
+
+  if ((n < FRAG_HDR) || (f->b == NULL)) {
+    LOG_ERROR("no fragment buffer for port: %d", port);
+    return;
+  }
+  uint32_t off = b[4] | (b[5] << 8) | (b[6] << 16) | ((uint32_t) b[7] << 24);
+  b += FRAG_HDR;
+  n -= FRAG_HDR;
+
+  // A first fragment starts a new message unless it is a repeat of the
+  // current one (our ACK was lost)
+  if (((flags & FRAG_FIRST) != 0) && (seq == 0) && (!f->started || (id != f->id))) {
+    if (f->held) {
+      // Buffer still in use - no credits until log_frag_release()
+      f->waiting = true;
+      f->wait_id = id;
+      frag_ack(port, 0, id, 0, 0);
+      return;
+    }
+    f->started = true;
+    f->nacked = false;
+    f->id = id;
+    f->seq = 0;
+    f->n = 0;
+  }
+  if (!f->started || (id != f->id)) return;
+
+  if ((seq == f->seq) && (off == f->n)) {
+    if (n > f->size - f->n) {
+      LOG_ERROR("port %d fragmented message too large", port);
+      f->started = false;
+      return;
+    }
+    memmove(f->b + f->n, b, n);
+    f->n += n;
+    f->seq++;
+    f->nacked = false;
+    frag_ack(port, 0, f->id, f->seq, frag_credits(f));
+    if (((flags & FRAG_LAST) != 0) && (f->handler != NULL)) {
+      f->handler(f->b, f->n, f->context);
+    }
+  }
+  else if ((seq > f->seq) && !f->nacked) {
+    // Gap - something was lost, go back now
+    f->nacked = true;
+    frag_ack(port, FRAG_NACK, f->id, f->seq, frag_credits(f));
+  }
+  else if (seq < f->seq) {
+    // Repeat - our ACK was lost
+    frag_ack(port, 0, f->id, f->seq, frag_credits(f));
+  }
+}
+#endif
+
 static void log_thread(log_server_data_t* data) {
   LOG_INFO("log thread starting");
 
@@ -187,14 +518,33 @@ pause:
         cb_write(&data->cb, b, n);
         //LOG_MEM_INFO("Rx: ", data->buf,  cb_peek_avail(&data->cb));
         ucuart_rx_skip(data->uart, e-b); // Leave the 0x00 frame terminator
-        ssize_t n = cobs_dec(data->buf, data->buf, cb_peek_avail(&data->cb));
+        ssize_t n = log_cobs_dec(data->buf, data->buf, cb_peek_avail(&data->cb));
+        data->stats.frames++;
         if ((n < 0) || data->overrun) {
+          data->stats.cobs_errors++;
+          data->rx_bad = true;
           LOG_ERROR("COBS decode error: %d overrun: %d", (int) n, data->overrun);
         }
-        else if (n > 0) {
+        else if ((n > 0) && !log_crc_check(data->buf, n)) {
+          data->stats.crc_errors++;
+          data->rx_bad = true;
+          LOG_WARN("rx frame check error (%d bytes)", (int) n);
+        }
+        else if (n > LOG_CRC_SIZE) {
+          n -= LOG_CRC_SIZE;
+          if (data->rx_bad) {
+            data->stats.resyncs++;
+            data->rx_bad = false;
+          }
           uint8_t type = data->buf[0] & 3;
           data->port = data->buf[0] >> 2;
           cb_skip(&data->cb, 1);
+#if CONFIG_UC_LOG_FRAG
+          if (type == 0x2) {
+            frag_rx(data, data->buf, n);
+          }
+          else
+#endif
           if (type != 0x3) {
             LOG_ERROR("unexpected frame type: %d", type);
           }
@@ -244,6 +594,12 @@ pause:
   }
 }
 
+void log_rx_stats(log_rx_stats_t* stats) {
+  uint32_t key = irq_lock();
+  *stats = server.stats;
+  irq_unlock(key);
+}
+
 void log_server_init(uart_t* uart) {
   server.uart = uart;
   server.rx_port = 255;
@@ -263,6 +619,13 @@ static int z_log_server_init(void) {
 
 #if CONFIG_UC_LOG_SERVER_PORTS > 0
   k_event_init(&server.rx_event);
+#if CONFIG_UC_LOG_FRAG
+  k_event_init(&server.frag_event);
+  // Don't reuse message ids from before a reset
+  for (size_t i = 0; i < CONFIG_UC_LOG_SERVER_PORTS; i++) {
+    server.frag[i].tx_id = (uint8_t) (k_cycle_get_32() + i);
+  }
+#endif
 
   k_tid_t tid = k_thread_create(&server.thread, server.thread_stack,
                         CONFIG_UC_LOG_STACK_SIZE,
@@ -41,10 +41,16 @@ function(zephyr_sbl_tasks)
   # after the commands which generate the unsigned versions.
   set_property(GLOBAL APPEND PROPERTY extra_post_build_commands COMMAND
     echo "Signing ${output}.elf CERT $ENV{SBL_NEB_CERT}")
+  # The .hex and .bin are signed by one command, so the key is
+  # reconstructed once and the image hashed once.  With SBL_SOCKET set
+  # (e.g. a nightly build running "sbl.py serve ... $SBL_SOCKET") the
+  # signing service signs, and the key isn't reconstructed per build.
+  set(sbl_socket)
+  if(DEFINED ENV{SBL_SOCKET})
+    set(sbl_socket --socket $ENV{SBL_SOCKET})
+  endif()
   set_property(GLOBAL APPEND PROPERTY extra_post_build_commands COMMAND
-    ${UCLOG_ROOT_DIR}/scripts/sbl.py sign --key $ENV{SBL_NEB} --code ${output}.hex --cert ${UCLOG_ROOT_DIR}/$ENV{SBL_NEB_CERT} ${output}.signed.hex)
-  set_property(GLOBAL APPEND PROPERTY extra_post_build_commands COMMAND
-    ${UCLOG_ROOT_DIR}/scripts/sbl.py sign --key $ENV{SBL_NEB} --code ${output}.bin --cert ${UCLOG_ROOT_DIR}/$ENV{SBL_NEB_CERT} ${output}.signed.bin)
+    ${UCLOG_ROOT_DIR}/scripts/sbl.py sign ${sbl_socket} --key $ENV{SBL_NEB} --code ${output}.hex --code ${output}.bin --cert ${UCLOG_ROOT_DIR}/$ENV{SBL_NEB_CERT} ${output}.signed.hex ${output}.signed.bin)
   set_property(GLOBAL APPEND PROPERTY extra_post_build_byproducts ${byproducts})
 endfunction()
 
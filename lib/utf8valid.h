@@ -13,10 +13,14 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <string.h>
 
 #define UTF8_ACCEPT 0
 #define UTF8_ERROR 88
 
+// High bit of every byte of a word
+#define UTF8_HIGH_BITS (((size_t) -1 / 0xff) * 0x80)
+
 static const uint8_t utf8cc[] = {
  7, 7, 7, 7, 7, 7, 7, 7,  7, 7, 7, 7, 7, 7, 7, 7,
  8, 8, 8, 8, 8, 8, 8, 8,  8, 8, 8, 8, 8, 8, 8, 8,
@@ -38,8 +42,20 @@ static const uint8_t utf8stt[] = {
 static bool is_valid_utf8(const char *str, size_t len) {
   size_t state = UTF8_ACCEPT;
 
-  while (len-- > 0) {
+  while (len > 0) {
+    // ASCII fast path - between characters check a word at a time
+    if (state == UTF8_ACCEPT) {
+      while (len >= sizeof(size_t)) {
+        size_t w;
+        memcpy(&w, str, sizeof(w));
+        if ((w & UTF8_HIGH_BITS) != 0) break;
+        str += sizeof(w);
+        len -= sizeof(w);
+      }
+      if (len == 0) break;
+    }
     uint8_t c = (uint8_t) *str++;
+    len--;
     if (c < 0x80) {
       if (state != UTF8_ACCEPT) return false;
     }
@@ -0,0 +1,155 @@
+// © 2025 Unit Circle Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+// COBS encode/decode for cobs.py - same output as the pure Python version,
+// which is used when this isn't built:
+//
+//   cd scripts && python3 setup.py build_ext --inplace
+//
+// The encoder's zero byte search is the hot loop.  It uses SSE2 (AVX2 if
+// the compiler targets it) on x86, NEON on Arm, or memchr() otherwise.
+// The decoder copies whole runs, and dec() raises ValueError on a code of
+// zero or a run past the end of the data.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Index of the first zero in p[0..n), n if there is none
+static size_t zero_index(const uint8_t* p, size_t n) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256i z = _mm256_setzero_si256();
+  for (; i + 32 <= n; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*) (p + i));
+    uint32_t m = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, z));
+    if (m != 0) return i + __builtin_ctz(m);
+  }
+#elif defined(__SSE2__)
+  const __m128i z = _mm_setzero_si128();
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*) (p + i));
+    uint32_t m = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, z));
+    if (m != 0) return i + __builtin_ctz(m);
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 16 <= n; i += 16) {
+    uint8x16_t eq = vceqzq_u8(vld1q_u8(p + i));
+    // 4 bits per byte of eq
+    uint64_t m = vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+    if (m != 0) return i + __builtin_ctzll(m) / 4;
+  }
+#endif
+  const uint8_t* z0 = memchr(p + i, 0, n - i);
+  return z0 == NULL ? n : (size_t) (z0 - p);
+}
+
+static PyObject* enc(PyObject* self, PyObject* arg) {
+  (void) self;
+  Py_buffer in;
+  if (PyObject_GetBuffer(arg, &in, PyBUF_SIMPLE) < 0) return NULL;
+
+  size_t n = in.len;
+  PyObject* r = PyBytes_FromStringAndSize(NULL, n + n / 254 + 1);
+  if (r == NULL) {
+    PyBuffer_Release(&in);
+    return NULL;
+  }
+  const uint8_t* p = in.buf;
+  const uint8_t* end = p + n;
+  uint8_t* o = (uint8_t*) PyBytes_AS_STRING(r);
+  uint8_t* o0 = o;
+
+  Py_BEGIN_ALLOW_THREADS
+  while (true) {
+    size_t k = end - p;
+    if (k > 254) k = 254;
+    size_t z = zero_index(p, k);
+    memcpy(o + 1, p, z);
+    p += z;
+    if (z == 254) {
+      *o = 255;
+      o += 1 + z;
+      // No need to send the code for the "fake" zero at the end
+      if (p == end) break;
+    }
+    else {
+      *o = z + 1;
+      o += 1 + z;
+      if (p == end) break;
+      p++;  // the zero
+    }
+  }
+  Py_END_ALLOW_THREADS
+
+  PyBuffer_Release(&in);
+  if (_PyBytes_Resize(&r, o - o0) < 0) return NULL;
+  return r;
+}
+
+static PyObject* dec(PyObject* self, PyObject* arg) {
+  (void) self;
+  Py_buffer in;
+  if (PyObject_GetBuffer(arg, &in, PyBUF_SIMPLE) < 0) return NULL;
+
+  size_t n = in.len;
+  PyObject* r = PyBytes_FromStringAndSize(NULL, n);
+  if (r == NULL) {
+    PyBuffer_Release(&in);
+    return NULL;
+  }
+  const uint8_t* p = in.buf;
+  const uint8_t* end = p + n;
+  uint8_t* o = (uint8_t*) PyBytes_AS_STRING(r);
+  uint8_t* o0 = o;
+  bool ok = true;
+
+  Py_BEGIN_ALLOW_THREADS
+  while (p < end) {
+    size_t code = *p++;
+    if ((code == 0) || (code - 1 > (size_t) (end - p))) {
+      ok = false;
+      break;
+    }
+    memcpy(o, p, code - 1);
+    o += code - 1;
+    p += code - 1;
+    if ((code < 255) && (p < end)) *o++ = 0;
+  }
+  Py_END_ALLOW_THREADS
+
+  PyBuffer_Release(&in);
+  if (!ok) {
+    Py_DECREF(r);
+    PyErr_SetString(PyExc_ValueError, "invalid COBS data");
+    return NULL;
+  }
+  if (_PyBytes_Resize(&r, o - o0) < 0) return NULL;
+  return r;
+}
+
+static PyMethodDef methods[] = {
+  {"enc", enc, METH_O, "COBS encode bytes (no frame delimiters)"},
+  {"dec", dec, METH_O, "COBS decode bytes (no frame delimiters)"},
+  {NULL, NULL, 0, NULL},
+};
+
+static struct PyModuleDef module = {
+  PyModuleDef_HEAD_INIT, "_cobs", NULL, -1, methods, NULL, NULL, NULL, NULL,
+};
+
+PyMODINIT_FUNC PyInit__cobs(void) {
+  return PyModule_Create(&module);
+}
@@ -3,21 +3,16 @@
 import os
 import shutil
 import argparse
-import hashlib
 
-SIGNATURE_HDR_LEN = 512
+from hash import SIGNATURE_HDR_LEN, image_hash
 
-def hash(input):
-    with open(input, 'rb') as f:
-        data = f.read()
-
-    if args.full:
-        image_data = data
-    else:
-        image_data = data[SIGNATURE_HDR_LEN:]
-    hash_sha512 = hashlib.sha512()
-    hash_sha512.update(image_data)
-    return hash_sha512.digest()
+def cache_copy(src, cache_dir, fname):
+    # Copy to the side and rename so the log server, which looks the image
+    # up as "<app hash hex>.logdata", never loads a partial file
+    dst = os.path.join(cache_dir, fname)
+    tmp = dst + ".%d" % os.getpid()
+    shutil.copy(src, tmp)
+    os.replace(tmp, dst)
 
 if __name__ == '__main__':
     parser = argparse.ArgumentParser('Cache log data')
@@ -35,10 +30,12 @@ if __name__ == '__main__':
         print("Logdata file not found")
         exit(1)
 
-    app_hash = hash(args.bin)
+    # Usually from the manifest written when hash.py hashed it
+    app_hash = image_hash(args.bin, 0 if args.full else SIGNATURE_HDR_LEN)
 
     user_dir = os.path.expanduser("~")
     cache_dir = os.path.join(user_dir, ".cache", "uclog")
     if not os.path.exists(cache_dir):
         os.makedirs(cache_dir)
-    shutil.copy(args.logdata, os.path.join(cache_dir, app_hash.hex() + ".logdata"))
+    fname = app_hash.hex() + ".logdata"
+    cache_copy(args.logdata, cache_dir, fname)
@@ -15,35 +15,43 @@
 # Implementation of COBS - http://www.stuartcheshire.org/papers/COBSforToN.pdf
 
 
-def enc(data):
-    out = b""
-    data = data + b"\0"  # Add "fake" zero
-    while len(data) > 0:
-        i = data.index(b"\0")
-        if i >= 254:
-            out, data = out + bytes((255,)) + data[:254], data[254:]
+_CODE = [bytes((i,)) for i in range(256)]
 
-            # Early exit if we only have the added "fake" zero
-            # No need to send extra \x01 byte - receiver can infer
-            if data == b"\x00":
-                break
-        else:
-            out, data = out + bytes((i + 1,)) + data[:i], data[i + 1 :]
-    return out
 
+def _enc(data):
+    out = []
+    segs = bytes(data).split(b"\0")
+    for seg in segs:
+        m = len(seg) - len(seg) % 254
+        for i in range(0, m, 254):
+            out += (b"\xff", seg[i : i + 254])
+        out += (_CODE[len(seg) - m + 1], seg[m:])
+    # No need to send the code for the "fake" zero at the end
+    if len(segs[-1]) > 0 and len(segs[-1]) % 254 == 0:
+        del out[-2:]
+    return b"".join(out)
 
-def dec(data):
-    out = b""
-    while len(data) > 0:
-        code = data[0]
-        seg, data = data[1:code], data[code:]
-        if code == 255 and len(data) == 0:
-            # Add back "fake" zero removed by sender
-            seg += b"\0"
-        elif code < 255:
-            seg += b"\0"
-        out += seg
-    return out[:-1]  # Remove "fake" zero
+
+def _dec(data):
+    out = []
+    n = len(data)
+    i = 0
+    while i < n:
+        code = data[i]
+        if code == 0 or i + code > n:
+            raise ValueError("invalid COBS data")
+        out.append(data[i + 1 : i + code])
+        i += code
+        if code < 255 and i < n:
+            out.append(b"\0")
+    return b"".join(out)
+
+
+# scripts/_cobs.c does the same (setup.py build_ext --inplace), much faster
+try:
+    from _cobs import dec, enc
+except ImportError:
+    enc, dec = _enc, _dec
 
 
 # Possibly faster version if compiling python to C as pre-allocates output
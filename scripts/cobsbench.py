@@ -0,0 +1,150 @@
+#! /usr/bin/env python3
+
+# © 2025 Unit Circle Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# COBS speed and equivalence.
+#
+# Times cobs.enc/dec (the _cobs extension if built - see setup.py), the pure
+# Python fallback and the original byte string slicing version for a range
+# of frame sizes and zero byte densities.  --fuzz checks random round trips
+# of all of them give the same output as the original, and that the
+# decoders reject the same garbage.
+
+import argparse
+import random
+import time
+
+import cobs
+
+try:
+    import _cobs
+except ImportError:
+    _cobs = None
+
+
+# The original scripts/cobs.py - quadratic in the frame size
+def ref_enc(data):
+    out = b""
+    data = data + b"\0"  # Add "fake" zero
+    while len(data) > 0:
+        i = data.index(b"\0")
+        if i >= 254:
+            out, data = out + bytes((255,)) + data[:254], data[254:]
+            if data == b"\x00":
+                break
+        else:
+            out, data = out + bytes((i + 1,)) + data[:i], data[i + 1 :]
+    return out
+
+
+def ref_dec(data):
+    out = b""
+    while len(data) > 0:
+        code = data[0]
+        seg, data = data[1:code], data[code:]
+        if code == 255 and len(data) == 0:
+            seg += b"\0"
+        elif code < 255:
+            seg += b"\0"
+        out += seg
+    return out[:-1]
+
+
+def frame(rnd, n, zeros):
+    return bytes(0 if rnd.random() < zeros else rnd.randrange(1, 256) for _ in range(n))
+
+
+def impls(ref):
+    r = [("python", cobs._enc, cobs._dec)]
+    if _cobs:
+        r.insert(0, ("_cobs", _cobs.enc, _cobs.dec))
+    if ref:
+        r.append(("original", ref_enc, ref_dec))
+    return r
+
+
+def bench(sizes, densities, total, ref):
+    rnd = random.Random(1)
+    print(f"{'':9} {'size':>6} {'zeros':>6} {'enc MB/s':>9} {'dec MB/s':>9}")
+    for n in sizes:
+        for zeros in densities:
+            data = frame(rnd, n, zeros)
+            enc = cobs._enc(data)
+            reps = max(1, total // n)
+            for name, e, d in impls(ref and n <= 65536):
+                start = time.perf_counter()
+                for _ in range(reps):
+                    e(data)
+                te = time.perf_counter() - start
+                start = time.perf_counter()
+                for _ in range(reps):
+                    d(enc)
+                td = time.perf_counter() - start
+                print(
+                    f"{name:9} {n:6} {zeros:6.0%} {n * reps / te / 1e6:9.1f} "
+                    f"{n * reps / td / 1e6:9.1f}"
+                )
+
+
+def decodes(dec, data):
+    try:
+        return dec(data)
+    except ValueError:
+        return None
+
+
+def fuzz(n):
+    rnd = random.Random(2)
+    bad = 0
+    for i in range(n):
+        size = rnd.choice((rnd.randrange(16), rnd.randrange(600), rnd.randrange(3000)))
+        data = frame(rnd, size, rnd.choice((0, 0.001, 0.01, 0.1, 0.5, 1)))
+        enc = ref_enc(data)
+        for name, e, d in impls(False):
+            if e(data) != enc or d(enc) != data:
+                print(f"  {name}: round trip of {data.hex()} differs")
+                bad += 1
+        # Garbage (no zeros, as after framing) - the original decoder takes
+        # anything, the others must agree with each other and with it when
+        # they accept
+        garbage = frame(rnd, rnd.randrange(1, 40), 0)
+        got = [decodes(d, garbage) for _, _, d in impls(False)]
+        if any(g != got[0] for g in got) or got[0] not in (None, ref_dec(garbage)):
+            print(f"  decode of {garbage.hex()} differs")
+            bad += 1
+    print(f"fuzz: {n} frames, {bad} mismatches")
+    return bad == 0
+
+
+def main():
+    parser = argparse.ArgumentParser("COBS benchmark")
+    parser.add_argument("--sizes", default="16,100,1500,65536")
+    parser.add_argument("--zeros", default="0,0.01,0.1", help="zero byte densities")
+    parser.add_argument("--bytes", type=int, default=1 << 20, help="per measurement")
+    parser.add_argument("--no-original", action="store_true", help="skip the original")
+    parser.add_argument("--fuzz", type=int, default=0, help="random frames to check")
+    args = parser.parse_args()
+
+    if _cobs is None:
+        print("_cobs not built - python3 setup.py build_ext --inplace")
+    if args.fuzz:
+        exit(0 if fuzz(args.fuzz) else 1)
+    sizes = [int(x) for x in args.sizes.split(",")]
+    densities = [float(x) for x in args.zeros.split(",")]
+    bench(sizes, densities, args.bytes, not args.no_original)
+
+
+if __name__ == "__main__":
+    main()
@@ -30,12 +30,43 @@ import secrets
 #   return r
 
 
+# Multiplication is carry-less multiplication a nibble at a time with a 16
+# entry table of multiples of one operand, then reduction by folding the
+# bits above x^m back down with the (sparse) low terms of the polynomial.
+# Squaring spreads the bits apart with masks and inverse is a^(2^m - 2)
+# using Itoh-Tsujii, so none of them branch or loop on the values, just on
+# the field.  That is as close to constant time as Python ints get - their
+# operations still take time that varies a little with their size.
+
+
 class GF2:
     def __init__(self, poly):
         self.poly = sorted(poly)[::-1]
         self.p = sum(2**x for x in poly)
         self.n = 2 ** max(poly)
 
+        m = self.poly[0]
+        self.m = m
+        self.mask = self.n - 1
+        # x^m = sum of x^e for these e
+        self.low = self.poly[1:]
+        # Folds that take a product (degree <= 2m - 2) below degree m
+        self.folds = 0
+        deg = 2 * m - 2
+        while deg >= m:
+            deg = max(m - 1, deg - m + max(self.low, default=0))
+            self.folds += 1
+        # The nibbles of a multiplier, top first
+        self.shifts = list(range((m - 1) // 4 * 4, -1, -4))
+        # Masks to spread bits apart for squaring, for a power of 2 width
+        w = 1 << (m - 1).bit_length()
+        self.spread = []
+        while w > 1:
+            w //= 2
+            block = (1 << w) - 1
+            mask = sum(block << (2 * w * i) for i in range(m // w + 1))
+            self.spread.append((w, mask))
+
     def __call__(self, v):
         return GF2FE(v, self)
 
@@ -50,6 +81,45 @@ class GF2:
     def random(self):
         return self(secrets.randbelow(self.n))
 
+    def reduce(self, c):
+        m, mask = self.m, self.mask
+        for _ in range(self.folds):
+            h = c >> m
+            c &= mask
+            for e in self.low:
+                c ^= h << e
+        return c
+
+    def mul(self, a, b):
+        # Multiples of b by every nibble
+        b2, b4, b8 = b << 1, b << 2, b << 3
+        t = [0, b, b2, b2 ^ b, b4, b4 ^ b, b4 ^ b2, b4 ^ b2 ^ b]
+        t += [b8 ^ x for x in t]
+        c = 0
+        for s in self.shifts:
+            c = (c << 4) ^ t[(a >> s) & 15]
+        return self.reduce(c)
+
+    def square(self, a):
+        # In GF(2^m) a^2 is a with zeros between its bits
+        for w, mask in self.spread:
+            a = (a | (a << w)) & mask
+        return self.reduce(a)
+
+    def inv(self, a):
+        # a^(2^m - 2) = (a^(2^(m - 1) - 1))^2, building b = a^(2^k - 1) up
+        # to k = m - 1 a bit of m - 1 at a time (Itoh-Tsujii).  0 gives 0.
+        e = self.m - 1
+        b, k = a, 1
+        for bit in bin(e)[3:]:
+            c = b
+            for _ in range(k):
+                c = self.square(c)
+            b, k = self.mul(c, b), 2 * k
+            if bit == "1":
+                b, k = self.mul(self.square(b), a), k + 1
+        return self.square(b)
+
 
 def degree(a):
     n = -1
@@ -59,15 +129,6 @@ def degree(a):
     return n if n > 0 else 0
 
 
-def egcd(a, b):
-    if a.v == 0:
-        return (b, a.gf(0), a.gf(1))
-    else:
-        d, m = divmod(b, a)
-        g, y, x = egcd(m, a)
-        return (g, x - d * y, y)
-
-
 class GF2FE:
     def __init__(self, v, gf):
         self.gf = gf
@@ -100,27 +161,11 @@ class GF2FE:
         return self.gf(self.v ^ o.v)
 
     def __mul__(self, o):
-        # This is (very) slow when GF2() degree is large as alg is quadratic!
-        # Can be made faster by building a table or using FFT based approach
-        # E.g. see https://members.loria.fr/PZimmermann/talks/ant2007.pdf p.32
-        # For simple use cases with limited number of multiplies per invokation
-        # this appoach is good enough and is easy to test.
         if self.__class__ != o.__class__:
             raise TypeError("Can't mult non FE values")
         if self.gf != o.gf:
             raise TypeError("Can't mult elements of different GF2 polys")
-        c = 0
-        a = self.v
-        b = o.v
-        n = self.gf.n
-        p = self.gf.p
-        for j in [1 << x for x in range(self.gf.poly[0])]:
-            if a & j != 0:
-                c = c ^ b
-            b = b * 2
-            if b & n != 0:
-                b = b ^ p
-        return self.gf(c)
+        return self.gf(self.gf.mul(self.v, o.v))
 
     def __truediv__(self, o):
         if self.__class__ != o.__class__:
@@ -153,4 +198,4 @@ class GF2FE:
         return self.gf(r), self.gf(a)
 
     def inverse(self):
-        return egcd(self.gf(self.gf.p), self)[2]
+        return self.gf(self.gf.inv(self.v))
@@ -0,0 +1,121 @@
+#! /usr/bin/env python3
+
+# © 2025 Unit Circle Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# GF(2^256) speed, gf2.py against the original bit at a time version, for
+# field operations and for sss.py split/join of a key (as sbl.py does) with
+# quorums k = 3..10 of n = k + 2 splits.  Every join must give the secret
+# back, and both versions must agree on random products and inverses.
+
+import argparse
+import random
+import time
+
+import gf2
+import sss
+
+POLY = [256, 10, 5, 2, 0]
+
+
+# The original gf2.py multiply and egcd based inverse
+class RefGF2(gf2.GF2):
+    def __call__(self, v):
+        return RefGF2FE(v, self)
+
+
+def ref_egcd(a, b):
+    if a.v == 0:
+        return (b, a.gf(0), a.gf(1))
+    else:
+        d, m = divmod(b, a)
+        g, y, x = ref_egcd(m, a)
+        return (g, x - d * y, y)
+
+
+class RefGF2FE(gf2.GF2FE):
+    def __mul__(self, o):
+        c = 0
+        a = self.v
+        b = o.v
+        n = self.gf.n
+        p = self.gf.p
+        for j in [1 << x for x in range(self.gf.poly[0])]:
+            if a & j != 0:
+                c = c ^ b
+            b = b * 2
+            if b & n != 0:
+                b = b ^ p
+        return self.gf(c)
+
+    def inverse(self):
+        return ref_egcd(self.gf(self.gf.p), self)[2]
+
+
+def timed(fn, reps):
+    start = time.perf_counter()
+    for _ in range(reps):
+        fn()
+    return (time.perf_counter() - start) / reps
+
+
+def check(n):
+    rnd = random.Random(1)
+    field, ref = gf2.GF2(POLY), RefGF2(POLY)
+    bad = 0
+    for _ in range(n):
+        a, b = rnd.randrange(1, field.n), rnd.randrange(field.n)
+        bad += (field(a) * field(b)).v != (ref(a) * ref(b)).v
+        bad += field(a).inverse().v != ref(a).inverse().v
+    return bad
+
+
+def main():
+    parser = argparse.ArgumentParser("GF(2^256) benchmark")
+    parser.add_argument("--reps", type=int, default=20, help="split/joins per k")
+    parser.add_argument("--check", type=int, default=200, help="random values")
+    parser.add_argument("--no-original", action="store_true")
+    args = parser.parse_args()
+
+    fields = [("gf2.py", gf2.GF2(POLY))]
+    if not args.no_original:
+        fields.append(("original", RefGF2(POLY)))
+
+    rnd = random.Random(2)
+    a, b = rnd.randrange(1, 2**256), rnd.randrange(1, 2**256)
+    for name, field in fields:
+        fa, fb = field(a), field(b)
+        tm = timed(lambda: fa * fb, 2000)
+        ti = timed(lambda: fa.inverse(), 200)
+        print(f"{name:9} mul {tm * 1e6:7.1f} us  inverse {ti * 1e6:8.1f} us")
+
+    print(f"{'':9} {'k':>2} {'n':>2} {'split ms':>9} {'join ms':>9}")
+    bad = 0
+    for k in range(3, 11):
+        for name, field in fields:
+            s = field(rnd.randrange(1, field.n))
+            ts = timed(lambda: sss.split(s, k, k + 2), args.reps)
+            r = sss.split(s, k, k + 2)
+            shares = rnd.sample(r, k)
+            tj = timed(lambda: sss.join(shares), args.reps)
+            bad += sss.join(shares) != s
+            print(f"{name:9} {k:2} {k + 2:2} {ts * 1e3:9.2f} {tj * 1e3:9.2f}")
+
+    bad += check(args.check)
+    print("ok" if bad == 0 else f"{bad} MISMATCHES")
+    exit(0 if bad == 0 else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -2,20 +2,84 @@
 
 import argparse
 import hashlib
+import json
+import mmap
+import os
 
 SIGNATURE_HDR_LEN = 512
 
-def hash(args):
-    with open(args.input, 'rb') as f:
-        data = f.read()
+# Hashing the image is shared by hash.py (apphash.cmake) and
+# cachelogdata.py.  Each image hash is kept in a manifest next to the image,
+# "<image>.sha512", keyed by the image's size, mtime and inode, so the build
+# hashes an image once however many tools ask:
+#
+#   {"size": n, "mtime_ns": t, "ino": i, "sha512": {"<skip>": "<hex>", ...}}
+#
+# <skip> is the number of leading bytes left out (0, or SIGNATURE_HDR_LEN
+# for the code of a signed image).  sbl.py sign doesn't use it - it signs
+# a hash of the code it loaded, never a cached digest.
+MANIFEST_EXT = ".sha512"
+HASH_CHUNK = 1 << 20
+
+def _stat_key(st):
+    return {"size": st.st_size, "mtime_ns": st.st_mtime_ns, "ino": st.st_ino}
+
+def _load_manifest(fname, key):
+    try:
+        with open(fname + MANIFEST_EXT, 'r') as f:
+            m = json.load(f)
+        if all(m.get(k) == v for k, v in key.items()):
+            return m
+    except (OSError, ValueError):
+        pass
+    return dict(key, sha512={})
+
+def _save_manifest(fname, m):
+    # Write to the side and rename so readers never see a partial manifest
+    tmp_fname = fname + MANIFEST_EXT + ".%d" % os.getpid()
+    try:
+        with open(tmp_fname, 'w') as f:
+            json.dump(m, f)
+        os.replace(tmp_fname, fname + MANIFEST_EXT)
+    except OSError:
+        # Read only build directory etc. - just no caching
+        pass
 
-    if args.full:
-        image_data = data
-    else:
-        image_data = data[SIGNATURE_HDR_LEN:]
-    hash_sha512 = hashlib.sha512()
-    hash_sha512.update(image_data)
-    h = hash_sha512.digest()
+def hash_data(data):
+    """
+    SHA-512 of data (bytes, memoryview or mmap) a chunk at a time so large
+    images aren't copied
+    """
+    h = hashlib.sha512()
+    view = memoryview(data)
+    for i in range(0, len(view), HASH_CHUNK):
+        h.update(view[i:i + HASH_CHUNK])
+    return h.digest()
+
+def image_hash(fname, skip=0, manifest=True):
+    """
+    SHA-512 of the file fname without its first skip bytes, from the
+    manifest if the file hasn't changed since it was hashed
+    """
+    with open(fname, 'rb') as f:
+        st = os.fstat(f.fileno())
+        key = _stat_key(st)
+        m = _load_manifest(fname, key) if manifest else None
+        if m is not None and str(skip) in m["sha512"]:
+            return bytes.fromhex(m["sha512"][str(skip)])
+        if st.st_size > skip:
+            with mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as data:
+                h = hash_data(memoryview(data)[skip:])
+        else:
+            h = hashlib.sha512().digest()
+    if m is not None:
+        m["sha512"][str(skip)] = h.hex()
+        _save_manifest(fname, m)
+    return h
+
+def hash(args):
+    h = image_hash(args.input, 0 if args.full else SIGNATURE_HDR_LEN,
+                   not args.no_manifest)
 
     with open(args.output, 'wb') as f:
         f.write(h)
@@ -26,6 +90,8 @@ if __name__ == '__main__':
     parser.add_argument('-i', '--input', help="Input file to hash", required=True)
     parser.add_argument('-o', '--output', help="Output file", required=True)
     parser.add_argument('-f', '--full', action='store_true', help="Use full file contents")
+    parser.add_argument('--no-manifest', action='store_true',
+                        help="Always hash the input, don't use or update its manifest")
 
     args = parser.parse_args()
 
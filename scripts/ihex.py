@@ -29,43 +29,95 @@ TY_START_SEG = 3
 TY_EXT_LIN = 4
 TY_START_LIN = 5
 
+# An image is a list of disjoint (addr, data) segments sorted by address -
+# gaps between them are left out.  load() builds each segment in a bytearray
+# as consecutive records arrive, so loading is linear in the file size, and
+# dump() formats the whole file before writing it.  Output matches
+# objcopy -O ihex: extended segment addresses below 1 MB, extended linear
+# above, 16 data bytes per record.
+
+
+def _error(n, rec):
+    return ValueError(f'invalid input "{rec}" on line {n}')
+
 
 def dec_record(n, rec):
+    if rec[:1] != ":":
+        raise _error(n, rec)
     try:
-        if rec[0] != ":":
-            raise ValueError("missing :")
         payload = bytes.fromhex(rec[1:])
-        if payload[0] != len(payload) - 5:
-            raise ValueError("invalid length")
-        if sum(payload) % 256 != 0:
-            raise ValueError("cs fail")
-        addr, ty, data = payload[1:3], payload[3], payload[4:-1]
-        (addr,) = struct.unpack(">H", addr)
-        if ty != TY_DATA and addr != 0:
-            raise ValueError("invalid addr")
-    except IndexError:
-        raise ValueError(f'invalid input "{rec}" on line {n}')
     except ValueError:
-        raise ValueError(f'invalid input "{rec}" on line {n}')
-    return addr, ty, data
+        raise _error(n, rec)
+    if len(payload) < 5 or payload[0] != len(payload) - 5 or sum(payload) & 0xFF:
+        raise _error(n, rec)
+    addr, ty = (payload[1] << 8) | payload[2], payload[3]
+    if ty != TY_DATA and addr != 0:
+        raise _error(n, rec)
+    return addr, ty, payload[4:-1]
 
 
 def enc_record(addr, ty, data):
-    payload = struct.pack(">BHB", len(data), addr, ty) + data
-    return ":" + (payload + bytes([(256 - (sum(payload) % 256)) % 256])).hex().upper()
+    payload = bytes((len(data), addr >> 8, addr & 0xFF, ty)) + data
+    return ":%s%02X" % (payload.hex().upper(), -sum(payload) & 0xFF)
 
 
-def load(f):
+def merge(segments):
+    """
+    Sorts [(addr, data)] and joins segments that touch or overlap (later
+    ones win) into a list of disjoint (addr, bytes)
+    """
     image = []
+    for addr, data in sorted(segments, key=lambda x: x[0]):
+        if image and addr <= image[-1][0] + len(image[-1][1]):
+            a, d = image[-1]
+            d[addr - a : addr - a + len(data)] = data
+        else:
+            image.append((addr, bytearray(data)))
+    return [(a, bytes(d)) for a, d in image]
+
+
+def flatten(image, fill=0xFF, max_gap=None):
+    """
+    The image as one (addr, data) with the gaps filled - like
+    objcopy -O binary --gap-fill.  Raises ValueError for a gap of more than
+    max_gap bytes (e.g. nRF UICR at 0x10001000 after flash at 0).
+    """
+    if len(image) == 0:
+        return 0, b""
+    start = image[0][0]
+    out = bytearray()
+    prev = None
+    for addr, data in image:
+        gap = addr - start - len(out)
+        if max_gap is not None and gap > max_gap:
+            raise ValueError(
+                f"segments 0x{prev[0]:08x}-0x{prev[0] + len(prev[1]):08x} and "
+                f"0x{addr:08x}-0x{addr + len(data):08x} are {gap} bytes apart "
+                f"(more than {max_gap})"
+            )
+        out += bytes((fill,)) * gap
+        out += data
+        prev = (addr, data)
+    return start, bytes(out)
+
+
+def load(f):
+    segments = []
+    cur = None  # segment being extended - [addr, bytearray]
     ss = 0
     base = 0
-    for n, line in enumerate(f.readlines()):
+    for n, line in enumerate(f):
         line = line.strip()
         if len(line) == 0:
             continue
         addr, ty, data = dec_record(n, line)
         if ty == TY_DATA:
-            image.append((base + addr, data))
+            addr += base
+            if cur is not None and cur[0] + len(cur[1]) == addr:
+                cur[1] += data
+            else:
+                cur = [addr, bytearray(data)]
+                segments.append(cur)
         elif ty == TY_EOF:
             break
         elif ty == TY_EXT_SEG:
@@ -78,18 +130,7 @@ def load(f):
         elif ty == TY_START_LIN:
             (ss,) = struct.unpack(">I", data)
 
-    # Combine individual data items into minimal set of disjoint segments
-    image = sorted(image, key=lambda x: x[0])
-    addr, data = image[0]
-    image2 = []
-    for a, d in image[1:]:
-        if addr + len(data) != a and len(data) > 0:
-            image2.append((addr, data))
-            addr = a
-            data = b""
-        data = data + d
-    image2.append((addr, data))
-    return ss, image2  # [(addr, data)]
+    return ss, merge(segments)  # [(addr, data)]
 
 
 def loads(s):
@@ -100,42 +141,37 @@ def loads(s):
 
 
 def dump(f, ss, image):
+    out = []
     base = 0
+    seg = False  # an extended segment address is in effect
     for addr, data in image:
-        offset = addr - base
-        while len(data) > 0:
-            n = 16
-            if offset >= 65536:
-                tmp = base + offset
-                base = (tmp // 65536) * 65536
-                offset = tmp - base
-                if base >= 65536 * 16:
-                    print(
-                        enc_record(0, TY_EXT_LIN, struct.pack(">I", base)),
-                        file=f,
-                        end="\r\n",
-                    )
+        data = memoryview(data)
+        i = 0
+        while i < len(data):
+            a = addr + i
+            if not base <= a < base + 65536:
+                base = a & ~0xFFFF
+                if base < 65536 * 16:
+                    out.append(enc_record(0, TY_EXT_SEG, struct.pack(">H", base >> 4)))
+                    seg = True
                 else:
-                    print(
-                        enc_record(0, TY_EXT_SEG, struct.pack(">H", base // 16)),
-                        file=f,
-                        end="\r\n",
-                    )
-            if offset + n > 65536:
-                n = 65536 - offset
-            d, data = data[:n], data[n:]
-            print(enc_record(offset, TY_DATA, d), file=f, end="\r\n")
-            offset += n
+                    if seg:
+                        out.append(enc_record(0, TY_EXT_SEG, b"\x00\x00"))
+                        seg = False
+                    out.append(enc_record(0, TY_EXT_LIN, struct.pack(">H", base >> 16)))
+            n = min(16, len(data) - i, base + 65536 - a)
+            out.append(enc_record(a - base, TY_DATA, bytes(data[i : i + n])))
+            i += n
 
     if ss >= 65536 * 16:
-        print(enc_record(0, TY_START_LIN, struct.pack(">I", ss)), file=f, end="\r\n")
+        out.append(enc_record(0, TY_START_LIN, struct.pack(">I", ss)))
     else:
         cs = (ss // 65536) * 4096
         ip = ss - cs * 16
-        print(
-            enc_record(0, TY_START_SEG, struct.pack(">HH", cs, ip)), file=f, end="\r\n"
-        )
-    print(enc_record(0, TY_EOF, b""), file=f, end="\r\n")
+        out.append(enc_record(0, TY_START_SEG, struct.pack(">HH", cs, ip)))
+    out.append(enc_record(0, TY_EOF, b""))
+    out.append("")
+    f.write("\r\n".join(out))
 
 
 def dumps(ss, image):
@@ -0,0 +1,185 @@
+#! /usr/bin/env python3
+
+# © 2025 Unit Circle Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Intel HEX load/dump speed and memory, ihex.py against the original
+# version, on a random image of --size bytes at --addr with --gaps 256 byte
+# gaps.
+# Both loaders must give the same image.  The new output round trips and,
+# if objcopy is on the path, matches objcopy -O ihex of the same data.
+
+import argparse
+import io
+import os
+import random
+import struct
+import subprocess
+import tempfile
+import time
+import tracemalloc
+
+import ihex
+
+
+# The original scripts/ihex.py load/dump - record lists joined by repeated
+# concatenation
+def ref_load(f):
+    image = []
+    ss = 0
+    base = 0
+    for n, line in enumerate(f.readlines()):
+        line = line.strip()
+        if len(line) == 0:
+            continue
+        payload = bytes.fromhex(line[1:])
+        addr, ty, data = (payload[1] << 8) | payload[2], payload[3], payload[4:-1]
+        if ty == ihex.TY_DATA:
+            image.append((base + addr, data))
+        elif ty == ihex.TY_EOF:
+            break
+        elif ty == ihex.TY_EXT_SEG:
+            base = struct.unpack(">H", data)[0] * 16
+        elif ty == ihex.TY_EXT_LIN:
+            (base,) = struct.unpack(">I", data + b"\x00\x00")
+    image = sorted(image, key=lambda x: x[0])
+    addr, data = image[0]
+    image2 = []
+    for a, d in image[1:]:
+        if addr + len(data) != a and len(data) > 0:
+            image2.append((addr, data))
+            addr = a
+            data = b""
+        data = data + d
+    image2.append((addr, data))
+    return ss, image2
+
+
+def ref_enc_record(addr, ty, data):
+    payload = struct.pack(">BHB", len(data), addr, ty) + data
+    cs = bytes([(256 - (sum(payload) % 256)) % 256])
+    return ":" + (payload + cs).hex().upper()
+
+
+def ref_dump(f, ss, image):
+    # Data records only - the original wrote extended linear addresses with
+    # 4 data bytes, which no loader accepts, so this is for timing
+    base = 0
+    for addr, data in image:
+        offset = addr - base
+        while len(data) > 0:
+            n = 16
+            if offset >= 65536:
+                tmp = base + offset
+                base = (tmp // 65536) * 65536
+                offset = tmp - base
+                rec = ref_enc_record(0, 4, struct.pack(">I", base))
+                print(rec, file=f, end="\r\n")
+            if offset + n > 65536:
+                n = 65536 - offset
+            d, data = data[:n], data[n:]
+            print(ref_enc_record(offset, ihex.TY_DATA, d), file=f, end="\r\n")
+            offset += n
+
+
+def make_image(size, addr, gaps):
+    rnd = random.Random(1)
+    data = rnd.randbytes(size)
+    cuts = sorted(rnd.sample(range(1, size // 256), gaps))
+    bounds = [0] + [c * 256 for c in cuts] + [size]
+    # A 256 byte gap before each cut
+    return [
+        (addr + bounds[i] + 256 * i, data[bounds[i] : bounds[i + 1]])
+        for i in range(len(bounds) - 1)
+    ]
+
+
+def timed(fn, *args):
+    start = time.perf_counter()
+    r = fn(*args)
+    return time.perf_counter() - start, r
+
+
+def peak(fn, *args):
+    tracemalloc.start()
+    fn(*args)
+    _, p = tracemalloc.get_traced_memory()
+    tracemalloc.stop()
+    return p
+
+
+def objcopy_hex(image):
+    """
+    objcopy -O ihex of the image, None if objcopy isn't available
+    """
+    with tempfile.TemporaryDirectory() as d:
+        args = ["objcopy", "-I", "binary", "-O", "ihex"]
+        parts = []
+        for i, (addr, data) in enumerate(image):
+            fname = os.path.join(d, f"{i}.bin")
+            with open(fname, "wb") as f:
+                f.write(data)
+            out = os.path.join(d, f"{i}.hex")
+            try:
+                subprocess.run(
+                    args + ["--change-addresses", str(addr), fname, out], check=True
+                )
+            except (OSError, subprocess.CalledProcessError):
+                return None
+            with open(out, newline="") as f:
+                parts.append(f.read())
+    # One objcopy run per segment - only the data records can be compared
+    return "".join(parts)
+
+
+def data_records(s):
+    return [r for r in s.split("\r\n") if r[7:9] == "00"]
+
+
+def main():
+    parser = argparse.ArgumentParser("Intel HEX benchmark")
+    parser.add_argument("--size", type=int, default=4 << 20, help="image bytes")
+    parser.add_argument("--addr", type=lambda x: int(x, 0), default=0)
+    parser.add_argument("--gaps", type=int, default=8)
+    parser.add_argument("--no-original", action="store_true")
+    args = parser.parse_args()
+
+    image = make_image(args.size, args.addr, args.gaps)
+    total = sum(len(d) for _, d in image)
+    ss = args.addr
+    te, text = timed(ihex.dumps, ss, image)
+    tl, (ss2, loaded) = timed(ihex.loads, text)
+    print(f"{total} bytes in {len(image)} segments, {len(text)} bytes of hex")
+    print(f"  ihex.py   load {tl:6.2f} s  dump {te:6.2f} s", end="")
+    print(f"  load peak {peak(ihex.loads, text) / 1e6:6.1f} MB")
+    ok = loaded == image and ss2 == ss
+
+    if not args.no_original:
+        tl, (_, ref) = timed(ref_load, io.StringIO(text))
+        te, _ = timed(ref_dump, io.StringIO(), ss, image)
+        print(f"  original  load {tl:6.2f} s  dump {te:6.2f} s", end="")
+        print(f"  load peak {peak(ref_load, io.StringIO(text)) / 1e6:6.1f} MB")
+        ok = ok and ref == image
+
+    ref = objcopy_hex(image)
+    if ref is not None:
+        same = data_records(ref) == data_records(text)
+        print(f"  same records as objcopy: {same}")
+        ok = ok and same
+    print("ok" if ok else "MISMATCH")
+    exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
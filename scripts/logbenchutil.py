@@ -0,0 +1,98 @@
+# © 2025 Unit Circle Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Fixtures shared by the LogServer benchmarks and tests (logserverbench.py,
+# logfragbench.py, logchantest.py, logrpcbench.py, logstreamtest.py): a
+# LogServer in a child process on the slave side of a pty, with the calling
+# process playing the target on the pty master, and port socket clients.
+
+import multiprocessing
+import os
+import pty
+import resource
+import socket
+import time
+import tty
+
+import cobs
+from uclog import CaptureWriter, LogServer
+
+
+def server(dev, hostport, conn, kwargs):
+    if kwargs.get("capture"):
+        # A file name - the writer is opened in the server process
+        kwargs["capture"] = CaptureWriter(kwargs["capture"])
+    s = LogServer(dev, hostport, {}, baudrate=115200, **kwargs)
+    conn.send("ready")
+    conn.recv()
+    r = resource.getrusage(resource.RUSAGE_SELF)
+    cpu = r.ru_utime + r.ru_stime
+    s.shutdown()
+    conn.send((cpu, s.metrics()))
+
+
+class PtyServer(object):
+    """
+    A LogServer (with LogServer keyword arguments kwargs) on a pty, started
+    and ready for connections.  master is the target side of the pty.
+    capture, if given, is the name of the file to capture to.
+    """
+
+    def __init__(self, hostport, **kwargs):
+        self.master, self.slave = pty.openpty()
+        tty.setraw(self.slave)
+        tty.setraw(self.master)
+        self.conn, child = multiprocessing.Pipe()
+        self.process = multiprocessing.Process(
+            target=server,
+            args=(os.ttyname(self.slave), hostport, child, kwargs),
+            daemon=True,
+        )
+        self.process.start()
+        self.conn.recv()
+
+    def shutdown(self):
+        """
+        Stop the server.  Returns the CPU seconds it used before shutting
+        down and its metrics().
+        """
+        self.conn.send("done")
+        cpu, metrics = self.conn.recv()
+        self.process.join()
+        os.close(self.master)
+        os.close(self.slave)
+        return cpu, metrics
+
+
+def connect(addr):
+    for _ in range(50):
+        try:
+            return socket.create_connection(addr)
+        except ConnectionRefusedError:
+            time.sleep(0.1)
+    raise RuntimeError(f"can't connect to {addr}")
+
+
+def recv_frame(sock, buf):
+    """
+    The next COBS frame from a port socket.  buf is a one element list
+    holding what has been received past the frame.
+    """
+    while b"\x00" not in buf[0].lstrip(b"\x00"):
+        data = sock.recv(1 << 20)
+        if not data:
+            raise RuntimeError("server closed connection")
+        buf[0] += data
+    frame, buf[0] = buf[0].lstrip(b"\x00").split(b"\x00", 1)
+    return cobs.dec(frame)
@@ -0,0 +1,175 @@
+#! /usr/bin/env python3
+
+# © 2025 Unit Circle Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Reliable port channel echo test.
+#
+# Sends random messages to a port and checks each one comes back intact.
+# Against a target built with CONFIG_APP_FRAG_ECHO=y (e.g. native_sim, whose
+# UART is a pty):
+#
+#   uclog.py -s --target /dev/pts/N --reliable 2
+#   logchantest.py --port 2
+#
+# With --sim a LogServer is run on a pty and this process plays the echo
+# target with the uclog.py fragmentation classes, dropping (--loss) and
+# corrupting (--corrupt) a percentage of the frames in both directions.
+# --crc adds the link frame check (CONFIG_UC_LOG_CRC16/32), in place of the
+# fragment CRC, so corrupted frames are dropped before the fragment layer
+# sees them, and reports the LogServer's link metrics.
+
+import argparse
+import os
+import random
+import time
+
+import cobs
+from logbenchutil import PtyServer, connect, recv_frame
+from uclog import (
+    LOG_DEFAULT_BASE,
+    LOG_MAX_MESSAGE_SIZE,
+    CobsDecode,
+    CobsEncode,
+    CrcDecode,
+    CrcEncode,
+    EventLoop,
+    FragMux,
+    FragReceiver,
+    FragSender,
+    MuxDecode,
+    chain,
+)
+
+
+class Link(object):
+    """
+    Drops or corrupts loss/corrupt percent of frames
+    """
+
+    def __init__(self, loss, corrupt, rnd):
+        self.loss = loss
+        self.corrupt = corrupt
+        self.rnd = rnd
+        self.dropped = 0
+        self.corrupted = 0
+        self.on_data = None
+
+    def __call__(self, frame):
+        if self.rnd.random() * 100 < self.loss:
+            self.dropped += 1
+            return
+        if self.rnd.random() * 100 < self.corrupt:
+            i = self.rnd.randrange(len(frame))
+            bit = bytes((frame[i] ^ (1 << self.rnd.randrange(8)),))
+            frame = frame[:i] + bit + frame[i + 1 :]
+            self.corrupted += 1
+        self.on_data(frame)
+
+
+class EchoTarget(object):
+    def __init__(self, master, port, loss, corrupt, crc):
+        rnd = random.Random(1)
+        self.loop = EventLoop()
+        self.fd = master
+        self.tx_link = Link(loss, corrupt, rnd)
+        self.rx_link = Link(loss, corrupt, rnd)
+        tx = chain([CrcEncode(crc), self.tx_link, CobsEncode(), self._write])
+        self.sender = FragSender(self.loop, port, crc=not crc)
+        self.sender.on_data = tx
+        self.receiver = FragReceiver(port, tx, window=2, crc=not crc)
+        # One message at a time, like the C echo
+        self.receiver.busy = lambda: self.sender.msg is not None
+        self.receiver.on_data = self.sender
+        self.loop.call_later(0.05, self.receiver.resume, 0.05)
+        mux = FragMux({port: self.receiver}, {port: self.sender}, crc=not crc)
+        self.rx = chain(
+            [
+                CobsDecode(LOG_MAX_MESSAGE_SIZE),
+                self.rx_link,
+                CrcDecode(crc),
+                MuxDecode({"frag": mux}),
+            ]
+        )
+        self.loop.register(master, 1, self._ready)
+        self.loop.start()
+
+    def _write(self, data):
+        while data:
+            n = os.write(self.fd, data)
+            data = data[n:]
+
+    def _ready(self, fd, mask):
+        self.rx(os.read(fd, 65536))
+
+    def shutdown(self):
+        self.loop.shutdown()
+
+
+def echo(sock, n, max_size):
+    rnd = random.Random(2)
+    buf = [b""]
+    sock.settimeout(60)
+    ok = 0
+    total = 0
+    start = time.time()
+    for i in range(n):
+        msg = rnd.randbytes(rnd.randrange(1, max_size + 1))
+        sock.sendall(b"\x00" + cobs.enc(msg) + b"\x00")
+        if recv_frame(sock, buf) == msg:
+            ok += 1
+        else:
+            print(f"  message {i} ({len(msg)} bytes) corrupted")
+        total += 2 * len(msg)
+    elapsed = time.time() - start
+    print(f"  {ok} of {n} echoed intact, {total * 8 / elapsed / 1e6:.2f} Mbit/s")
+    return ok == n
+
+
+def main():
+    parser = argparse.ArgumentParser("Reliable port channel echo test")
+    parser.add_argument("--host", default="localhost")
+    parser.add_argument("--base", type=int, default=LOG_DEFAULT_BASE)
+    parser.add_argument("--port", type=int, default=2, help="log server port")
+    parser.add_argument("-n", type=int, default=100, help="messages to echo")
+    parser.add_argument("--max", type=int, default=16384, help="largest message")
+    parser.add_argument("--sim", action="store_true", help="simulate the target")
+    parser.add_argument("--loss", type=float, default=0, help="percent (--sim)")
+    parser.add_argument("--corrupt", type=float, default=0, help="percent (--sim)")
+    parser.add_argument("--crc", type=int, default=0, help="frame check bits (--sim)")
+    args = parser.parse_args()
+
+    target = None
+    if args.sim:
+        srv = PtyServer((args.host, args.base), reliable=[args.port], crc=args.crc)
+        target = EchoTarget(srv.master, args.port, args.loss, args.corrupt, args.crc)
+
+    sock = connect((args.host, args.base + args.port + 1))
+    try:
+        ok = echo(sock, args.n, args.max)
+    finally:
+        sock.close()
+        if target:
+            target.shutdown()
+            links = (target.tx_link, target.rx_link)
+            dropped = sum(x.dropped for x in links)
+            corrupted = sum(x.corrupted for x in links)
+            print(f"  target link: dropped {dropped} corrupted {corrupted} frames")
+            _, m = srv.shutdown()
+            print("  log server: " + ", ".join(f"{k} {v}" for k, v in m.items()))
+    exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
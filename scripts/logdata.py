@@ -23,6 +23,15 @@ import argparse
 import time
 import cbor2
 import shutil
+import struct
+import sys
+import select
+import ctypes
+import functools
+import hashlib
+import threading
+import weakref
+from collections import OrderedDict
 
 from elftools.elf.elffile import ELFFile
 
@@ -31,7 +40,11 @@ LOG_TYPE_BASIC = 0x00
 LOG_TYPE_MEM = 0x01
 LOG_TYPE_RES = 0x02
 LOG_TYPE_PORT = 0x03
+# Large port messages are sent as fragments (lib/logserver.c)
+LOG_TYPE_FRAG = LOG_TYPE_RES
 TARGET_DIGIT_SHIFT = 20
+# Must match scripts/cachelogdata.py
+CACHE_DIR = os.path.join(os.path.expanduser("~"), ".cache", "uclog")
 level2str = {
     "0": "DEBUG ",
     "1": "INFO",
@@ -438,11 +451,15 @@ types = {
 }
 
 
+# A conversion may follow a structured field name tag "{@name}" (LOG_KV_*),
+# and then an enum or symbol tag
 re_fmt = re.compile(
-    r"(((?<!%)|(?P<sym>{sym})|({enum:(?P<enum>[^}]*)}))%[#+\- 0]*[0-9]*\.?[0-9]*(?:lu[fFeEgGaA]|[l]*[diouxXcfFeEgGaApsb]|z[douxX]))"
+    r"((?:{@(?P<key>[^}]*)})?((?<!%)|(?P<sym>{sym})|({enum:(?P<enum>[^}]*)}))%[#+\- 0]*[0-9]*\.?[0-9]*(?:lu[fFeEgGaA]|[l]*[diouxXcfFeEgGaApsb]|z[douxX]))"
 )
 
 
+# Call sites moved by an edit keep their format, so it isn't parsed again
+@functools.lru_cache(maxsize=4096)
 def cfmt2pfmt(fmt):
     # print(fmt)
     args = []
@@ -456,6 +473,12 @@ def cfmt2pfmt(fmt):
             infix = fmt[start:end]
             postfix = fmt[end:]
 
+            key = m.group("key")
+            if key is not None:
+                # Structured field - "{@name}%d" renders as "name=%d"
+                prefix += key + "="
+                infix = infix[len(key) + 3 :]
+
             if infix[-3:-1] == "ll":
                 specifier = infix[-3:]
             elif infix[-2:-1] == "l":
@@ -496,6 +519,30 @@ def cfmt2pfmt(fmt):
     return (r, args)
 
 
+@functools.lru_cache(maxsize=4096)
+def fmt_keys(fmt):
+    """
+    Field names of the arguments of a format - name for "{@name}%d", None
+    for a plain conversion - or None if it has no named fields
+    """
+    keys = tuple(m.group("key") for m in re_fmt.finditer(fmt))
+    return keys if any(k is not None for k in keys) else None
+
+
+def field_names(keys, n, reserved=()):
+    """
+    Names of n arguments - their field names from fmt_keys(), or arg<i> for
+    those without one and for repeated or reserved names
+    """
+    names = []
+    for i in range(n):
+        k = keys[i] if keys is not None and i < len(keys) else None
+        if k is None or k in names or k in reserved:
+            k = f"arg{i}"
+        names.append(k)
+    return names
+
+
 def parse_prefix(prefix):
     if prefix.count(":") >= 3:
         (level, fname, line, fmt) = prefix.split(":", 3)
@@ -508,25 +555,81 @@ def parse_prefix(prefix):
         return prefix
 
 
+def callsite_id(s):
+    # Stable ID of a call site - a hash of its "level:file:line:fmt" .logstr
+    # string, which doesn't change when a relink moves the string.  The same
+    # string twice (e.g. a macro expanded twice on one line) is one ID.
+    return int.from_bytes(hashlib.blake2b(s, digest_size=8).digest(), "little")
+
+
+class FmtIntern(object):
+    """
+    Parsed formats by call site ID, shared by all the tables loaded in the
+    process.  A reload or a closely related image only parses the formats
+    that changed, and the decoders of many images share one copy of each.
+    """
+
+    def __init__(self, limit=4096):
+        self.fmts = {}
+        self.tables = weakref.WeakSet()
+        self.limit = limit
+        self.parsed = 0
+
+    def get(self, cid, parse):
+        fmt = self.fmts.get(cid)
+        if fmt is None:
+            fmt = self.fmts[cid] = parse()
+            self.parsed += 1
+        return fmt
+
+    def add(self, tables):
+        self.tables.add(tables)
+        if len(self.fmts) > self.limit:
+            # Drop the formats of tables that have been freed
+            live = set()
+            for t in list(self.tables):
+                live.update(t.ids.values())
+            self.fmts = {k: v for k, v in self.fmts.items() if k in live}
+            self.limit = max(self.limit, 2 * len(self.fmts))
+
+
+FMTS = FmtIntern()
+
+
 def load_logdata(fname):
-    p = re.compile(b"([^\x00]*)\x00+")
-    s = None
     with open(fname, "rb") as f:
         elf = ELFFile(f)
         sdata = elf.get_section_by_name(".logdata").data()
         if len(sdata) == 0:
-            return None, {}
+            return None, {}, {}, [], {}
 
         s = elf.get_section_by_name(".symtab")
         saddr = s.get_symbol_by_name("_slogstr")
         if saddr is None:
-            return None, {}
+            return None, {}, {}, [], {}
         saddr = saddr[0].entry.st_value
 
-        strings = p.finditer(sdata)
-        fmt = {m.start() + saddr: parse_prefix(m.group(1).decode()) for m in strings}
+        # CONFIG_UC_LOG_CALLSITE_ID - call site index -> .logstr address
+        s = elf.get_section_by_name(".logidx")
+        idata = s.data() if s else b""
+        sites = list(struct.unpack(f"<{len(idata) // 4}I", idata[: len(idata) & ~3]))
 
-    return (saddr, fmt)
+    # NUL terminated strings, padded with NULs to LOG_STRING_ALIGN
+    fmts = {}
+    ids = {}
+    keys = {}
+    addr = saddr
+    for b in sdata.split(b"\x00"):
+        if b:
+            cid = callsite_id(b)
+            fmts[addr] = FMTS.get(cid, lambda: parse_prefix(b.decode()))
+            ids[addr] = cid
+            if b"{@" in b:
+                k = fmt_keys(b.decode().split(":", 3)[-1])
+                if k is not None:
+                    keys[addr] = k
+        addr += len(b) + 1
+    return (saddr, fmts, ids, sites, keys)
 
 
 def hex2str(b, sep=" "):
@@ -569,6 +672,17 @@ def fnencode(p):
         raise ValueError(f"unknown parser function {p}")
 
 
+@functools.lru_cache(maxsize=None)
+def raw_parser(p):
+    # Parser returning the value as sent by the target - enums and symbols
+    # stay as numbers
+    if p is parse_sym:
+        return parse_uint32
+    elif repr(p).startswith("<function parse_enum.<locals>.parser"):
+        return parse_int32
+    return p
+
+
 def fndecode(p):
     dec = {
         "int32": parse_int32,
@@ -589,6 +703,15 @@ def fndecode(p):
         raise ValueError(f"unknown parser function {p}")
 
 
+def decode_fmt(x):
+    if len(x) == 5:
+        level, fname, line, clean, parser = x
+        return level, fname, line, clean, [fndecode(p) for p in parser]
+    elif len(x) == 3:
+        level, fname, line = x
+        return level, fname, line
+
+
 def load_from_cbor(data):
     a = cbor2.loads(data)
     enums = a["enums"]
@@ -596,18 +719,24 @@ def load_from_cbor(data):
     variables = a["vars"]
     functions = a["fns"]
     saddr = a["saddr"]
+    # Call site IDs - logdata from before they were added gets IDs of the
+    # entries, which are only stable against other such logdata
+    ids = a.get("ids")
+    if ids is None:
+        ids = {
+            addr: callsite_id(cbor2.dumps(x, canonical=True))
+            for addr, x in a["fmts"].items()
+        }
 
     old_fmts = a["fmts"]
     fmts = {}
     for fmt in sorted(old_fmts.keys()):
         x = old_fmts[fmt]
-        if len(x) == 5:
-            level, fname, line, clean, parser = x
-            fmts[fmt] = level, fname, line, clean, [fndecode(p) for p in parser]
-        elif len(x) == 3:
-            level, fname, line = x
-            fmts[fmt] = level, fname, line
-    return enums, tdenums, variables, functions, saddr, fmts
+        if len(x) in (3, 5):
+            fmts[fmt] = FMTS.get(ids[fmt], lambda: decode_fmt(x))
+    sites = a.get("sites", [])
+    keys = {addr: tuple(k) for addr, k in a.get("keys", {}).items()}
+    return enums, tdenums, variables, functions, saddr, fmts, ids, sites, keys
 
 
 def load_cbor_from_elf(filename):
@@ -621,99 +750,390 @@ def load_cbor_from_elf(filename):
         return None
 
 
+def load_app_hash_from_elf(filename):
+    """
+    The app hash apphash.cmake put in the .apphash section, or None if the
+    image has none (not yet hashed, or a signed image whose hash is kept by
+    the bootloader)
+    """
+    with open(filename, "rb") as f:
+        elf = ELFFile(f)
+        s = elf.get_section_by_name(".apphash")
+        if s:
+            data = s.data()
+            if len(data) > 0 and any(data):
+                return bytes(data)
+        return None
+
+
+class LogTables(object):
+    """
+    Decoder tables for one image.  Never modified after construction so a
+    reload can swap in a new instance without locking the decode path.
+    """
+
+    def __init__(
+        self,
+        enums,
+        tdenums,
+        variables,
+        functions,
+        saddr,
+        fmts,
+        ids,
+        sites=(),
+        keys=None,
+        app_hash=None,
+    ):
+        self.enums = enums
+        self.tdenums = tdenums
+        self.variables = variables
+        self.functions = functions
+        self.saddr = saddr
+        self.fmts = fmts
+        # Call site address -> stable ID (see callsite_id())
+        self.ids = ids
+        # Call site index -> address, for images built with
+        # CONFIG_UC_LOG_CALLSITE_ID (empty otherwise)
+        self.sites = list(sites)
+        # Call site address -> field names of its arguments (see fmt_keys())
+        # for the call sites with structured fields
+        self.keys = dict(keys or {})
+        # App hash the image announces, if known (see load_app_hash_from_elf())
+        self.app_hash = app_hash
+        FMTS.add(self)
+
+    def lookup(self, addr):
+        """
+        Returns (addr, fmt) for a call site from MuxDecode - addr is the
+        .logstr address, or the call site index << 2 if the image sends
+        indices.  fmt is None if there is no such call site.
+        """
+        if self.sites:
+            i = addr >> 2
+            addr = self.sites[i] if i < len(self.sites) else None
+        return addr, self.fmts.get(addr)
+
+
+def load_tables(filename):
+    if filename.endswith((".cbor", ".logdata")):
+        with open(filename, "rb") as f:
+            data = f.read()
+        return LogTables(*load_from_cbor(data))
+    data = load_cbor_from_elf(filename)
+    app_hash = load_app_hash_from_elf(filename)
+    if data:
+        return LogTables(*load_from_cbor(data), app_hash=app_hash)
+    # No cached .logdata_cbor section so fall back to the (slow) DWARF scan
+    enums, tdenums, variables, functions = extract(*parse(filename))
+    saddr, fmts, ids, sites, keys = load_logdata(filename)
+    return LogTables(
+        enums, tdenums, variables, functions, saddr, fmts, ids, sites, keys, app_hash
+    )
+
+
+def diff_tables(old, new):
+    """
+    Returns the call site addresses in new that aren't in old (added), those
+    in old that aren't in new (removed), and the number of call sites in
+    both that moved to a new address
+    """
+    old_ids = {cid: a for a, cid in old.ids.items()}
+    new_ids = {cid: a for a, cid in new.ids.items()}
+    added = sorted(a for cid, a in new_ids.items() if cid not in old_ids)
+    removed = sorted(a for cid, a in old_ids.items() if cid not in new_ids)
+    moved = sum(1 for cid, a in new_ids.items() if old_ids.get(cid, a) != a)
+    return added, removed, moved
+
+
+# inotify constants from <sys/inotify.h>
+IN_CLOSE_WRITE = 0x00000008
+IN_MOVED_TO = 0x00000080
+IN_CREATE = 0x00000100
+IN_NONBLOCK = 0x00000800
+inotify_event = struct.Struct("iIII")
+
+
+class FileWatcher(threading.Thread):
+    """
+    Calls on_change() after filename has been rewritten and then left alone
+    for settle seconds (the build rewrites the ELF more than once - link, then
+    objcopy --add-section .logdata_cbor).
+
+    Uses inotify on Linux, and falls back to polling st_mtime elsewhere.  The
+    directory is watched rather than the file as tools often replace the file
+    by renaming over it.
+    """
+
+    def __init__(self, filename, on_change, settle=0.5, poll=1.0):
+        threading.Thread.__init__(self, daemon=True)
+        self.filename = os.path.abspath(filename)
+        self.on_change = on_change
+        self.settle = settle
+        self.poll = poll
+        self.alive = True
+        self.fd = self._inotify_init()
+        self.start()
+
+    def _inotify_init(self):
+        if not sys.platform.startswith("linux"):
+            return None
+        try:
+            libc = ctypes.CDLL(None, use_errno=True)
+            fd = libc.inotify_init1(IN_NONBLOCK)
+            if fd < 0:
+                return None
+            wd = libc.inotify_add_watch(
+                fd,
+                os.path.dirname(self.filename).encode(),
+                IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE,
+            )
+            if wd < 0:
+                os.close(fd)
+                return None
+            return fd
+        except (OSError, AttributeError):
+            return None
+
+    def shutdown(self):
+        if self.alive:
+            self.alive = False
+            self.join()
+
+    def _mtime(self):
+        try:
+            return os.stat(self.filename).st_mtime
+        except OSError:
+            return None
+
+    def _touched(self, timeout):
+        if self.fd is None:
+            time.sleep(timeout)
+            return False
+        r, _, _ = select.select((self.fd,), (), (), timeout)
+        if len(r) == 0:
+            return False
+        try:
+            data = os.read(self.fd, 4096)
+        except BlockingIOError:
+            return False
+        name = os.path.basename(self.filename).encode()
+        touched = False
+        while len(data) >= inotify_event.size:
+            _, _, _, n = inotify_event.unpack_from(data)
+            end = inotify_event.size + n
+            if data[inotify_event.size : end].rstrip(b"\x00") == name:
+                touched = True
+            data = data[end:]
+        return touched
+
+    def run(self):
+        ts = self._mtime()
+        pending = None
+        try:
+            while self.alive:
+                if self._touched(self.settle if pending else self.poll):
+                    pending = time.time()
+                elif self.fd is None:
+                    new_ts = self._mtime()
+                    if new_ts != ts:
+                        ts = new_ts
+                        pending = time.time()
+                if pending and time.time() - pending >= self.settle:
+                    pending = None
+                    try:
+                        self.on_change()
+                    except Exception as e:
+                        # Most likely caught the file half written - the
+                        # next write will trigger another attempt.
+                        print(f"Reload of {self.filename} failed: {e}")
+        finally:
+            if self.fd is not None:
+                os.close(self.fd)
+
+
 class LogData(object):
-    def __init__(self, filename, verbose=False):
+    """
+    Decoder for an image's log messages.  A rebuilt image is loaded when its
+    file changes.  If the target announces its image (see set_app_hash())
+    the new tables are only used once it runs the new image - until then
+    records still come from the old one.  Otherwise (raw links, older
+    firmware, offline decode) they are used straight away.
+    """
+
+    def __init__(self, filename, verbose=False, watch=True):
         if verbose:
             print(f"Loading {filename}")
-        if filename.endswith(".cbor"):
-            with open(filename, "rb") as f:
-                data = f.read()
-            (
-                self.enums,
-                self.tdenums,
-                self.variables,
-                self.functions,
-                self.saddr,
-                self.fmts,
-            ) = load_from_cbor(data)
-        else:
-            data = load_cbor_from_elf(filename)
-            if data:
-                (
-                    self.enums,
-                    self.tdenums,
-                    self.variables,
-                    self.functions,
-                    self.saddr,
-                    self.fmts,
-                ) = load_from_cbor(data)
-            else:
-                self.enums, self.tdenums, self.variables, self.functions = extract(
-                    *parse(filename)
-                )
-                self.saddr, self.fmts = load_logdata(filename)
+        self.tables = load_tables(filename)
+        # Tables of a rebuilt image the target hasn't announced yet
+        self.next_tables = None
+        # Last app hash the target announced, and the one the image of
+        # self.tables announced (or has, if known)
+        self.app_hash = None
+        self.tables_hash = self.tables.app_hash
+        self.lock = threading.Lock()
         self.filename = filename
-        self.ts = os.stat(filename).st_mtime
         self.count = 0
         self.start_time = time.time()
+        self.watcher = FileWatcher(filename, self.reload) if watch else None
         if verbose:
             print(f"Loaded target: {self.filename} target: {self.target()}")
 
+    # Accessors for the current tables (used by parse_enum/parse_sym)
+    @property
+    def enums(self):
+        return self.tables.enums
+
+    @property
+    def tdenums(self):
+        return self.tables.tdenums
+
+    @property
+    def variables(self):
+        return self.tables.variables
+
+    @property
+    def functions(self):
+        return self.tables.functions
+
+    @property
+    def saddr(self):
+        return self.tables.saddr
+
+    @property
+    def fmts(self):
+        return self.tables.fmts
+
+    @property
+    def ids(self):
+        return self.tables.ids
+
+    @property
+    def sites(self):
+        return self.tables.sites
+
+    @property
+    def keys(self):
+        return self.tables.keys
+
     def target(self):
         if self.saddr is None:
             return None
         return (self.saddr >> TARGET_DIGIT_SHIFT) & 0xF
 
-    def _check_for_reload(self):
-        ts = os.stat(self.filename).st_mtime
-        if ts != self.ts:
-            old_target = self.target()
-            self.enums, self.tdenums, self.variables, self.functions = extract(
-                *parse(self.filename)
-            )
-            self.saddr, self.fmts = load_logdata(self.filename)
-            self.ts = ts
-
-            if self.target() != old_target:
-                print("Target changed from %d to %d" % (old_target, self.target()))
-            print("Reloaded:", self.filename)
-
-    def decode(self, item):
-        self._check_for_reload()
+    def shutdown(self):
+        if self.watcher:
+            self.watcher.shutdown()
+
+    def reload(self):
+        # Called from the watcher thread.  Build the new tables off to the
+        # side - they're published, with a single reference assignment so
+        # decode() never sees a partially updated set, when the target runs
+        # the new image, or at once if the target doesn't announce images.
+        tables = load_tables(self.filename)
+        print("Reloaded:", self.filename)
+        with self.lock:
+            if self._announced(tables):
+                self._use(tables)
+            else:
+                self.next_tables = tables
+                print("Waiting for the target to announce the new image")
+
+    def set_app_hash(self, app_hash):
+        """
+        The target announced the image it is running (port 63, on each
+        log_tx_resume()) - switch to the reloaded tables if it's theirs
+        """
+        with self.lock:
+            self.app_hash = bytes(app_hash)
+            if self.next_tables is not None and self._announced(self.next_tables):
+                self._use(self.next_tables)
+            elif self.tables_hash is None:
+                self.tables_hash = self.app_hash
+
+    def _announced(self, tables):
+        # Whether the target is running the image of tables.  Its app hash
+        # is only known for images hashed by apphash.cmake - otherwise any
+        # image other than the one last decoded is taken to be the new one.
+        # No announcement yet - the target may never send one, so there's
+        # nothing to wait for.
+        if self.app_hash is None:
+            return True
+        if tables.app_hash is not None:
+            return tables.app_hash == self.app_hash
+        return self.app_hash != self.tables_hash
+
+    def _use(self, tables):
+        old_target = self.target()
+        self.tables, self.next_tables = tables, None
+        self.tables_hash = tables.app_hash or self.app_hash
+        if self.target() != old_target:
+            print("Target changed from %s to %s" % (old_target, self.target()))
+        print("Using the new image:", self.filename)
+
+    def decode(self, item, ts=None):
+        return tuple(self.lazy(item, ts))
+
+    def lazy(self, item, ts=None):
+        """
+        The record as a LogRecord, which does the work of decode() only if
+        its text is wanted
+        """
+        if ts is None:
+            ts = time.time() - self.start_time
+        self.count += 1
+        ts = int(ts * 1000 + 0.5) / 1000.0
+        return LogRecord(self.tables, item, self.count, ts)
+
+    def values(self, item):
+        """
+        Returns (callsite, kind, vals) with the arguments as raw typed values
+        (enums and symbols are not resolved) for consumers that don't need
+        text, or None if the record can't be decoded.
+        """
         target, addr, frame = item
-        kind = addr & 3
-        addr = addr & ~3
-        (level, fname, line, clean, parser) = self.fmts.get(
-            addr, (None, None, None, None, None)
-        )
-        ts = int((time.time() - self.start_time) * 1000 + 0.5) / 1000.0
+        return site_values(find_site(self.tables, addr), frame)
+
+    def record(self, item, ts=None):
+        """
+        Returns the record as a dict of typed values, for JSON and the like,
+        without rendering its text:
+
+          {"n", "ts", "level", "file", "line", "id": call site ID,
+           "fields": {name: value}}
+
+        Fields are named as in the format (see field_names()), and a memory
+        dump has fields addr and data.  A record from an unknown call site
+        has "target", "addr" and "raw" (argument bytes) instead of the call
+        site and fields, and one that doesn't match its format has "raw" and
+        "error" instead of fields.
+        """
+        target, addr, frame = item
+        tables, site, kind, fmt = find_site(self.tables, addr)
+        if ts is None:
+            ts = time.time() - self.start_time
         self.count += 1
-        if level is None or kind not in [LOG_TYPE_BASIC, LOG_TYPE_MEM]:
-            return (self.count, ts, target, addr, frame)
+        r = {"n": self.count, "ts": int(ts * 1000 + 0.5) / 1000.0}
+        if fmt is None or len(fmt) != 5 or kind not in [LOG_TYPE_BASIC, LOG_TYPE_MEM]:
+            r.update(target=target, addr=addr & ~3, raw=frame)
+            return r
+        (level, fname, line, clean, parser) = fmt
+        r.update(
+            level=level2str.get(level, f"<bad level {level}>").strip(),
+            file=fname,
+            line=int(line) if line.isdigit() else line,
+            id=tables.ids.get(site),
+        )
+        if kind == LOG_TYPE_MEM:
+            names, parser = ["addr", "data"], [parse_pointer, parse_bytes]
         else:
-            if kind == LOG_TYPE_MEM:
-                parser = [parse_pointer, parse_bytes]
-            (vals, error) = extract_vals(frame, parser, self)
-            # print(f'vals: {vals} error: {error}')
-            if vals is not None:
-                if kind == LOG_TYPE_MEM and line == "<zephyr>":
-                    text = f"{vals[1].decode()}"
-                    line = ""
-                elif kind == LOG_TYPE_MEM:
-                    text = f"{clean} {vals[0]:08x}: {hex2str(vals[1])}"
-                else:
-                    text = clean % vals
-                level = level2str.get(level, f"<bad level {level}>")
-                return (self.count, ts, level, fname, line, text)
-            else:
-                return (
-                    self.count,
-                    ts,
-                    level,
-                    fname,
-                    line,
-                    f"{clean} [{frame.hex()} - {error}]",
-                )
+            names = field_names(tables.keys.get(site), len(parser))
+        (vals, error) = extract_vals(frame, parser, tables)
+        if vals is None:
+            r.update(raw=frame, error=error)
+        else:
+            r["fields"] = dict(zip(names, vals))
+        return r
 
     def dump_fmts(self):
         for a in sorted(self.fmts.keys()):
@@ -761,19 +1181,204 @@ class LogData(object):
                 "fns": self.functions,
                 "saddr": self.saddr,
                 "fmts": fmts,
+                "ids": self.ids,
+                "sites": self.sites,
+                "keys": self.keys,
             }
         )
         with open(ofname, "wb") as f:
             f.write(a)
 
 
+def find_site(tables, addr):
+    """
+    (tables, site, kind, fmt) of the call site of a message sent with addr
+    (see LogRecord.site())
+    """
+    site, fmt = tables.lookup(addr & ~3)
+    if fmt is None:
+        site = addr & ~3
+    return (tables, site, addr & 3, fmt)
+
+
+def site_values(found, frame):
+    """
+    (site, kind, vals) of a message's arguments as raw typed values, given
+    its call site as find_site() returns it, or None (see LogData.values())
+    """
+    tables, site, kind, fmt = found
+    if fmt is None or len(fmt) != 5:
+        return None
+    if kind == LOG_TYPE_MEM:
+        parser = [parse_pointer, parse_bytes]
+    elif kind == LOG_TYPE_BASIC:
+        parser = [raw_parser(p) for p in fmt[4]]
+    else:
+        return None
+    (vals, error) = extract_vals(frame, parser, tables)
+    if vals is None:
+        return None
+    return (site, kind, vals)
+
+
+class LogRecord(object):
+    """
+    A log message and its decoder tables, formatted only when read.  Reads
+    as the tuple LogData.decode() gives - (n, ts, level, file, line, text),
+    or (n, ts, target, addr, args) from an unknown call site.  raw() is the
+    message as it came from the target, for clients that decode themselves.
+    """
+
+    __slots__ = (
+        "tables",
+        "item",
+        "n",
+        "ts",
+        "_decoded",
+        "_site",
+        "_values",
+    )
+
+    def __init__(self, tables, item, n, ts):
+        self.tables = tables
+        self.item = item
+        self.n = n
+        self.ts = ts
+        self._decoded = None
+        self._site = None
+        self._values = False
+
+    def raw(self):
+        """
+        (n, ts, target, addr, args) - addr still has the message type in
+        bits 0-1, so LogData.decode() of (target, addr, args) gives the
+        same record back
+        """
+        return (self.n, self.ts) + tuple(self.item)
+
+    def site(self):
+        """
+        (tables, addr, kind, fmt) of the call site - the tables that know
+        it, its .logstr address and the format from parse_prefix(), or the
+        address as sent and fmt None if no tables know it
+        """
+        if self._site is None:
+            self._site = find_site(self.tables, self.item[1])
+        return self._site
+
+    def values(self):
+        """
+        (callsite, kind, vals) with the arguments as raw typed values, as
+        LogData.values() gives, or None if they can't be decoded
+        """
+        if self._values is False:
+            self._values = site_values(self.site(), self.item[2])
+        return self._values
+
+    def decoded(self):
+        if self._decoded is None:
+            self._decoded = self._decode()
+        return self._decoded
+
+    def __len__(self):
+        return len(self.decoded())
+
+    def __getitem__(self, i):
+        return self.decoded()[i]
+
+    def __iter__(self):
+        return iter(self.decoded())
+
+    def __repr__(self):
+        return repr(self.decoded())
+
+    def _decode(self):
+        target, _, frame = self.item
+        tables, addr, kind, fmt = self.site()
+        if fmt is None or len(fmt) != 5:
+            fmt = (None, None, None, None, None)
+        (level, fname, line, clean, parser) = fmt
+        ts = self.ts
+        if level is None or kind not in [LOG_TYPE_BASIC, LOG_TYPE_MEM]:
+            return (self.n, ts, target, addr, frame)
+        else:
+            if kind == LOG_TYPE_MEM:
+                parser = [parse_pointer, parse_bytes]
+            (vals, error) = extract_vals(frame, parser, tables)
+            # print(f'vals: {vals} error: {error}')
+            if vals is not None:
+                if kind == LOG_TYPE_MEM and line == "<zephyr>":
+                    text = f"{vals[1].decode()}"
+                    line = ""
+                elif kind == LOG_TYPE_MEM:
+                    text = f"{clean} {vals[0]:08x}: {hex2str(vals[1])}"
+                else:
+                    text = clean % vals
+                level = level2str.get(level, f"<bad level {level}>")
+                return (self.n, ts, level, fname, line, text)
+            else:
+                return (
+                    self.n,
+                    ts,
+                    level,
+                    fname,
+                    line,
+                    f"{clean} [{frame.hex()} - {error}]",
+                )
+
+
+class LogDataCache(object):
+    """
+    Decoders for images in the logdata cache (see cachelogdata.py), looked up
+    by the 64 byte app hash the target sends on each log_tx_resume().  The
+    most recently used size decoders are kept loaded.
+    """
+
+    def __init__(self, cache_dir=CACHE_DIR, size=8):
+        self.cache_dir = cache_dir
+        self.size = size
+        self.decoders = OrderedDict()
+
+    def get(self, app_hash):
+        h = app_hash.hex()
+        d = self.decoders.get(h)
+        if d is not None:
+            self.decoders.move_to_end(h)
+            return d
+
+        fname = os.path.join(self.cache_dir, h + ".logdata")
+        if not os.path.isfile(fname):
+            return None
+
+        d = LogData(fname, watch=False)
+        self.decoders[h] = d
+        while len(self.decoders) > self.size:
+            self.decoders.popitem(last=False)
+        return d
+
+
 if __name__ == "__main__":
     parser = argparse.ArgumentParser("Dump ELF log data")
     parser.add_argument("file", help="ELF file to process")
     parser.add_argument("--ofile", help="Output File of preprocessed data")
     parser.add_argument("--dump", action="store_true", help="Dump data")
+    parser.add_argument("--diff", help="List call sites changed since this image")
     args = parser.parse_args()
-    d = LogData(args.file)
+    if args.ofile and os.path.isfile(args.ofile):
+        # Only the formats changed since the last build need parsing
+        try:
+            load_tables(args.ofile)
+        except Exception:
+            pass
+    d = LogData(args.file, watch=False)
+    if args.diff:
+        old = load_tables(args.diff)
+        added, removed, moved = diff_tables(old, d.tables)
+        for sign, tables, addrs in (("-", old, removed), ("+", d.tables, added)):
+            for a in addrs:
+                x = tables.fmts[a]
+                print(f"{sign} {tables.ids[a]:016x} {':'.join(str(v) for v in x[:4])}")
+        print(f"{len(added)} added, {len(removed)} removed, {moved} moved")
     if args.dump:
         d.dump_fmts()
         d.dump()
@@ -0,0 +1,354 @@
+#! /usr/bin/env python3
+
+# © 2025 Unit Circle Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Export decoded log records from a capture (see uclog.py --capture) to
+# Apache Arrow IPC or Parquet files for offline analytics.
+#
+# Each callsite gets its own file with typed columns:
+#   seq, ts, arg0, arg1, ...
+# where the argument types come from the format string (%d -> int32, %llu ->
+# uint64, %f -> float64, %s -> string, ...).  Structured fields ("{@name}"
+# in the format, see LOG_KV_INFO() in include/log.h) are named columns, so
+# queries can filter on them by name.  Enums and symbols are exported
+# as their raw numbers.  LOG_MEM records have columns seq, ts, addr, data.
+#
+# callsites.<ext> maps each file back to the image, level, file, line and
+# format of the callsite.
+
+import argparse
+import os
+import struct
+import tempfile
+import time
+
+import pyarrow as pa
+import pyarrow.ipc
+import pyarrow.parquet as pq
+
+from logdata import (
+    LogDataCache,
+    LOG_TYPE_MEM,
+    field_names,
+    fnencode,
+    parse_double,
+    parse_int32,
+    parse_int64,
+    parse_pointer,
+    parse_uint32,
+    parse_uint64,
+)
+from uclog import CaptureReader, CaptureWriter, MuxDecode, decoders
+
+EXPORT_BATCH = 65536
+
+arrow_types = {
+    "int32": pa.int32(),
+    "uint32": pa.uint32(),
+    "int64": pa.int64(),
+    "uint64": pa.uint64(),
+    "double": pa.float64(),
+    "pointer": pa.uint32(),
+    "sym": pa.uint32(),
+    "string": pa.string(),
+    "bytes": pa.binary(),
+}
+
+
+def missing(v):
+    # logdata's placeholder for an argument past the end of a short frame
+    return isinstance(v, str) and v.startswith("<missing ")
+
+
+def arrow_type(p):
+    t = fnencode(p)
+    if isinstance(t, tuple):
+        return pa.int32()  # ("enum", name)
+    return arrow_types[t]
+
+
+class CallsiteWriter(object):
+    def __init__(self, fname, schema, fmt):
+        self.schema = schema
+        self.columns = [[] for _ in schema]
+        self.n = 0
+        self.total = 0
+        if fmt == "parquet":
+            self.writer = pq.ParquetWriter(fname, schema)
+        else:
+            self.writer = pa.ipc.new_file(fname, schema)
+
+    def append(self, seq, ts, vals):
+        c = self.columns
+        c[0].append(seq)
+        c[1].append(ts)
+        for i, v in enumerate(vals):
+            c[i + 2].append(v)
+        self.n += 1
+        if self.n >= EXPORT_BATCH:
+            self.flush()
+
+    def flush(self):
+        if self.n == 0:
+            return
+        batch = pa.record_batch(
+            [pa.array(c, type=f.type) for c, f in zip(self.columns, self.schema)],
+            schema=self.schema,
+        )
+        self.writer.write_batch(batch)
+        self.total += self.n
+        self.columns = [[] for _ in self.schema]
+        self.n = 0
+
+    def close(self):
+        self.flush()
+        self.writer.close()
+
+
+class ColumnarExport(object):
+    def __init__(self, outdir, fmt="parquet"):
+        self.outdir = outdir
+        self.fmt = fmt
+        self.ext = "parquet" if fmt == "parquet" else "arrow"
+        self.writers = {}
+        self.callsites = []
+        self.skipped = 0
+        os.makedirs(outdir, exist_ok=True)
+
+    def _writer(self, image, decoder, callsite, kind):
+        key = (image, callsite, kind)
+        w = self.writers.get(key)
+        if w is not None:
+            return w
+        level, fname, line, clean, parser = decoder.fmts[callsite]
+        fields = [pa.field("seq", pa.uint64()), pa.field("ts", pa.float64())]
+        if kind == LOG_TYPE_MEM:
+            fields += [pa.field("addr", pa.uint32()), pa.field("data", pa.binary())]
+        else:
+            names = field_names(
+                decoder.keys.get(callsite), len(parser), ("seq", "ts")
+            )
+            fields += [pa.field(n, arrow_type(p)) for n, p in zip(names, parser)]
+        name = f"{image}_{callsite:08x}_{kind}.{self.ext}"
+        w = CallsiteWriter(os.path.join(self.outdir, name), pa.schema(fields), self.fmt)
+        self.writers[key] = w
+        self.callsites.append((image, callsite, kind, level, fname, line, clean, name))
+        return w
+
+    def add(self, image, decoder, seq, ts, item):
+        r = decoder.values(item)
+        # Placeholders don't fit the columns' types
+        if r is None or any(map(missing, r[2])):
+            self.skipped += 1
+            return
+        callsite, kind, vals = r
+        self._writer(image, decoder, callsite, kind).append(seq, ts, vals)
+
+    def close(self):
+        records = 0
+        for w in self.writers.values():
+            w.close()
+            records += w.total
+        cols = list(zip(*self.callsites)) if self.callsites else [[]] * 8
+        table = pa.table(
+            {
+                "image": pa.array(cols[0], pa.string()),
+                "callsite": pa.array(cols[1], pa.uint32()),
+                "kind": pa.array(cols[2], pa.uint8()),
+                "level": pa.array(cols[3], pa.string()),
+                "file": pa.array(cols[4], pa.string()),
+                "line": pa.array(cols[5], pa.string()),
+                "fmt": pa.array(cols[6], pa.string()),
+                "path": pa.array(cols[7], pa.string()),
+            }
+        )
+        fname = os.path.join(self.outdir, f"callsites.{self.ext}")
+        if self.fmt == "parquet":
+            pq.write_table(table, fname)
+        else:
+            with pa.ipc.new_file(fname, table.schema) as w:
+                w.write_table(table)
+        return records
+
+
+def export(
+    capture,
+    dec,
+    cache,
+    outdir,
+    fmt="parquet",
+    start=None,
+    end=None,
+    callsite_ids=False,
+):
+    """
+    Returns (frames, records) processed.  start/end are seconds relative to
+    the start of the capture.  callsite_ids for captures from targets built
+    with CONFIG_UC_LOG_CALLSITE_ID.
+    """
+    reader = CaptureReader(capture)
+    t0 = reader.start_time()
+    out = ColumnarExport(outdir, fmt)
+    dec = dict(dec)
+    # Call site indices carry no target digit - use the image last announced
+    target = next(iter(dec)) if len(dec) == 1 else None
+    state = {"image": "local", "seq": 0, "ts": 0.0, "target": target}
+
+    def on_log(item):
+        target = item[0]
+        if target is None:
+            target = state["target"]
+        if target in dec:
+            out.add(state["image"], dec[target], state["seq"], state["ts"], item)
+        else:
+            out.skipped += 1
+
+    def on_hash(app_hash):
+        if cache is not None:
+            d = cache.get(app_hash)
+            if d is not None:
+                dec[d.target()] = d
+                state["image"] = app_hash.hex()[:16]
+                state["target"] = d.target()
+            else:
+                # Not decoded with the previous image's tables - skipped
+                state["image"] = "unknown"
+                state["target"] = None
+
+    mux = MuxDecode({"log": on_log, "hash": on_hash}, callsite_ids)
+    frames = 0
+    app_hash = None
+    try:
+        if t0 is not None:
+            for ts, seq, h, frame in reader.frames(
+                None if start is None else t0 + start,
+                None if end is None else t0 + end,
+            ):
+                if h != app_hash:
+                    app_hash = h
+                    if any(h):
+                        on_hash(h)
+                state["seq"] = seq
+                state["ts"] = ts
+                mux(frame)
+                frames += 1
+    finally:
+        reader.close()
+    return frames, out.close()
+
+
+# Used to synthesize argument values for --bench
+synth = {
+    parse_int32: lambda i: struct.pack("<i", i % 100000 - 50000),
+    parse_uint32: lambda i: struct.pack("<I", i % 1000000),
+    parse_int64: lambda i: struct.pack("<q", i * 1000003),
+    parse_uint64: lambda i: struct.pack("<Q", i * 1000003),
+    parse_double: lambda i: struct.pack("<d", i * 0.001),
+    parse_pointer: lambda i: struct.pack("<I", 0x20000000 + (i % 4096) * 4),
+}
+
+
+def bench(dec, n, fmt, compress):
+    """
+    Synthesize a capture of n records over the numeric callsites of the
+    given decoders and time its conversion.
+    """
+    frames = []
+    for d in dec.values():
+        for addr, x in d.fmts.items():
+            if len(x) == 5 and all(p in synth for p in x[4]):
+                frames.append((addr, x[4]))
+    if len(frames) == 0:
+        print("No callsites with numeric arguments to benchmark")
+        return
+
+    with tempfile.TemporaryDirectory() as tmp:
+        capture = os.path.join(tmp, "bench.cap")
+        w = CaptureWriter(capture, compress)
+        start = time.time()
+        for i in range(n):
+            addr, parser = frames[i % len(frames)]
+            w(struct.pack("<I", addr) + b"".join(synth[p](i) for p in parser))
+        w.close()
+        size = os.path.getsize(capture)
+        print(
+            f"capture:  {n} records {size / 1e6:.1f} MB in {time.time() - start:.2f} s"
+        )
+
+        start = time.time()
+        nframes, records = export(capture, dec, None, os.path.join(tmp, "out"), fmt)
+        elapsed = time.time() - start
+        out_size = sum(
+            os.path.getsize(os.path.join(tmp, "out", f))
+            for f in os.listdir(os.path.join(tmp, "out"))
+        )
+        print(
+            f"export:   {records} records {out_size / 1e6:.1f} MB in {elapsed:.2f} s "
+            f"({nframes / elapsed / 1e3:.0f} k records/s, "
+            f"{size / elapsed / 1e6:.1f} MB/s of capture)"
+        )
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser("Export captured logs to Arrow/Parquet")
+    parser.add_argument("capture", nargs="?", help="capture file from uclog.py --capture")
+    parser.add_argument("-o", "--outdir", default="uclog-export", help="output directory")
+    parser.add_argument("-e", action="append", help="ELF to use for decoding")
+    parser.add_argument(
+        "--format", choices=["parquet", "arrow"], default="parquet", help="output format"
+    )
+    parser.add_argument(
+        "--start", type=float, help="export from seconds after capture start"
+    )
+    parser.add_argument(
+        "--end", type=float, help="export until seconds after capture start"
+    )
+    parser.add_argument(
+        "--no-cache", action="store_true", help="don't use decoders from ~/.cache/uclog"
+    )
+    parser.add_argument(
+        "--bench", type=int, metavar="N", help="benchmark exporting N synthetic records"
+    )
+    parser.add_argument(
+        "--zstd", action="store_true", help="zstd compress the benchmark capture"
+    )
+    parser.add_argument(
+        "--callsite-ids",
+        action="store_true",
+        help="call sites sent as indices (target CONFIG_UC_LOG_CALLSITE_ID)",
+    )
+    args = parser.parse_args()
+
+    if args.bench:
+        bench(decoders(args.e), args.bench, args.format, args.zstd)
+    elif args.capture:
+        cache = None if args.no_cache else LogDataCache()
+        start = time.time()
+        frames, records = export(
+            args.capture,
+            decoders(args.e),
+            cache,
+            args.outdir,
+            args.format,
+            args.start,
+            args.end,
+            args.callsite_ids,
+        )
+        print(
+            f"Exported {records} of {frames} frames to {args.outdir} "
+            f"in {time.time() - start:.2f} s"
+        )
+    else:
+        parser.print_help()
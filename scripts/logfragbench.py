@@ -0,0 +1,170 @@
+#! /usr/bin/env python3
+
+# © 2025 Unit Circle Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Measure port throughput of fragmented messages against single frames.
+#
+# A LogServer is run in a child process on the slave side of a pty.  This
+# process plays the target on the pty master with the same fragmentation
+# classes (lib/logserver.c implements the target side of the protocol).
+# Target writes are paced at --baud to model the UART.
+#
+#   target -> host: n frames of FRAG_SIZE bytes vs one fragmented message of
+#                   the same total size, for each sender window
+#   host -> target: a client sends the message to the port's TCP socket and
+#                   the LogServer fragments it to the target
+
+import argparse
+import os
+import threading
+import time
+
+import cobs
+from logbenchutil import PtyServer, connect, recv_frame
+from uclog import (
+    FRAG_SIZE,
+    LOG_MAX_MESSAGE_SIZE,
+    CobsDecode,
+    CobsEncode,
+    EventLoop,
+    FragMux,
+    FragReceiver,
+    FragSender,
+    MuxDecode,
+    MuxEncode,
+    chain,
+)
+
+PORT = 0
+
+
+class Uart(object):
+    """
+    Blocking writes to the pty master at (roughly) baud / 10 bytes/s
+    """
+
+    def __init__(self, fd, baud):
+        self.fd = fd
+        self.baud = baud
+        self.busy_until = time.time()
+
+    def __call__(self, data):
+        if self.baud:
+            now = time.time()
+            self.busy_until = max(self.busy_until, now) + len(data) * 10 / self.baud
+            if self.busy_until > now:
+                time.sleep(self.busy_until - now)
+        while data:
+            n = os.write(self.fd, data)
+            data = data[n:]
+
+
+class Target(object):
+    def __init__(self, master, baud, window):
+        self.loop = EventLoop()
+        self.uart = Uart(master, baud)
+        self.tx = chain([CobsEncode(), self.uart])
+        self.sender = FragSender(self.loop, PORT, window=window)
+        self.sender.on_data = self.tx
+        self.receiver = FragReceiver(PORT, self.tx, window=window)
+        self.received = threading.Event()
+        self.receiver.on_data = lambda msg: self.received.set()
+        rx = {"frag": FragMux({PORT: self.receiver}, {PORT: self.sender})}
+        self.rx = chain([CobsDecode(LOG_MAX_MESSAGE_SIZE), MuxDecode(rx)])
+        self.loop.register(master, 1, self._ready)
+        self.loop.start()
+
+    def _ready(self, fd, mask):
+        self.rx(os.read(fd, 65536))
+
+    def shutdown(self):
+        self.loop.shutdown()
+
+
+def recv_frames(sock, n, size):
+    """
+    Wait for n COBS frames (with size bytes in total) on a subscriber socket
+    """
+    buf = [b""]
+    sock.settimeout(30)
+    total = sum(len(recv_frame(sock, buf)) for _ in range(n))
+    if total != size:
+        raise RuntimeError(f"received {total} bytes, expected {size}")
+
+
+def mbps(size, elapsed):
+    return size * 8 / elapsed / 1e6
+
+
+def bench(n, baud, windows, hostport):
+    srv = PtyServer(hostport)
+    master = srv.master
+
+    host, port = hostport
+    sub = connect((host, port + PORT + 1))
+    time.sleep(0.5)
+
+    size = n * FRAG_SIZE
+    msg = bytes(range(1, 256)) * (size // 255 + 1)
+    msg = msg[:size]
+    print(f"{size} bytes ({n} x {FRAG_SIZE}), target uart {baud or 'unlimited'} baud")
+
+    # Single frames - no acknowledgement so the best case for the link
+    t = Target(master, baud, 1)
+    enc = chain([MuxEncode(PORT), t.tx])
+    start = time.time()
+    for i in range(n):
+        enc(msg[i * FRAG_SIZE : (i + 1) * FRAG_SIZE])
+    recv_frames(sub, n, size)
+    elapsed = time.time() - start
+    print(f"  target -> host single frames:      {mbps(size, elapsed):7.2f} Mbit/s")
+    t.shutdown()
+
+    for w in windows:
+        t = Target(master, baud, w)
+        start = time.time()
+        t.loop.call_soon(t.sender, msg)
+        recv_frames(sub, 1, size)
+        elapsed = time.time() - start
+        rate = mbps(size, elapsed)
+        print(f"  target -> host fragments window {w}: {rate:7.2f} Mbit/s")
+        t.shutdown()
+
+    for w in windows:
+        t = Target(master, baud, w)
+        start = time.time()
+        sub.sendall(b"\x00" + cobs.enc(msg) + b"\x00")
+        if not t.received.wait(30):
+            raise RuntimeError("target didn't receive message")
+        elapsed = time.time() - start
+        if t.receiver.data != msg:
+            raise RuntimeError("target received corrupt message")
+        rate = mbps(size, elapsed)
+        print(f"  host -> target fragments window {w}: {rate:7.2f} Mbit/s")
+        t.shutdown()
+
+    srv.shutdown()
+    sub.close()
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser("LogServer fragmentation benchmark")
+    parser.add_argument("-n", type=int, default=200, help="fragments per message")
+    parser.add_argument("--baud", type=int, default=1000000, help="0 for unlimited")
+    parser.add_argument("--windows", default="1,2,4,8")
+    parser.add_argument("--port", type=int, default=9200, help="base TCP port")
+    args = parser.parse_args()
+    windows = [int(w) for w in args.windows.split(",")]
+    bench(args.n, args.baud, windows, ("localhost", args.port))
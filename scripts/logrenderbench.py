@@ -0,0 +1,184 @@
+#! /usr/bin/env python3
+
+# © 2025 Unit Circle Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# LogServer log port CPU per record with eager and lazy (LogRecord) text
+# rendering, for --clients subscribers of which 0..100% take the binary
+# format.  Eager is the original path: every record decoded to text and
+# sent as text.  The records are synthetic messages from a few call sites;
+# each binary record must decode back to the text record.
+#
+# Then --subscribers text clients that each want one call site (half of
+# them also only with its first argument below 2^15) with server side
+# filters (LogFilter), against the same clients taking the whole stream -
+# server CPU, and client CPU just to read what they are sent.
+
+import argparse
+import random
+import struct
+import time
+
+import cbor2
+
+import cobs
+from logdata import LogData, LogTables, parse_prefix
+from uclog import LOG_TYPE_BASIC, LogFilter, LogPortServer
+
+FMTS = [
+    ("1:adc.c:42:adc ch %d raw %u mv %d", "<iIi"),
+    ("2:motor.c:107:motor %u rpm %d target %d duty %u", "<IiiI"),
+    ("0:net.c:311:rx len %u seq %x", "<II"),
+    ("1:main.c:88:tick %u", "<I"),
+]
+
+
+class Client(object):
+    def __init__(self, binary, filter=None):
+        self.binary = binary
+        self.filter = LogFilter(filter) if filter else None
+        self.data = []
+
+    def send(self, data):
+        self.data.append(data)
+
+
+def make_decoder():
+    fmts = {0x1000 + 16 * i: parse_prefix(f) for i, (f, _) in enumerate(FMTS)}
+    d = LogData.__new__(LogData)
+    d.tables = LogTables({}, {}, {}, {}, 0x1000, fmts, {})
+    d.count = 0
+    d.start_time = 0
+    return d
+
+
+def make_items(n):
+    rnd = random.Random(1)
+    items = []
+    for _ in range(n):
+        i = rnd.randrange(len(FMTS))
+        pack = FMTS[i][1]
+        args = [rnd.randrange(1 << 16) for _ in range(len(pack) - 1)]
+        items.append((0, (0x1000 + 16 * i) | LOG_TYPE_BASIC, struct.pack(pack, *args)))
+    return items
+
+
+def port(clients):
+    p = LogPortServer.__new__(LogPortServer)
+    p.clients = set(clients)
+    p.last_hash = None
+    p.routes = {}
+    return p
+
+
+def run(items, clients, lazy):
+    d = make_decoder()
+    p = port(clients)
+    start = time.perf_counter()
+    if lazy:
+        for item in items:
+            p(d.lazy(item, 0.0))
+    else:
+        for item in items:
+            data = p._encode(d.decode(item, 0.0))
+            for c in clients:
+                c.send(data)
+    return (time.perf_counter() - start) / len(items)
+
+
+def check(items, clients):
+    # Each binary record decodes to the text record sent with it
+    d = make_decoder()
+    text = [c for c in clients if not c.binary]
+    binary = [c for c in clients if c.binary]
+    if not text or not binary:
+        return True
+    for t, b in zip(text[0].data, binary[0].data):
+        t = cbor2.loads(cobs.dec(t[1:-1]))
+        n, ts, *item = cbor2.loads(cobs.dec(b[1:-1]))
+        if d.decode(tuple(item), ts)[1:] != tuple(t)[1:]:
+            return False
+    return True
+
+
+def subscribers(n, filtered):
+    clients = []
+    for i in range(n):
+        f, _ = FMTS[i % len(FMTS)]
+        spec = {"callsites": [":".join(f.split(":")[1:3])]}
+        if i % 2:
+            spec["args"] = [["arg0", "<", 1 << 15]]
+        clients.append(Client(False, spec if filtered else None))
+    return clients
+
+
+def timed_decode(clients):
+    # What the clients spend just reading what they are sent
+    start = time.perf_counter()
+    for c in clients:
+        for d in c.data:
+            cbor2.loads(cobs.dec(d[1:-1]))
+    return time.perf_counter() - start
+
+
+def expected(items, spec):
+    # Records a subscriber should get, filtered here from the text
+    f, _ = FMTS[[":".join(f.split(":")[1:3]) for f, _ in FMTS].index(spec[0])]
+    n = 0
+    for _, addr, frame in items:
+        if FMTS[(addr - 0x1000) >> 4][0] == f:
+            n += len(spec) == 1 or struct.unpack_from("<i", frame)[0] < spec[1]
+    return n
+
+
+def main():
+    parser = argparse.ArgumentParser("Log port rendering benchmark")
+    parser.add_argument("-n", type=int, default=50000, help="records")
+    parser.add_argument("--clients", type=int, default=4)
+    parser.add_argument("--subscribers", type=int, default=16)
+    args = parser.parse_args()
+
+    items = make_items(args.n)
+    ok = True
+    print(f"{args.n} records, {args.clients} clients")
+    print(f"{'binary':>7} {'eager us':>9} {'lazy us':>9} {'saved':>6}")
+    for nb in range(args.clients + 1):
+        clients = [Client(i < nb) for i in range(args.clients)]
+        te = min(run(items, [Client(False) for _ in clients], False) for _ in range(3))
+        tl = min(run(items, clients, True) for _ in range(3))
+        ok = ok and check(items, clients)
+        pct = 100 * nb // args.clients
+        print(f"{pct:6}% {te * 1e6:9.2f} {tl * 1e6:9.2f} {1 - tl / te:6.0%}")
+
+    print(f"{args.subscribers} subscribers to one call site each")
+    for filtered in (False, True):
+        clients = subscribers(args.subscribers, filtered)
+        t = run(items, clients, True)
+        sent = sum(len(c.data) for c in clients)
+        nbytes = sum(len(d) for c in clients for d in c.data)
+        tc = timed_decode(clients) / len(items)
+        name = "filtered" if filtered else "broadcast"
+        print(
+            f"  {name:9} server {t * 1e6:6.2f} us  clients {tc * 1e6:6.2f} us"
+            f"  per record, {sent} records {nbytes} bytes sent"
+        )
+    for c in clients:
+        spec = [c.filter.callsites.copy().pop()] + [a[2] for a in c.filter.args]
+        ok = ok and len(c.data) == expected(items, spec)
+    print("ok" if ok else "MISMATCH")
+    exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,245 @@
+#! /usr/bin/env python3
+
+# © 2025 Unit Circle Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# RPC round trip latency with the target UART idle and full of log output.
+#
+# Against a target built with CONFIG_APP_RPC_ECHO=y (e.g. native_sim, whose
+# UART is a pty):
+#
+#   uclog.py -s --target /dev/pts/N
+#   logrpcbench.py --port 3 --load 20000
+#
+# --load is the LOG_INF() rate asked of the target - enough to keep the
+# UART busy at its baud rate.
+#
+# With --sim a LogServer is run on a pty and this process plays the target:
+# a UART paced at --baud sending frames from the same TX rings as lib/log.c
+# (urgent, port and bulk log, shared as in include/ucuart_txq.h), with the
+# bulk ring kept full while loaded.  --fifo puts the replies in the bulk
+# ring instead, as before the rings were split.
+
+import argparse
+import collections
+import os
+import struct
+import threading
+import time
+
+import cobs
+from logbenchutil import PtyServer, connect, recv_frame
+from uclog import (
+    LOG_DEFAULT_BASE,
+    CobsDecode,
+    CobsEncode,
+    EventLoop,
+    MuxDecode,
+    MuxEncode,
+    chain,
+)
+
+LOAD_PORT = 7  # --sim log load is sent as frames for this (unused) port
+LOAD_SIZE = 40
+
+
+class TxQueue(object):
+    """
+    Frame at a time model of include/ucuart_txq.h - rings with a quantum of
+    0 have strict priority, the rest share by deficit round robin
+    """
+
+    def __init__(self, quanta):
+        self.quanta = quanta
+        self.rings = [collections.deque() for _ in quanta]
+        self.size = [0] * len(quanta)
+        self.deficit = [0] * len(quanta)
+        self.rr = 0
+
+    def put(self, i, frame):
+        self.rings[i].append(frame)
+        self.size[i] += len(frame)
+
+    def _pop(self, i):
+        frame = self.rings[i].popleft()
+        self.size[i] -= len(frame)
+        return frame
+
+    def get(self):
+        n = len(self.quanta)
+        for i in range(n):
+            if self.quanta[i] == 0 and self.rings[i]:
+                return self._pop(i)
+        for _ in range(2 * n):
+            i = self.rr
+            if self.quanta[i] != 0 and self.rings[i]:
+                if self.deficit[i] <= 0:
+                    self.deficit[i] += self.quanta[i]
+                if self.deficit[i] > 0:
+                    frame = self._pop(i)
+                    self.deficit[i] -= len(frame)
+                    if self.deficit[i] <= 0:
+                        self.rr = (i + 1) % n
+                    return frame
+            else:
+                self.deficit[i] = 0
+            self.rr = (i + 1) % n
+        return None
+
+
+class SimTarget(object):
+    def __init__(self, master, port, baud, quanta, ring, fifo):
+        self.fd = master
+        self.port = port
+        self.baud = baud
+        self.ring = ring
+        self.reply_ring = len(quanta) - 1 if fifo else 1
+        self.q = TxQueue(quanta)
+        self.lock = threading.Condition()
+        self.loaded = False
+        self.running = True
+        self.frames = []
+        self.load = chain([MuxEncode(LOAD_PORT), CobsEncode(), self.frames.append])
+        self.reply = chain([MuxEncode(port), CobsEncode(), self.frames.append])
+        self.rx = chain([CobsDecode(), MuxDecode({port: self._rpc})])
+        self.loop = EventLoop()
+        self.loop.register(master, 1, self._ready)
+        self.loop.start()
+        self.uart = threading.Thread(target=self._uart, daemon=True)
+        self.uart.start()
+
+    def _ready(self, fd, mask):
+        self.rx(os.read(fd, 65536))
+
+    def _rpc(self, msg):
+        if len(msg) == 5 and msg[:1] == b"L":
+            self.loaded = struct.unpack("<I", msg[1:])[0] != 0
+        with self.lock:
+            self.reply(msg)
+            self.q.put(self.reply_ring, self.frames.pop())
+            self.lock.notify()
+
+    def _fill(self):
+        # Bulk log ring kept full, like a target logging faster than the UART
+        bulk = len(self.q.quanta) - 1
+        while self.q.size[bulk] + LOAD_SIZE + 2 <= self.ring:
+            self.load(bytes(LOAD_SIZE))
+            self.q.put(bulk, self.frames.pop())
+
+    def _uart(self):
+        busy_until = time.time()
+        while self.running:
+            with self.lock:
+                if self.loaded:
+                    self._fill()
+                frame = self.q.get()
+                if frame is None:
+                    self.lock.wait(0.01)
+                    continue
+            now = time.time()
+            busy_until = max(busy_until, now) + len(frame) * 10 / self.baud
+            if busy_until > now:
+                time.sleep(busy_until - now)
+            while frame:
+                n = os.write(self.fd, frame)
+                frame = frame[n:]
+
+    def shutdown(self):
+        self.running = False
+        self.uart.join()
+        self.loop.shutdown()
+
+
+def rpc(sock, buf, msg):
+    sock.sendall(b"\x00" + cobs.enc(msg) + b"\x00")
+    while True:
+        reply = recv_frame(sock, buf)
+        # Anything else is a stale reply
+        if reply == msg:
+            return
+
+
+def set_load(sock, buf, rate):
+    rpc(sock, buf, b"L" + struct.pack("<I", rate))
+
+
+def measure(sock, buf, n, size):
+    rtt = []
+    for i in range(n):
+        msg = b"P" + struct.pack("<I", i) + bytes(size)
+        start = time.time()
+        rpc(sock, buf, msg)
+        rtt.append((time.time() - start) * 1000)
+    rtt.sort()
+    return rtt
+
+
+def report(name, rtt):
+    avg = sum(rtt) / len(rtt)
+    p50 = rtt[len(rtt) // 2]
+    p99 = rtt[min(len(rtt) - 1, len(rtt) * 99 // 100)]
+    print(
+        f"  {name:7} min {rtt[0]:7.2f} avg {avg:7.2f} p50 {p50:7.2f} "
+        f"p99 {p99:7.2f} max {rtt[-1]:7.2f} ms"
+    )
+
+
+def main():
+    parser = argparse.ArgumentParser("RPC round trip latency under log load")
+    parser.add_argument("--host", default="localhost")
+    parser.add_argument("--base", type=int, default=LOG_DEFAULT_BASE)
+    parser.add_argument("--port", type=int, default=3, help="log server port")
+    parser.add_argument("-n", type=int, default=100, help="calls per measurement")
+    parser.add_argument("--size", type=int, default=32, help="call payload bytes")
+    parser.add_argument("--load", type=int, default=20000, help="log messages/s")
+    parser.add_argument("--settle", type=float, default=0.5, help="s to fill the log")
+    parser.add_argument("--sim", action="store_true", help="simulate the target")
+    parser.add_argument("--baud", type=int, default=1000000, help="(--sim)")
+    parser.add_argument("--share", type=int, default=50, help="port %% (--sim)")
+    parser.add_argument("--quantum", type=int, default=512, help="bytes (--sim)")
+    parser.add_argument("--ring", type=int, default=8192, help="log ring (--sim)")
+    parser.add_argument("--fifo", action="store_true", help="one ring (--sim)")
+    args = parser.parse_args()
+
+    target = None
+    if args.sim:
+        srv = PtyServer((args.host, args.base))
+        quanta = [
+            0,
+            args.quantum * args.share // 100,
+            args.quantum * (100 - args.share) // 100,
+        ]
+        target = SimTarget(
+            srv.master, args.port, args.baud, quanta, args.ring, args.fifo
+        )
+
+    sock = connect((args.host, args.base + args.port + 1))
+    sock.settimeout(10)
+    buf = [b""]
+    try:
+        set_load(sock, buf, 0)
+        report("idle", measure(sock, buf, args.n, args.size))
+        set_load(sock, buf, args.load)
+        time.sleep(args.settle)
+        report("loaded", measure(sock, buf, args.n, args.size))
+        set_load(sock, buf, 0)
+    finally:
+        sock.close()
+        if target:
+            target.shutdown()
+            srv.shutdown()
+
+
+if __name__ == "__main__":
+    main()
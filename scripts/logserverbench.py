@@ -0,0 +1,174 @@
+#! /usr/bin/env python3
+
+# © 2025 Unit Circle Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Measure LogServer fan-out latency and CPU with many subscribers.
+#
+# A LogServer is run in a child process on the slave side of a pty.  This
+# process plays the target: it writes timestamped port frames to the pty
+# master and has N subscribers connected to the port's TCP socket.  Latency
+# is from the write to the pty until each subscriber has received the frame.
+#
+# First, two clients of the port send frames interleaved mid-frame, and both
+# must reach the target intact.
+
+import argparse
+import os
+import selectors
+import struct
+import time
+
+import cobs
+from logbenchutil import PtyServer, connect
+from uclog import LOG_TYPE_PORT
+
+PORT = 0
+
+
+def interleaved(hostport):
+    """
+    Client A sends the start of a frame, client B a whole frame, then A the
+    rest of its frame.  Returns True if the target got both frames.
+    """
+    srv = PtyServer(hostport)
+    master = srv.master
+    host, port = hostport
+    a, b = (connect((host, port + PORT + 1)) for _ in range(2))
+    msg_a = bytes(range(1, 41))
+    msg_b = bytes(range(101, 141))
+    enc_a = b"\x00" + cobs.enc(msg_a) + b"\x00"
+    try:
+        a.sendall(enc_a[:20])
+        time.sleep(0.1)
+        b.sendall(b"\x00" + cobs.enc(msg_b) + b"\x00")
+        time.sleep(0.1)
+        a.sendall(enc_a[20:])
+        os.set_blocking(master, False)
+        got = set()
+        buf = b""
+        deadline = time.time() + 2
+        while len(got) < 2 and time.time() < deadline:
+            try:
+                buf += os.read(master, 4096)
+            except BlockingIOError:
+                time.sleep(0.01)
+                continue
+            frames = buf.split(b"\x00")
+            buf = frames.pop()
+            for f in frames:
+                if len(f) == 0:
+                    continue
+                f = cobs.dec(f)
+                if f[0] == (PORT << 2) | LOG_TYPE_PORT:
+                    got.add(f[1:])
+    finally:
+        a.close()
+        b.close()
+        srv.shutdown()
+    ok = got == {msg_a, msg_b}
+    print(f"interleaved clients: {'ok' if ok else 'FAILED'}")
+    return ok
+
+
+def bench(subscribers, n, rate, size, hostport):
+    srv = PtyServer(hostport)
+    master = srv.master
+
+    host, port = hostport
+    socks = [connect((host, port + PORT + 1)) for _ in range(subscribers)]
+    sel = selectors.DefaultSelector()
+    for s in socks:
+        s.setblocking(False)
+        sel.register(s, selectors.EVENT_READ, [b""])
+
+    # Drain pulses the server sends to the "target"
+    os.set_blocking(master, False)
+    # Let the server accept every subscriber before starting
+    time.sleep(0.5)
+
+    pad = bytes(range(1, 256)) * (size // 255 + 1)
+    lat = []
+    received = 0
+    next_send = time.time()
+    sent = 0
+    deadline = None
+    start = time.time()
+    while received < n * subscribers:
+        now = time.time()
+        if sent < n and now >= next_send:
+            payload = struct.pack("<Id", sent, time.time()) + pad[: max(0, size - 12)]
+            frame = bytes(((PORT << 2) | LOG_TYPE_PORT,)) + payload
+            try:
+                os.write(master, b"\x00" + cobs.enc(frame) + b"\x00")
+            except BlockingIOError:
+                # pty is full - the server has fallen behind the target
+                sel.select(0.001)
+                continue
+            sent += 1
+            next_send += 1 / rate
+            if sent == n:
+                deadline = now + 5
+        if deadline and now > deadline:
+            break
+        try:
+            os.read(master, 4096)
+        except BlockingIOError:
+            pass
+        for key, _ in sel.select(max(0, min(next_send - time.time(), 0.01))):
+            data = key.fileobj.recv(65536)
+            t = time.time()
+            buf = key.data[0] + data
+            frames = buf.split(b"\x00")
+            key.data[0] = frames.pop()
+            for f in frames:
+                if len(f) == 0:
+                    continue
+                _, ts = struct.unpack("<Id", cobs.dec(f)[:12])
+                lat.append(t - ts)
+                received += 1
+    elapsed = time.time() - start
+
+    cpu, _ = srv.shutdown()
+    for s in socks:
+        s.close()
+
+    lat.sort()
+
+    def pct(q):
+        return lat[min(len(lat) - 1, int(q * len(lat)))] * 1e3 if lat else float("nan")
+
+    print(
+        f"{subscribers} subscribers, {n} frames of {size} bytes at {rate}/s "
+        f"in {elapsed:.1f} s"
+    )
+    print(f"  delivered {received} of {n * subscribers}")
+    print(
+        f"  latency ms: p50 {pct(0.5):.2f} p90 {pct(0.9):.2f} "
+        f"p99 {pct(0.99):.2f} max {pct(1.0):.2f}"
+    )
+    print(f"  server cpu: {cpu:.2f} s ({100 * cpu / elapsed:.0f}%)")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser("LogServer fan-out benchmark")
+    parser.add_argument("-n", type=int, default=2000, help="frames to send")
+    parser.add_argument("--subscribers", type=int, default=50)
+    parser.add_argument("--rate", type=float, default=500, help="frames/s")
+    parser.add_argument("--size", type=int, default=64, help="payload bytes")
+    parser.add_argument("--port", type=int, default=9100, help="base TCP port")
+    args = parser.parse_args()
+    if not interleaved(("localhost", args.port)):
+        exit(1)
+    bench(args.subscribers, args.n, args.rate, args.size, ("localhost", args.port))
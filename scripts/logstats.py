@@ -0,0 +1,399 @@
+# © 2025 Unit Circle Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Per call site statistics of the decoded log stream - how often each LOG
+# fires, its recent rate and the distribution of each numeric argument -
+# without formatting any text.  Used by uclog.py (LogServer stats port,
+# --stats-file, --replay --stats).
+#
+# A snapshot is a map that CBOR encodes and JSON dumps as is:
+#
+#   {"ts": seconds, "unknown": records from unknown call sites,
+#    "callsites": [{"id", "level", "file", "line", "fmt", "count",
+#                   "first", "last", "rate": {"1s", "10s", "60s"},
+#                   "args": {name: {"count", "min", "max", "mean",
+#                                   "p50", "p90", "p99", ...}}}, ...]}
+#
+# Call sites are keyed by their stable ID (see callsite_id()), so their
+# counts carry on across an image reload that doesn't change them.  Enums
+# and symbols are counted as their raw numbers, and string and memory
+# arguments are not summarised.
+
+import math
+import struct
+from collections import Counter
+
+from logdata import (
+    LOG_TYPE_BASIC,
+    LogRecord,
+    field_names,
+    level2str,
+    parse_double,
+    parse_int32,
+    parse_int64,
+    parse_uint32,
+    parse_uint64,
+    raw_parser,
+)
+
+RATE_WINDOWS = (1, 10, 60)
+QUANTILES = (0.5, 0.9, 0.99)
+# Arguments with these raw parsers are summarised, and their struct formats
+NUMERIC = {
+    parse_int32: "i",
+    parse_uint32: "I",
+    parse_int64: "q",
+    parse_uint64: "Q",
+    parse_double: "d",
+}
+# Argument values summarised at once
+ARG_BATCH = 1024
+
+
+class QuantileSketch(object):
+    """
+    Streaming quantiles of a value, to within relative error alpha, in
+    bounded memory: values are counted in buckets whose bounds grow
+    geometrically (as DDSketch).  Past max_buckets per sign the buckets of
+    the values nearest zero are merged, so only those lose accuracy.
+
+    Until there are more than max_exact different values they are counted
+    as they are, so the quantiles of e.g. a channel number or a state are
+    exact.  Values are added in batches (add_many()), counted with Counter
+    rather than one at a time.
+    """
+
+    def __init__(self, alpha=0.01, max_buckets=2048, max_exact=64):
+        self.gamma = (1 + alpha) / (1 - alpha)
+        self.inv_log_gamma = 1 / math.log(self.gamma)
+        self.max_buckets = max_buckets
+        self.max_exact = max_exact
+        self.exact = {}
+        self.pos = {}
+        self.neg = {}
+        self.zeros = 0
+        self.count = 0
+
+    def add(self, v):
+        self.add_many((v,))
+
+    def add_many(self, values):
+        # values are finite numbers (see ArgStats.fold())
+        exact = self.exact
+        if exact is not None:
+            for v, n in Counter(values).items():
+                exact[v] = exact.get(v, 0) + n
+            if len(exact) <= self.max_exact:
+                return
+            self.exact = None
+            values = list(Counter(exact).elements())
+        self.count += len(values)
+        pos = [v for v in values if v > 0]
+        neg = [-v for v in values if v < 0]
+        self.zeros += len(values) - len(pos) - len(neg)
+        for store, vs in ((self.pos, pos), (self.neg, neg)):
+            if not vs:
+                continue
+            keys = map(math.ceil, map(self.inv_log_gamma.__mul__, map(math.log, vs)))
+            for k, n in Counter(keys).items():
+                store[k] = store.get(k, 0) + n
+            if len(store) > self.max_buckets:
+                self._collapse(store)
+
+    def _collapse(self, store):
+        keys = sorted(store)
+        n = sum(store.pop(k) for k in keys[: len(keys) - self.max_buckets + 1])
+        lowest = keys[len(keys) - self.max_buckets + 1]
+        store[lowest] += n
+
+    def _value(self, k):
+        return 2 * self.gamma**k / (self.gamma + 1)
+
+    def quantile(self, q):
+        """
+        The value at quantile q (0..1) by nearest rank, None if there are no
+        values
+        """
+        if self.exact is not None:
+            rank = max(1, math.ceil(q * sum(self.exact.values())))
+            n = 0
+            for v in sorted(self.exact):
+                n += self.exact[v]
+                if n >= rank:
+                    return v
+            return None
+        rank = max(1, math.ceil(q * self.count))
+        n = 0
+        for k in sorted(self.neg, reverse=True):
+            n += self.neg[k]
+            if n >= rank:
+                return -self._value(k)
+        n += self.zeros
+        if n >= rank:
+            return 0
+        for k in sorted(self.pos):
+            n += self.pos[k]
+            if n >= rank:
+                return self._value(k)
+        return self._value(max(self.pos))
+
+
+class WindowRate(object):
+    """
+    Events per second over the last few seconds, from counts per whole
+    second for the longest window
+    """
+
+    def __init__(self, window=max(RATE_WINDOWS)):
+        self.secs = [None] * window
+        self.counts = [0] * window
+
+    def add(self, t):
+        s = int(t)
+        i = s % len(self.secs)
+        if self.secs[i] != s:
+            self.secs[i] = s
+            self.counts[i] = 0
+        self.counts[i] += 1
+
+    def rate(self, now, window):
+        # Over the window seconds up to and including the current one
+        s = int(now)
+        n = sum(
+            c
+            for sec, c in zip(self.secs, self.counts)
+            if sec is not None and s - window < sec <= s
+        )
+        return n / window
+
+
+class ArgStats(object):
+    """
+    Summary of one argument.  Values are queued in pending and summarised
+    ARG_BATCH at a time (fold()).
+    """
+
+    __slots__ = ("count", "min", "max", "sum", "sketch", "pending")
+
+    def __init__(self):
+        self.count = 0
+        self.min = None
+        self.max = None
+        self.sum = 0
+        self.sketch = QuantileSketch()
+        self.pending = []
+
+    def fold(self):
+        # Only finite numbers - NaN and infinities would upset min/max and
+        # the sketch, and values of short records are "<missing ...>" text
+        values = [
+            v
+            for v in self.pending
+            if type(v) is int or (type(v) is float and math.isfinite(v))
+        ]
+        self.pending = []
+        if not values:
+            return
+        lo, hi = min(values), max(values)
+        if self.count == 0:
+            self.min, self.max = lo, hi
+        else:
+            self.min, self.max = min(self.min, lo), max(self.max, hi)
+        self.count += len(values)
+        self.sum += sum(values)
+        self.sketch.add_many(values)
+
+    def snapshot(self, quantiles):
+        self.fold()
+        s = {"count": self.count, "min": self.min, "max": self.max}
+        s["mean"] = self.sum / self.count if self.count else None
+        for q in quantiles:
+            v = self.sketch.quantile(q)
+            # Estimates never lie outside the values seen
+            if v is not None:
+                v = min(max(v, self.min), self.max)
+            s[f"p{q * 100:g}"] = v
+        return s
+
+
+class CallsiteStats(object):
+    """
+    Statistics of one call site.  numeric is the indices of its numeric
+    arguments if known from its format, otherwise they are found from the
+    values (typed records).  unpack is a Struct for the arguments if they
+    are all fixed size numbers.
+    """
+
+    def __init__(self, cid, level, fname, line, fmt, names, numeric=None, unpack=None):
+        self.id = cid
+        self.level = level
+        self.file = fname
+        self.line = line
+        self.fmt = fmt
+        self.names = names
+        self.unpack = unpack
+        self.count = 0
+        self.first = None
+        self.last = None
+        self.rate = WindowRate()
+        self.args = {}
+        self.numeric = None
+        self.pending = 0
+        if numeric is not None:
+            self.numeric = [(i, ArgStats()) for i in numeric]
+            self.args = {names[i]: a for i, a in self.numeric}
+
+    def add(self, t, vals):
+        self.count += 1
+        if self.first is None:
+            self.first = t
+        self.last = t
+        self.rate.add(t)
+        if not vals:
+            return
+        if self.numeric is not None:
+            for i, a in self.numeric:
+                a.pending.append(vals[i])
+        else:
+            for name, v in zip(self.names, vals):
+                # bool is an int too
+                if type(v) in (int, float):
+                    a = self.args.get(name)
+                    if a is None:
+                        a = self.args[name] = ArgStats()
+                    a.pending.append(v)
+        # At most one value per argument per record
+        self.pending += 1
+        if self.pending >= ARG_BATCH:
+            self.fold()
+
+    def fold(self):
+        self.pending = 0
+        for a in self.args.values():
+            a.fold()
+
+    def snapshot(self, now, quantiles):
+        return {
+            "id": self.id,
+            "level": self.level,
+            "file": self.file,
+            "line": self.line,
+            "fmt": self.fmt,
+            "count": self.count,
+            "first": self.first,
+            "last": self.last,
+            "rate": {f"{w}s": self.rate.rate(now, w) for w in RATE_WINDOWS},
+            "args": {n: a.snapshot(quantiles) for n, a in self.args.items()},
+        }
+
+
+class LogStats(object):
+    """
+    Statistics of the log records from LogDecode - LogRecords, read through
+    their call site and raw argument values only, or the typed records of
+    LogData.record().  Times are the record times, or clock() if given.
+    """
+
+    def __init__(self, clock=None):
+        self.clock = clock
+        self.callsites = {}
+        # tables -> {call site: CallsiteStats}, so a record from a known
+        # call site costs two dict lookups before its arguments
+        self.sites = {}
+        self.unknown = 0
+        self.ts = None
+
+    def __call__(self, record):
+        if isinstance(record, LogRecord):
+            tables, addr, kind, fmt = record.site()
+            sites = self.sites.get(tables)
+            if sites is None:
+                # Records only come from one image's tables at a time
+                self.sites = {}
+                sites = self.sites[tables] = {}
+            st = sites.get(addr)
+            if st is None:
+                if fmt is None or len(fmt) != 5:
+                    self.unknown += 1
+                    return
+                st = sites[addr] = self._callsite(
+                    tables.ids.get(addr), fmt, tables.keys.get(addr)
+                )
+            vals = None
+            if kind == LOG_TYPE_BASIC:
+                frame = record.item[2]
+                if st.unpack is not None and len(frame) == st.unpack.size:
+                    vals = st.unpack.unpack(frame)
+                else:
+                    r = record.values()
+                    vals = r[2] if r is not None else None
+            ts = record.ts
+        elif isinstance(record, dict) and "id" in record:
+            st = self.callsites.get(record["id"])
+            if st is None:
+                st = self.callsites[record["id"]] = CallsiteStats(
+                    record["id"],
+                    record["level"],
+                    record["file"],
+                    record["line"],
+                    None,
+                    list(record.get("fields", {})),
+                )
+            vals = list(record.get("fields", {}).values())
+            ts = record["ts"]
+        else:
+            self.unknown += 1
+            return
+        ts = self.clock() if self.clock else ts
+        self.ts = ts
+        st.add(ts, vals)
+
+    def _callsite(self, cid, fmt, keys):
+        level, fname, line, clean, parser = fmt
+        line = int(line) if line.isdigit() else line
+        # Tables without IDs (e.g. built by hand) - by where the call is
+        key = cid if cid is not None else f"{fname}:{line}"
+        st = self.callsites.get(key)
+        if st is None:
+            level = level2str.get(level, level).strip()
+            names = field_names(keys, len(parser))
+            raw = [raw_parser(p) for p in parser]
+            numeric = [i for i, p in enumerate(raw) if p in NUMERIC]
+            unpack = None
+            if len(numeric) == len(raw):
+                unpack = struct.Struct("<" + "".join(NUMERIC[p] for p in raw))
+            st = self.callsites[key] = CallsiteStats(
+                cid, level, fname, line, clean, names, numeric, unpack
+            )
+        return st
+
+    def snapshot(self, callsites=None, quantiles=QUANTILES):
+        """
+        The statistics (see above) of all call sites, or of those whose ID
+        or "file:line" is in callsites, most frequent first
+        """
+        now = self.clock() if self.clock else (self.ts or 0)
+        sites = [
+            st
+            for st in self.callsites.values()
+            if not callsites
+            or st.id in callsites
+            or f"{st.file}:{st.line}" in callsites
+        ]
+        sites.sort(key=lambda st: -st.count)
+        return {
+            "ts": now,
+            "unknown": self.unknown,
+            "callsites": [st.snapshot(now, quantiles) for st in sites],
+        }
@@ -0,0 +1,93 @@
+#! /usr/bin/env python3
+
+# © 2025 Unit Circle Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Call site statistics (logstats.py) throughput on the synthetic records of
+# logrenderbench.py, against decoding them to text, and the quantile sketch
+# error on uniform, normal and long tailed values.  Every sketch quantile
+# must be within the sketch's relative error of the exact one, and the
+# counts must add up.
+
+import argparse
+import math
+import random
+import time
+
+from logrenderbench import FMTS, make_decoder, make_items
+from logstats import LogStats, QuantileSketch
+
+QS = (0.01, 0.1, 0.5, 0.9, 0.99, 0.999)
+
+
+def timed(fn, items):
+    start = time.perf_counter()
+    for item in items:
+        fn(item)
+    return (time.perf_counter() - start) / len(items)
+
+
+def exact(values, q):
+    # The same rank as QuantileSketch.quantile()
+    return sorted(values)[max(0, math.ceil(q * len(values)) - 1)]
+
+
+def sketch_error(name, values, alpha):
+    s = QuantileSketch(alpha)
+    for v in values:
+        s.add(v)
+    worst = 0
+    for q in QS:
+        e = exact(values, q)
+        est = s.quantile(q)
+        err = abs(est - e) / abs(e) if e else abs(est)
+        worst = max(worst, err)
+    buckets = len(s.pos) + len(s.neg)
+    print(f"  {name:8} worst relative error {worst:.4f}  {buckets} buckets")
+    return worst <= alpha * 1.0001
+
+
+def main():
+    parser = argparse.ArgumentParser("Log statistics benchmark")
+    parser.add_argument("-n", type=int, default=200000, help="records")
+    parser.add_argument("--alpha", type=float, default=0.01)
+    args = parser.parse_args()
+
+    items = make_items(args.n)
+    d = make_decoder()
+    tt = timed(lambda item: tuple(d.lazy(item, 0.0)), items)
+    stats = LogStats()
+    ts = timed(lambda item: stats(d.lazy(item, 0.0)), items)
+    print(f"{args.n} records")
+    print(f"  decode to text {tt * 1e6:6.2f} us  {1 / tt:9.0f} records/s")
+    print(f"  statistics     {ts * 1e6:6.2f} us  {1 / ts:9.0f} records/s")
+    snapshot = stats.snapshot()
+    ok = sum(c["count"] for c in snapshot["callsites"]) == args.n
+    ok = ok and len(snapshot["callsites"]) == len(FMTS)
+
+    rnd = random.Random(1)
+    n = min(args.n, 100000)
+    print(f"sketch of {n} values, alpha {args.alpha}")
+    for name, fn in [
+        ("uniform", lambda: rnd.randrange(1 << 16)),
+        ("normal", lambda: rnd.gauss(0, 100)),
+        ("pareto", lambda: rnd.paretovariate(1.2)),
+    ]:
+        ok = sketch_error(name, [fn() for _ in range(n)], args.alpha) and ok
+    print("ok" if ok else "MISMATCH")
+    exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,176 @@
+#! /usr/bin/env python3
+
+# © 2025 Unit Circle Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Streamed reply test.
+#
+# A LogServer is run on a pty and this process plays a target streaming
+# replies (log_tx_begin() in include/log_cbor.h): each request on the port
+# is a 4 byte little endian size, answered with one unfragmented port frame
+# of that many random bytes, written to the pty --chunk bytes at a time.
+# Replies of up to --max bytes, most larger than LOG_MAX_PACKET_SIZE, must
+# come back intact with no link errors.
+#
+# Then, with --max-frame smaller than the largest reply, replies longer
+# than it must be dropped and counted as cobs_errors rather than passed on
+# cut short, and the reply after each must still get through.
+#
+# Last, replies over 64 KiB are sent with --capture on, and must come back
+# and be in the capture intact.
+
+import argparse
+import os
+import random
+import struct
+import tempfile
+import time
+
+import cobs
+from logbenchutil import PtyServer, connect, recv_frame
+from uclog import (
+    LOG_DEFAULT_BASE,
+    LOG_MAX_PACKET_SIZE,
+    CaptureReader,
+    CobsDecode,
+    CobsEncode,
+    CrcDecode,
+    CrcEncode,
+    EventLoop,
+    MuxDecode,
+    MuxEncode,
+    chain,
+)
+
+
+class StreamTarget(object):
+    def __init__(self, master, port, chunk, crc):
+        self.fd = master
+        self.chunk = chunk
+        self.rnd = random.Random(1)
+        self.reply = chain([MuxEncode(port), CrcEncode(crc), CobsEncode(), self._write])
+        self.rx = chain(
+            [CobsDecode(), CrcDecode(crc), MuxDecode({port: self._request})]
+        )
+        self.loop = EventLoop()
+        self.loop.register(master, 1, self._ready)
+        self.loop.start()
+
+    def _write(self, data):
+        # As the UART sends it, a block at a time while the reply is encoded
+        for i in range(0, len(data), self.chunk):
+            block = data[i : i + self.chunk]
+            while block:
+                n = os.write(self.fd, block)
+                block = block[n:]
+
+    def _ready(self, fd, mask):
+        self.rx(os.read(fd, 65536))
+
+    def _request(self, msg):
+        (size,) = struct.unpack("<I", msg)
+        self.reply(self.rnd.randbytes(size))
+
+    def shutdown(self):
+        self.loop.shutdown()
+
+
+def request(sock, buf, size):
+    sock.sendall(b"\x00" + cobs.enc(struct.pack("<I", size)) + b"\x00")
+    return recv_frame(sock, buf)
+
+
+def run(args, sizes, max_frame, capture=None):
+    """
+    Sends the sizes in turn and checks the replies.  Replies over max_frame
+    are followed by a small one that must be the next reply to arrive.
+    Returns the number of bad replies and the LogServer's metrics().
+    """
+    srv = PtyServer(
+        (args.host, args.base), crc=args.crc, max_frame=max_frame, capture=capture
+    )
+    target = StreamTarget(srv.master, args.port, args.chunk, args.crc)
+    sock = connect((args.host, args.base + args.port + 1))
+    sock.settimeout(10)
+    buf = [b""]
+    bad = 0
+    try:
+        for size in sizes:
+            if size > max_frame:
+                # Dropped - only the small reply after it comes back
+                sock.sendall(b"\x00" + cobs.enc(struct.pack("<I", size)) + b"\x00")
+                reply = request(sock, buf, 16)
+                if len(reply) != 16:
+                    print(f"  {size} byte reply passed on as {len(reply)} bytes")
+                    bad += 1
+            elif len(request(sock, buf, size)) != size:
+                print(f"  {size} byte reply cut short")
+                bad += 1
+    finally:
+        sock.close()
+        target.shutdown()
+        _, metrics = srv.shutdown()
+    return bad, metrics
+
+
+def main():
+    parser = argparse.ArgumentParser("Streamed reply test")
+    parser.add_argument("--host", default="localhost")
+    parser.add_argument("--base", type=int, default=LOG_DEFAULT_BASE)
+    parser.add_argument("--port", type=int, default=3, help="log server port")
+    parser.add_argument("-n", type=int, default=50, help="replies")
+    parser.add_argument("--max", type=int, default=8192, help="largest reply")
+    parser.add_argument("--chunk", type=int, default=256, help="bytes per write")
+    parser.add_argument("--crc", type=int, default=0, help="frame check bits")
+    args = parser.parse_args()
+
+    rnd = random.Random(2)
+    sizes = [rnd.randrange(LOG_MAX_PACKET_SIZE, args.max + 1) for _ in range(args.n)]
+
+    start = time.time()
+    bad, m = run(args, sizes, max(sizes))
+    print(
+        f"  {len(sizes) - bad} of {len(sizes)} replies intact in "
+        f"{time.time() - start:.2f} s"
+    )
+    print("  log server: " + ", ".join(f"{k} {v}" for k, v in m.items()))
+    ok = bad == 0 and m["cobs_errors"] == 0 and m["crc_errors"] == 0
+
+    # Replies just over max_frame may still fit its COBS overhead allowance
+    max_frame = (LOG_MAX_PACKET_SIZE + args.max) // 2
+    slack = max_frame // 254 + 64
+    sizes = [s for s in sizes if not max_frame < s <= max_frame + slack]
+    over = sum(1 for size in sizes if size > max_frame)
+    bad, m = run(args, sizes, max_frame)
+    print(
+        f"  --max-frame {max_frame}: {over} longer replies dropped, " f"{bad} passed on"
+    )
+    print("  log server: " + ", ".join(f"{k} {v}" for k, v in m.items()))
+    ok = ok and bad == 0 and m["cobs_errors"] == over and m["crc_errors"] == 0
+
+    sizes = [70000, 100000, 65536]
+    with tempfile.TemporaryDirectory() as tmp:
+        capture = os.path.join(tmp, "stream.cap")
+        bad, m = run(args, sizes, max(sizes), capture)
+        reader = CaptureReader(capture)
+        captured = [len(f) - 1 for _, _, _, f in reader.frames() if len(f) > 1]
+        reader.close()
+    print(f"  --capture: {len(sizes) - bad} of {len(sizes)} replies intact")
+    print(f"  captured replies: {captured}")
+    ok = ok and bad == 0 and captured == sizes
+    exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,229 @@
+#! /usr/bin/env python3
+
+# © 2025 Unit Circle Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Log compression (CONFIG_UC_LOG_COMPRESS) ratio on real or synthetic traffic.
+#
+#   logzipbench.py                     synthetic sensor/state machine traffic
+#   logzipbench.py capture.ucap ...    log frames from uclog.py -w captures
+#
+# The frames are run through a model of compress() in lib/log.c with the
+# given slots / max / key interval, and the result is checked to expand back
+# to the original frames with uclog.py's LogExpand.  Sizes are on the wire:
+# COBS framed with the optional frame check.
+#
+# The level isn't in a frame, so (unlike the target) ERROR messages in a
+# capture are compressed too.  Captures from targets built without
+# CONFIG_UC_LOG_COMPRESS have 4 byte aligned call sites - they are given
+# 16 byte aligned ones first.  With --callsite-ids the call sites are
+# numbered in order of first use and sent as varints, as
+# CONFIG_UC_LOG_CALLSITE_ID does, and the plain wire size with 4 byte call
+# sites is shown too.
+#
+# The target side cost is measured by CONFIG_APP_LOG_BENCH.
+
+import argparse
+import random
+import struct
+import time
+
+import cobs
+from uclog import (
+    LOG_DELTA,
+    LOG_KEYFRAME,
+    CaptureReader,
+    LogExpand,
+    callsite_len,
+    frame_crc,
+)
+
+
+class LogCompress(object):
+    """
+    Model of compress() in lib/log.c for log frames with 16 byte aligned
+    call sites, or varint call site indices with callsite_ids
+    """
+
+    def __init__(self, slots=32, max_args=32, key_interval=16, callsite_ids=False):
+        self.slots = [None] * slots  # [ptr, args, seq, run]
+        self.max_args = max_args
+        self.key_interval = key_interval
+        self.callsite_ids = callsite_ids
+
+    def __call__(self, frame, plain=False):
+        hn = callsite_len(frame, self.callsite_ids)
+        ptr, args = frame[:hn], frame[hn:]
+        if plain or len(args) > self.max_args:
+            return frame
+        if self.callsite_ids:
+            site = sum((b & 0x7F) << (7 * i) for i, b in enumerate(ptr)) >> 4
+        else:
+            site = struct.unpack("<I", ptr)[0] >> 4
+        slot = site % len(self.slots)
+        ref = self.slots[slot]
+        seq = ((ref[2] if ref else 0) + 1) & 0xF
+        run = ref[3] + 1 if ref else 0
+        d = None
+        if (
+            ref
+            and ref[0] == ptr
+            and len(ref[1]) == len(args)
+            and run < self.key_interval
+        ):
+            m = bytearray((len(args) + 7) // 8)
+            changed = bytearray()
+            for i, (a, b) in enumerate(zip(args, ref[1])):
+                if a != b:
+                    m[i >> 3] |= 1 << (i & 7)
+                    changed.append(a)
+            d = bytes((seq << 4 | LOG_DELTA, slot)) + bytes(m) + bytes(changed)
+            if len(d) >= len(frame) + 2:
+                d = None
+        if d is None:
+            run = 0
+            d = bytes((ptr[0] | LOG_KEYFRAME,)) + ptr[1:] + bytes((slot, seq)) + args
+        self.slots[slot] = [ptr, args, seq, run]
+        return d
+
+
+def with_callsite_ids(frames):
+    """
+    The log frames with call sites as varint indices, numbered in order of
+    first use (CONFIG_UC_LOG_CALLSITE_ID)
+    """
+    sites = {}
+    out = []
+    for f, plain in frames:
+        v = sites.setdefault(f[:4], len(sites)) << 4
+        site = bytearray()
+        while v >= 0x80:
+            site.append((v & 0x7F) | 0x80)
+            v >>= 7
+        site.append(v)
+        out.append((bytes(site) + f[4:], plain))
+    return out
+
+
+def wire_size(frames, crc):
+    return sum(len(cobs.enc(f + frame_crc(crc, f))) + 2 for f in frames)
+
+
+def synthetic(n):
+    """
+    The traffic of CONFIG_APP_LOG_BENCH, plus an occasional error
+    """
+    sites = [0x10000 + 0x40 * i for i in range(5)]
+
+    def msg(site, fmt, *args):
+        return struct.pack("<I", sites[site]) + struct.pack(fmt, *args)
+
+    frames = []
+    for i in range(n // 4):
+        frames.append((msg(0, "<"), False))
+        frames.append((msg(1, "<IIi", 1000 + i % 7, 2048, -5 + i % 3), False))
+        state = b"idle\0" if i % 50 else b"running\0"
+        frames.append((msg(2, f"<{len(state)}sI", state, i), False))
+        frames.append((msg(3, "<QI", i * 1000, i), False))
+        if i % 100 == 0:
+            frames.append((msg(4, "<I", i), True))
+    return frames
+
+
+def captured(fnames):
+    """
+    Log frames from captures, with call sites moved to 16 byte alignment
+    """
+    sites = {}
+    frames = []
+    for fname in fnames:
+        reader = CaptureReader(fname)
+        try:
+            for _, _, _, frame in reader.frames():
+                if len(frame) < 4 or (frame[0] & 3) != 0:
+                    continue
+                ptr = struct.unpack("<I", frame[:4])[0]
+                if ptr not in sites:
+                    sites[ptr] = 0x10000 + 0x10 * len(sites)
+                frames.append((struct.pack("<I", sites[ptr]) + frame[4:], False))
+        finally:
+            reader.close()
+    return frames
+
+
+def main():
+    parser = argparse.ArgumentParser("Log compression benchmark")
+    parser.add_argument("captures", nargs="*", help="uclog.py -w capture files")
+    parser.add_argument("-n", type=int, default=20000, help="synthetic messages")
+    parser.add_argument("--slots", type=int, default=32)
+    parser.add_argument("--max", type=int, default=32, help="largest args compressed")
+    parser.add_argument("--key-interval", type=int, default=16)
+    parser.add_argument("--crc", type=int, default=0, help="frame check bits")
+    parser.add_argument("--loss", type=float, default=0, help="percent of frames lost")
+    parser.add_argument(
+        "--callsite-ids", action="store_true", help="send call sites as indices"
+    )
+    args = parser.parse_args()
+
+    frames = captured(args.captures) if args.captures else synthetic(args.n)
+    if not frames:
+        print("no log frames")
+        return
+    if args.callsite_ids:
+        pointers = wire_size([f for f, _ in frames], args.crc)
+        frames = with_callsite_ids(frames)
+
+    compress = LogCompress(args.slots, args.max, args.key_interval, args.callsite_ids)
+    start = time.perf_counter()
+    packed = [compress(f, plain) for f, plain in frames]
+    elapsed = time.perf_counter() - start
+    plain = [f for f, _ in frames]
+    raw = sum(len(f) for f in plain)
+    keys = sum(1 for f in packed if f[0] & LOG_KEYFRAME)
+    deltas = sum(1 for f in packed if f[0] & LOG_DELTA)
+
+    before = wire_size(plain, args.crc)
+    after = wire_size(packed, args.crc)
+    print(
+        f"{len(frames)} messages {raw} bytes: {keys} keyframes {deltas} deltas "
+        f"{len(frames) - keys - deltas} plain"
+    )
+    if args.callsite_ids:
+        print(f"  4 byte call sites {pointers} bytes, indices {before} bytes")
+    print(f"  wire {before} -> {after} bytes, ratio {before / after:.2f}")
+    print(f"  compress model {elapsed * 1e9 / raw:.1f} ns/byte")
+
+    # Round trip, with --loss percent of the compressed frames dropped
+    rnd = random.Random(1)
+    expand = LogExpand(args.callsite_ids)
+    out = []
+    bad = 0
+    start = time.perf_counter()
+    for f, p in zip(packed, plain):
+        if rnd.random() * 100 < args.loss:
+            continue
+        expand.on_data = out.append
+        expand(f)
+        if out:
+            bad += out.pop() != p
+    elapsed = time.perf_counter() - start
+    print(
+        f"  expand {elapsed * 1e9 / raw:.1f} ns/byte, {expand.lost} dropped, "
+        f"{bad} wrong"
+    )
+    exit(1 if bad else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -25,6 +25,15 @@
 # ./sbl.py sign --key l2.2:2 --key l2.3:3 --key l2.5:5 --code app.bin --cert l2.cert app.signed.bin
 # ./sbl.py sign --key l2.1:1 --key l2.2:2 --key l2.5:5 --code app.hex --cert l2.cert app.signed.hex
 #
+# Several images can be signed with one key reconstruction, and the .hex and
+# .bin of an image share one hash:
+# ./sbl.py sign --key l2.1:1 --key l2.2:2 --key l2.5:5 --code app.hex --code app.bin --cert l2.cert app.signed.hex app.signed.bin
+#
+# Or the key is reconstructed once by a signing service, which sign hands its
+# images to (and signs locally if nothing is listening on the socket):
+# ./sbl.py serve --key l2.1:1 --key l2.2:2 --key l2.5:5 /tmp/sbl.sock &
+# ./sbl.py sign --socket /tmp/sbl.sock --code app.hex --code app.bin --cert l2.cert app.signed.hex app.signed.bin
+#
 # ./sbl.py verify --root root app.signed.bin
 # ./sbl.py verify --root root app.signed.hex
 #
@@ -34,11 +43,15 @@
 # arm-none-eabi-objcopy -O ihex --gap-fill 0x00 app.signed.elf app.signed2.hex
 
 import argparse
+import contextlib
+import io
+import json
 import os
+import socket
+import socketserver
 import sys
 import struct
 import getpass
-import hashlib
 import time
 from datetime import datetime as dt
 from datetime import timezone as tz
@@ -55,6 +68,7 @@ import zbase32
 import gf2
 import sss
 import ihex
+from hash import hash_data
 
 SIG_BLOCK_SIZE = 512
 SIG_SIZE = 64
@@ -63,6 +77,8 @@ MAX_WHAT_SIZE = 163  # Needs to match src-uc/signature.h APP_MAX_WHAT
 HASH_SIZE = 64
 PK_SIZE = 32
 SK_SIZE = 32
+# Largest gap between .hex segments filled (with 0x00) to sign them as one
+MAX_CODE_GAP = 64 * 1024
 
 CODE_TYPE_DEC = {b"\x00": "unknown/efi", b"\x01": "mfi", b"\x02": "afi"}
 CODE_TYPE_ENC = {" EFI\x00": b"\x00", " MFI\x00": b"\x01", " AFI\x00": b"\x02"}
@@ -465,14 +481,19 @@ def load_code(file):
         elif code_ext == ".hex":
             with open(file, "rt") as f:
                 ss, image = ihex.load(f)
-            if len(image) != 1:
-                print("error: hex file has gaps or is empty")
+            if len(image) == 0:
+                print("error: hex file is empty")
                 exit(1)
-            addr, code = image[0]
+            # Gaps are filled with 0x00, as objcopy -O binary does, so the
+            # .hex signs the same as the .bin
+            addr, code = ihex.flatten(image, fill=0x00, max_gap=MAX_CODE_GAP)
             return ss, addr, code
         else:
             print("error: only support .bin and .hex files for code")
             exit(1)
+    except ValueError as e:
+        print(f"error: {file}: {e}")
+        exit(1)
     except Exception:
         print(f"error: unable to load code from {file}")
         exit(1)
@@ -499,67 +520,219 @@ def save_code(file, ss, addr, code):
         exit(1)
 
 
-def split_code(code):
+def split_code(code, code_hash=None):
     # get hash and version info
     sig, code = code[:SIG_BLOCK_SIZE], code[SIG_BLOCK_SIZE:]
     code_what = what(code)
     if len(code_what) > MAX_WHAT_SIZE:
         print(f'error: code version string too long: "{code_what}"')
         exit(1)
-    sha512 = hashlib.sha512()
-    sha512.update(code)
-    code_hash = sha512.digest()
+    if code_hash is None:
+        code_hash = hash_data(code)
     code_n = len(code)
     return sig, code_hash, code_n, code_what, code
 
 
-def sign(args):
-    ss, addr, code = load_code(args.code)
-    _, code_hash, code_n, code_what, code = split_code(code)
-    cert = load_cert(args.cert)
-    sig_date = get_date(args.date)
-
-    if code_what[-5:] not in CODE_TYPE_ENC:
-        print("error: invalid code type")
+def load_signable(file, hashed):
+    # hashed holds the (code, hash) of the images already loaded in this
+    # batch by code length - the .hex of an image is the same code as its
+    # .bin, so its hash is reused rather than computed again.  What is
+    # signed is always hashed from the bytes loaded here, never from a
+    # cached digest that may not match them.
+    ss, addr, code = load_code(file)
+    code_hash = None
+    body = memoryview(code)[SIG_BLOCK_SIZE:]
+    for other, h in hashed.get(len(body), []):
+        if body == other:
+            code_hash = h
+            break
+    _, code_hash, code_n, code_what, code = split_code(code, code_hash)
+    hashed.setdefault(code_n, []).append((code, code_hash))
+    return ss, addr, code, code_hash, code_n, code_what
+
+
+def sign_batch(signing_key, jobs, cert, sig_date):
+    # Signs the [code file, output file] pairs in jobs with one signing key
+    cert = load_cert(cert)
+    verify_key = nacl.signing.VerifyKey(signing_key.verify_key.encode())
+    # The image only verifies if it is signed by the key the (first) cert
+    # is for - catches a signing service started with another key
+    cert_pk = cert[SIG_SIZE + 8 : SIG_SIZE + 8 + PK_SIZE]
+    if cert_pk != verify_key.encode():
+        print(
+            f"error: signing key {verify_key.encode().hex()} is not the cert's "
+            f"key {cert_pk.hex()}"
+        )
         exit(1)
-    code_type = CODE_TYPE_ENC[code_what[-5:]]
-
-    # Generate the data to be signed
-    sigdata = (
-        struct.pack("<IQ", code_n, sig_date)
-        + code_hash
-        + code_type
-        + code_what.encode("ascii")
-    )
-    pad = SIG_BLOCK_SIZE - len(sigdata) - len(cert) - SIG_SIZE
-    if pad < 0:
-        print("error: internal error")
+    hashed = {}
+    for code_file, out in jobs:
+        ss, addr, code, code_hash, code_n, code_what = load_signable(code_file, hashed)
+
+        if code_what[-5:] not in CODE_TYPE_ENC:
+            print("error: invalid code type")
+            exit(1)
+        code_type = CODE_TYPE_ENC[code_what[-5:]]
+
+        # Generate the data to be signed
+        sigdata = (
+            struct.pack("<IQ", code_n, sig_date)
+            + code_hash
+            + code_type
+            + code_what.encode("ascii")
+        )
+        pad = SIG_BLOCK_SIZE - len(sigdata) - len(cert) - SIG_SIZE
+        if pad < 0:
+            print("error: internal error")
+            exit(1)
+        sigdata = sigdata + b"\xff" * pad + cert
+        if len(sigdata) != SIG_BLOCK_SIZE - SIG_SIZE:
+            print("error: internal error")
+            exit(1)
+
+        # Sign
+        sig = signing_key.sign(sigdata).signature
+
+        try:
+            verify_key.verify(sigdata, sig)
+        except nacl.exceptions.BadSignatureError:
+            print("error: unable to validate code signature")
+            exit(1)
+
+        # Save output
+        if len(sig) + len(sigdata) != SIG_BLOCK_SIZE:
+            print("internal error")
+            exit(1)
+        save_code(out, ss, addr, sig + sigdata + code)
+
+
+def sign_remote(path, jobs, cert, sig_date):
+    # Has a signing service (see serve) sign the jobs.  Returns False if
+    # nothing is listening on path.
+    s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    try:
+        s.connect(path)
+    except OSError:
+        s.close()
+        return False
+    req = {"jobs": jobs, "cert": cert, "date": sig_date}
+    with s, s.makefile("rwb") as f:
+        f.write(json.dumps(req).encode("utf8") + b"\n")
+        f.flush()
+        try:
+            reply = json.loads(f.readline())
+        except ValueError:
+            print(f"error: no reply from signing service {path}")
+            exit(1)
+    print(reply["output"], end="")
+    if not reply["ok"]:
         exit(1)
-    sigdata = sigdata + b"\xff" * pad + cert
-    if len(sigdata) != SIG_BLOCK_SIZE - SIG_SIZE:
-        print("error: internal error")
+    return True
+
+
+def sign(args):
+    if len(args.code) != len(args.file):
+        print("error: need one output file per --code")
         exit(1)
+    # Paths are absolute for the signing service, which has its own cwd
+    jobs = [
+        [os.path.abspath(c), os.path.abspath(f)] for c, f in zip(args.code, args.file)
+    ]
+    cert = os.path.abspath(args.cert)
+    sig_date = get_date(args.date)
+
+    if args.socket:
+        if sign_remote(args.socket, jobs, cert, sig_date):
+            return
+        print(f"info: no signing service on {args.socket} - signing locally")
 
     # Load key
     splits = load_splits(args.key)
     signing_key = join_key(splits)
 
-    # Sign
-    sig = signing_key.sign(sigdata).signature
+    sign_batch(signing_key, jobs, cert, sig_date)
+
+
+class SignHandler(socketserver.StreamRequestHandler):
+    # One JSON request per line, {"jobs": [[code, out], ...], "cert": cert,
+    # "date": date}, answered by {"ok": bool, "output": messages}
+    def handle(self):
+        for line in self.rfile:
+            out = io.StringIO()
+            ok = False
+            with contextlib.redirect_stdout(out):
+                try:
+                    req = json.loads(line)
+                    sign_batch(
+                        self.server.signing_key, req["jobs"], req["cert"], req["date"]
+                    )
+                    ok = True
+                except SystemExit:
+                    # The usual "error: ..." has been printed
+                    pass
+                except Exception as e:
+                    print(f"error: bad signing request: {e!r}")
+            reply = {"ok": ok, "output": out.getvalue()}
+            self.wfile.write(json.dumps(reply).encode("utf8") + b"\n")
+            self.wfile.flush()
+
+
+class SignServer(socketserver.UnixStreamServer):
+    def __init__(self, path, signing_key, timeout):
+        self.signing_key = signing_key
+        self.timeout = timeout
+        self.idle = False
+        # Only the owner can connect, and only the owner's processes are
+        # served where the peer can be checked
+        umask = os.umask(0o077)
+        try:
+            super().__init__(path, SignHandler)
+        finally:
+            os.umask(umask)
+
+    def verify_request(self, request, client_address):
+        if not hasattr(socket, "SO_PEERCRED"):
+            return True
+        cred = request.getsockopt(
+            socket.SOL_SOCKET, socket.SO_PEERCRED, struct.calcsize("3i")
+        )
+        _, uid, _ = struct.unpack("3i", cred)
+        return uid == os.getuid()
+
+    def handle_timeout(self):
+        self.idle = True
 
+
+def serve(args):
+    # Check before the slow key reconstruction, and don't take over the
+    # socket of a running service
+    s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
     try:
-        pk = signing_key.verify_key.encode()
-        verify_key = nacl.signing.VerifyKey(pk)
-        verify_key.verify(sigdata, sig)
-    except nacl.exceptions.BadSignatureError:
-        print("error: unable to validate code signature")
+        s.connect(args.socket)
+        print(f"error: signing service already running on {args.socket}")
         exit(1)
+    except OSError:
+        pass
+    finally:
+        s.close()
+    if os.path.exists(args.socket):
+        os.unlink(args.socket)
 
-    # Save output
-    if len(sig) + len(sigdata) != SIG_BLOCK_SIZE:
-        print("internal error")
-        exit(1)
-    save_code(args.file, ss, addr, sig + sigdata + code)
+    # Load key
+    splits = load_splits(args.key)
+    signing_key = join_key(splits)
+
+    server = SignServer(args.socket, signing_key, args.timeout)
+    print(f"signing with {signing_key.verify_key.encode().hex()} on {args.socket}")
+    sys.stdout.flush()
+    try:
+        # Requests are handled one at a time
+        while not server.idle:
+            server.handle_request()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        server.server_close()
+        os.unlink(args.socket)
 
 
 def cert_present(cert):
@@ -880,13 +1053,39 @@ if __name__ == "__main__":
         help="key to use for signing certificate - should be repeated [K] times where [K] is the quarum of the key.",
     )
     sp.add_argument("-d", "--date", help="use [DATE] instead of current time")
-    sp.add_argument("--code", required=True, help="the binary file to sign")
+    sp.add_argument(
+        "--code",
+        action="append",
+        required=True,
+        help="the binary file to sign - may be repeated, with one [FILE] each",
+    )
     sp.add_argument(
         "--cert",
         required=True,
         help="the certificate chain for [KEY] to include in the signature",
     )
-    sp.add_argument("file", help="output signature to [FILE]")
+    sp.add_argument(
+        "--socket",
+        help="have the signing service on [SOCKET] sign, if one is running",
+    )
+    sp.add_argument("file", nargs="+", help="output signature to [FILE]")
+
+    sp = sub.add_parser(
+        "serve", help="reconstruct a key once and sign for sign --socket"
+    )
+    sp.add_argument(
+        "-k",
+        "--key",
+        action="append",
+        help="key to sign with - should be repeated [K] times where [K] is the quarum of the key.",
+    )
+    sp.add_argument(
+        "-t",
+        "--timeout",
+        type=float,
+        help="exit after [TIMEOUT] seconds without a request",
+    )
+    sp.add_argument("socket", help="unix socket to listen on")
 
     sp = sub.add_parser("verify", help="verify a signature in binary code image")
     sp.add_argument(
@@ -942,6 +1141,8 @@ if __name__ == "__main__":
         certsign(args)
     elif args.cmd == "sign":
         sign(args)
+    elif args.cmd == "serve":
+        serve(args)
     elif args.cmd == "verify":
         verify(args)
     elif args.cmd == "verifykey":
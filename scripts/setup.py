@@ -0,0 +1,26 @@
+# © 2025 Unit Circle Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Optional C extensions for the scripts - they fall back to pure Python:
+#
+#   python3 setup.py build_ext --inplace
+
+from setuptools import Extension, setup
+
+setup(
+    name="uclog-ext",
+    ext_modules=[
+        Extension("_cobs", ["_cobs.c"], extra_compile_args=["-O3"]),
+    ],
+)
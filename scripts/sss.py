@@ -14,7 +14,7 @@
 
 # See https://en.wikipedia.org/wiki/Shamir's_secret_sharing
 
-# Works with either fp.py (which is fast) or gf2.py (which is slower)
+# Works with either fp.py or gf2.py
 
 # NOTES:
 #
@@ -69,19 +69,28 @@ def evalpoly(x, p):
 
 
 def lp_i(x, xi, xv):
+    # Numerator and denominator of the i'th Lagrange basis polynomial at x
     num, den = x.field(1), x.field(1)
     for xj in xv:
         num = num * (x - xj)
         den = den * (xi - xj)
-    return num * den.inverse()
+    return num, den
 
 
 def lagrange(x, xy):
     xv, yv = zip(*xy)
-    e = [yv[i] * lp_i(x, xv[i], xv[:i] + xv[i + 1 :]) for i in range(len(xy))]
+    nd = [lp_i(x, xv[i], xv[:i] + xv[i + 1 :]) for i in range(len(xy))]
+    # Invert all the denominators with one inverse (Montgomery's trick) as
+    # an inverse costs as much as many multiplies
+    pre = [x.field(1)]
+    for _, den in nd:
+        pre.append(pre[-1] * den)
+    inv = pre[-1].inverse()
     f = x.field(0)
-    for ei in e:
-        f = f + ei
+    for i in range(len(xy) - 1, -1, -1):
+        num, den = nd[i]
+        f = f + yv[i] * num * (inv * pre[i])
+        inv = inv * den
     return f
 
 
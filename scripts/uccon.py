@@ -31,6 +31,7 @@ if __name__ == "__main__":
     parser = argparse.ArgumentParser()
     parser.add_argument("--host", help="host:port to use when connecting to server")
     parser.add_argument("--target", help="serial port to use when connecting")
+    parser.add_argument("--crc", type=int, default=0, help="frame check bits (--target)")
 
     args = parser.parse_args()
     args.raw = False
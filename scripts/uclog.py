@@ -16,6 +16,8 @@
 
 import threading
 import queue
+import re
+import binascii
 import argparse
 import struct
 import time
@@ -25,6 +27,13 @@ import os
 import select
 import fnmatch
 import logging
+import bisect
+import selectors
+import collections
+import heapq
+import json
+import operator
+import zlib
 
 import cbor2
 import serial
@@ -33,7 +42,23 @@ import serial.tools.list_ports as lp
 import cobs
 
 try:
-    from logdata import LogData, TARGET_DIGIT_SHIFT, LOG_TYPE_PORT
+    import zstandard
+except ModuleNotFoundError:
+    zstandard = None
+
+try:
+    from logdata import (
+        LogData,
+        LogDataCache,
+        LogRecord,
+        field_names,
+        level2str,
+        TARGET_DIGIT_SHIFT,
+        LOG_TYPE_BASIC,
+        LOG_TYPE_PORT,
+        LOG_TYPE_FRAG,
+    )
+    from logstats import QUANTILES, LogStats
 except ModuleNotFoundError:
     pass
 
@@ -45,6 +70,23 @@ logging.basicConfig(filename="uclog.log", level=logging.DEBUG)
 LOG_PORT_MAX = 8
 LOG_DEFAULT_HOST = "localhost"
 LOG_DEFAULT_BASE = 9000
+# Clients per port that may be waiting to be accepted
+LOG_LISTEN_BACKLOG = 64
+# Bytes a client may fall behind before frames are dropped for it
+LOG_CLIENT_QUEUE = 1024 * 1024
+# Largest frame on the serial link (LOG_MAX_PACKET_SIZE in include/log.h)
+LOG_MAX_PACKET_SIZE = 1500
+# Largest message a client may send to a port (fragmented to the target),
+# and by default the largest frame taken from the serial link - streamed
+# replies (log_tx_begin() on the target) aren't limited to a packet
+LOG_MAX_MESSAGE_SIZE = 16 * 1024 * 1024
+# Seconds between link error reports (LogServer.metrics())
+LOG_METRICS_PERIOD = 10
+
+# Call site statistics (see logstats.py) are served on the port after the
+# target ports, and by default written to --stats-file this often (seconds)
+LOG_STATS_PORT = LOG_PORT_MAX
+LOG_STATS_PERIOD = 10
 
 DEFAULT_BR = 1000000  # 115200
 
@@ -79,21 +121,62 @@ if sys.platform == "win32":
 
 
 class CobsDecode(object):
-    def __init__(self):
-        self.indata = b""
+    def __init__(self, max_frame=LOG_MAX_PACKET_SIZE):
+        self.parts = []  # the trailing partial frame, a piece per read
+        self.held = 0
+        self.discard = False  # dropping an over-long frame until a delimiter
+        self.max_frame = max_frame
+        self.limit = max_frame + max_frame // 254 + 20  # encoded size
         self.on_data = None
+        self.errors = 0  # undecodable or over-long frames
+        self.overruns = 0  # over-long frames (lost delimiter)
+
+    def _overrun(self):
+        self.errors += 1
+        self.overruns += 1
 
     def __call__(self, data):
-        self.indata = self.indata + data
-        if len(self.indata) > 1500 + 20:
-            self.indata = self.indata[: 1500 + 20]
-        while b"\x00" in self.indata:
-            frame, self.indata = self.indata.split(b"\x00", 1)
+        # One split per read - reads may contain many complete frames.  Only
+        # the new data is split so a long frame over many reads isn't copied
+        # again on each one.
+        frames = data.split(b"\x00")
+        tail = frames.pop()
+        if frames:
+            if self.discard:
+                # The rest of an over-long frame
+                frames[0] = b""
+                self.discard = False
+            elif self.parts:
+                frames[0] = b"".join(self.parts) + frames[0]
+            self.parts = []
+            self.held = 0
+        for frame in frames:
+            if len(frame) == 0:
+                continue
+            if len(frame) > self.limit:
+                self._overrun()
+                continue
+            try:
+                frame = cobs.dec(frame)
+            except Exception:
+                self.errors += 1
+                continue
             try:
-                if self.on_data and len(frame) > 0:
-                    self.on_data(cobs.dec(frame))
+                if self.on_data:
+                    self.on_data(frame)
             except Exception:
                 logging.error("exception ", exc_info=1)
+        if self.discard or len(tail) == 0:
+            return
+        # The trailing partial frame is bounded in case the delimiter was
+        # lost - past that it's dropped, not passed on cut short
+        self.parts.append(tail)
+        self.held += len(tail)
+        if self.held > self.limit:
+            self.parts = []
+            self.held = 0
+            self.discard = True
+            self._overrun()
 
 
 class CobsEncode(object):
@@ -105,6 +188,151 @@ class CobsEncode(object):
             self.on_data(b"\x00" + cobs.enc(data) + b"\x00")
 
 
+# Link frame check (CONFIG_UC_LOG_CRC on the target) - every frame in both
+# directions ends with a little endian CRC-16/CCITT-FALSE or CRC-32 of the
+# rest of the frame
+LOG_CRC_BITS = (0, 16, 32)
+
+
+def frame_crc(bits, frame):
+    if bits == 16:
+        return struct.pack("<H", binascii.crc_hqx(frame, 0xFFFF))
+    if bits == 32:
+        return struct.pack("<I", zlib.crc32(frame))
+    return b""
+
+
+class CrcDecode(object):
+    """
+    Checks and strips the frame check of decoded frames.  Bad frames are
+    dropped; a resync is the first good frame after one or more bad ones.
+    """
+
+    def __init__(self, bits=0):
+        self.bits = bits
+        self.size = bits // 8
+        self.on_data = None
+        self.frames = 0
+        self.crc_errors = 0
+        self.resyncs = 0
+        self.bad = False
+
+    def __call__(self, frame):
+        self.frames += 1
+        if self.size:
+            frame, crc = frame[: -self.size], frame[-self.size :]
+            if len(frame) == 0 or frame_crc(self.bits, frame) != crc:
+                self.crc_errors += 1
+                self.bad = True
+                logging.warning(f"frame check error ({len(frame)} bytes)")
+                return
+            if self.bad:
+                self.resyncs += 1
+                self.bad = False
+        if self.on_data:
+            self.on_data(frame)
+
+
+class CrcEncode(object):
+    def __init__(self, bits=0):
+        self.bits = bits
+        self.on_data = None
+
+    def __call__(self, frame):
+        if self.on_data:
+            self.on_data(frame + frame_crc(self.bits, frame))
+
+
+# Log compression (CONFIG_UC_LOG_COMPRESS, see lib/log.c) - bits 2-3 of the
+# first byte of a log message
+LOG_KEYFRAME = 0x04
+LOG_DELTA = 0x08
+
+
+def callsite_len(frame, callsite_ids=False):
+    """
+    Bytes of call site at the start of a log message - the 4 byte .logstr
+    address, or a varint index << 4 | type with CONFIG_UC_LOG_CALLSITE_ID (see
+    lib/log.c).  0 if the message is too short.
+    """
+    if not callsite_ids:
+        return 4 if len(frame) >= 4 else 0
+    for i, b in enumerate(frame[:5]):
+        if b & 0x80 == 0:
+            return i + 1
+    return 0
+
+
+def callsite_addr(site, callsite_ids=False):
+    """
+    The call site of a log message as passed on by MuxDecode - the .logstr
+    address, or index << 2 with CONFIG_UC_LOG_CALLSITE_ID, with the type in
+    bits 0-1
+    """
+    if not callsite_ids:
+        return struct.unpack("<I", site)[0]
+    v = 0
+    for i, b in enumerate(site):
+        v |= (b & 0x7F) << (7 * i)
+    return ((v >> 4) << 2) | (v & 3)
+
+
+class LogExpand(object):
+    """
+    Expands compressed log messages back to plain ones.  A delta that doesn't
+    follow on from the last message the host has for its slot (one was lost)
+    is dropped, as are the rest from that slot until the next keyframe.
+    """
+
+    def __init__(self, callsite_ids=False):
+        self.on_data = None
+        self.callsite_ids = callsite_ids
+        self.slots = {}  # slot -> [ptr, args, seq]
+        self.lost = 0
+
+    def _expand(self, frame):
+        code = frame[0] & (LOG_KEYFRAME | LOG_DELTA)
+        hn = callsite_len(frame, self.callsite_ids)
+        if code == LOG_KEYFRAME and hn != 0 and len(frame) >= hn + 2:
+            ptr = bytes((frame[0] & ~LOG_KEYFRAME,)) + frame[1:hn]
+            args = frame[hn + 2 :]
+            self.slots[frame[hn]] = [ptr, args, frame[hn + 1]]
+            return ptr + args
+        if code != LOG_DELTA:
+            return None
+        seq, slot = frame[0] >> 4, frame[1]
+        ref = self.slots.pop(slot, None)
+        if ref is None or (ref[2] + 1) & 0xF != seq:
+            return None
+        ptr, args, _ = ref
+        mn = (len(args) + 7) // 8
+        m, changed = frame[2 : 2 + mn], frame[2 + mn :]
+        if len(m) != mn or sum(bin(x).count("1") for x in m) != len(changed):
+            return None
+        a = bytearray(args)
+        j = 0
+        for i in range(len(a)):
+            if m[i >> 3] & (1 << (i & 7)):
+                a[i] = changed[j]
+                j += 1
+        args = bytes(a)
+        self.slots[slot] = [ptr, args, seq]
+        return ptr + args
+
+    def __call__(self, frame):
+        if (
+            len(frame) >= 2
+            and (frame[0] & 3) == LOG_TYPE_BASIC
+            and frame[0] & (LOG_KEYFRAME | LOG_DELTA)
+        ):
+            frame = self._expand(frame)
+            if frame is None:
+                self.lost += 1
+                return
+        if self.on_data:
+            self.on_data(frame)
+
+
 class CborDecode(object):
     def __init__(self):
         self.on_data = None
@@ -128,21 +356,39 @@ class CborEncode(object):
 
 
 class MuxDecode(object):
-    def __init__(self, on_data):
+    """
+    Splits target frames by type.  Log messages go to on_data["log"] as
+    (target, addr, args) - with callsite_ids (CONFIG_UC_LOG_CALLSITE_ID)
+    target is None as the frames don't carry the target digit, and addr is
+    the call site index << 2 (see callsite_addr()).
+    """
+
+    def __init__(self, on_data, callsite_ids=False):
         self.on_data = on_data
+        self.callsite_ids = callsite_ids
 
     def __call__(self, frame):
         if len(frame) == 0:
             return
         p, t = divmod(int(frame[0]), 4)
-        if t == LOG_TYPE_PORT:
+        if t == LOG_TYPE_FRAG:
+            if "frag" in self.on_data:
+                self.on_data["frag"]((p, frame[1:]))
+        elif t == LOG_TYPE_PORT:
             if p in self.on_data:
                 self.on_data[p](frame[1:])
             elif p == 63:
                 print(f"----- Image hash: {frame[1:].hex()} -----")
-        elif len(frame) >= 4:
-            addr, frame = struct.unpack("<I", frame[:4])[0], frame[4:]
-            target = (addr >> TARGET_DIGIT_SHIFT) & 0xF
+                if "hash" in self.on_data:
+                    self.on_data["hash"](frame[1:])
+        elif callsite_len(frame, self.callsite_ids) != 0:
+            hn = callsite_len(frame, self.callsite_ids)
+            addr = callsite_addr(frame[:hn], self.callsite_ids)
+            frame = frame[hn:]
+            if self.callsite_ids:
+                target = None
+            else:
+                target = (addr >> TARGET_DIGIT_SHIFT) & 0xF
             if "log" in self.on_data:
                 self.on_data["log"]((target, addr, frame))
         else:
@@ -160,16 +406,331 @@ class MuxEncode(object):
             self.on_data(bytes(((self.port << 2) | LOG_TYPE_PORT,)) + frame)
 
 
+# Port message fragmentation and reliable channels - see lib/logserver.c
+# for the frame format
+FRAG_FIRST = 0x01
+FRAG_LAST = 0x02
+FRAG_ACK = 0x04
+FRAG_NACK = 0x08
+frag_header = struct.Struct("<BBHI")  # flags, id, seq, offset
+frag_ack = struct.Struct("<BBHB")  # flags, id, next seq wanted, credits
+FRAG_CRC = 2
+FRAG_SIZE = LOG_MAX_PACKET_SIZE - 1 - frag_header.size - FRAG_CRC
+FRAG_WINDOW = 8
+FRAG_RX_WINDOW = 8
+FRAG_TIMEOUT = 0.2
+FRAG_RETRIES = 10
+
+
+def frag_frame(port, data, crc=True):
+    """
+    LOG_TYPE_FRAG frame with CRC-16/CCITT-FALSE trailer, or without if crc
+    is false (the link frame check covers it)
+    """
+    frame = bytes(((port << 2) | LOG_TYPE_FRAG,)) + data
+    if not crc:
+        return frame
+    return frame + struct.pack("<H", binascii.crc_hqx(frame, 0xFFFF))
+
+
+class FragReceiver(object):
+    """
+    Reassembles fragments from one port and acknowledges them via tx
+    (a callable taking an unencoded frame).  Whole messages go to on_data.
+    While busy() is true the sender is given no credits; call resume() when
+    it may be false again.  crc is false when the link frame check is on
+    (fragments have no CRC of their own).
+    """
+
+    def __init__(self, port, tx, window=FRAG_RX_WINDOW, crc=True):
+        self.port = port
+        self.tx = tx
+        self.window = window
+        self.crc = crc
+        self.started = False
+        self.nacked = False
+        self.stalled = False
+        self.id = None
+        self.seq = 0
+        self.data = bytearray()
+        self.busy = None
+        self.on_data = None
+
+    def _ack(self, flags=0):
+        credits = self.window
+        if self.busy and self.busy():
+            credits = 0
+        self.stalled = credits == 0
+        self.tx(
+            frag_frame(
+                self.port,
+                frag_ack.pack(FRAG_ACK | flags, self.id, self.seq, credits),
+                self.crc,
+            )
+        )
+
+    def resume(self):
+        if self.stalled and not (self.busy and self.busy()):
+            self._ack()
+
+    def _nack(self):
+        # Once per gap - the sender goes back without waiting for a timeout
+        if self.started and not self.nacked:
+            self.nacked = True
+            self._ack(FRAG_NACK)
+
+    def crc_error(self):
+        self._nack()
+
+    def __call__(self, frame):
+        if len(frame) < frag_header.size:
+            return
+        flags, id, seq, off = frag_header.unpack_from(frame)
+        # A first fragment starts a new message unless it is a repeat of the
+        # current one (our ACK was lost)
+        if flags & FRAG_FIRST and seq == 0 and (not self.started or id != self.id):
+            self.started = True
+            self.nacked = False
+            self.id = id
+            self.seq = 0
+            self.data = bytearray()
+        if not self.started or id != self.id:
+            return
+        if seq == self.seq and off == len(self.data):
+            if len(self.data) + len(frame) - frag_header.size > LOG_MAX_MESSAGE_SIZE:
+                logging.error(f"port {self.port} fragmented message too large")
+                self.started = False
+                return
+            self.data += frame[frag_header.size :]
+            self.seq += 1
+            self.nacked = False
+            self._ack()
+            if flags & FRAG_LAST and self.on_data:
+                self.on_data(bytes(self.data))
+        elif seq > self.seq:
+            self._nack()
+        else:
+            # Repeat - our ACK was lost
+            self._ack()
+
+
+class FragSender(object):
+    """
+    Sends messages on one port as fragments (go-back-N) using the loop's
+    timers for retransmission.  Messages are sent one at a time in order.
+    At most min(window, receiver's credits) fragments are in flight - with
+    no credits one fragment is sent per timeout as a probe.  Unencoded
+    frames go to on_data, ACK frames are passed to ack().  crc as for
+    FragReceiver.
+    """
+
+    def __init__(
+        self,
+        loop,
+        port,
+        window=FRAG_WINDOW,
+        timeout=FRAG_TIMEOUT,
+        retries=FRAG_RETRIES,
+        size=FRAG_SIZE,
+        crc=True,
+    ):
+        self.loop = loop
+        self.port = port
+        self.crc = crc
+        self.max_window = window
+        self.timeout = timeout
+        self.retries = retries
+        self.size = size
+        self.queue = collections.deque()
+        self.queued = 0
+        self.msg = None
+        self.id = int.from_bytes(os.urandom(1), "little")
+        self.timer = 0
+        self.on_queue = None
+        self.on_data = None
+
+    def __call__(self, message):
+        self.queue.append(message)
+        self.queued += len(message)
+        if self.on_queue:
+            self.on_queue(self.queued)
+        if self.msg is None:
+            self._next()
+
+    def _next(self):
+        self.timer += 1
+        if not self.queue:
+            self.msg = None
+            return
+        self.msg = self.queue.popleft()
+        self.queued -= len(self.msg)
+        if self.on_queue:
+            self.on_queue(self.queued)
+        self.id = (self.id + 1) & 0xFF
+        self.frags = max(1, (len(self.msg) + self.size - 1) // self.size)
+        self.acked = 0
+        self.next = 0
+        self.window = 1  # until the receiver says otherwise
+        self.tries = 0
+        self._send()
+
+    def _send(self, probe=False):
+        window = min(self.window, self.max_window)
+        if probe:
+            window = max(window, 1)
+        while self.next < self.frags and self.next < self.acked + window:
+            off = self.next * self.size
+            flags = (FRAG_FIRST if self.next == 0 else 0) | (
+                FRAG_LAST if self.next == self.frags - 1 else 0
+            )
+            if self.on_data:
+                self.on_data(
+                    frag_frame(
+                        self.port,
+                        frag_header.pack(flags, self.id, self.next, off)
+                        + self.msg[off : off + self.size],
+                        self.crc,
+                    )
+                )
+            self.next += 1
+        # Restart the retransmit timer
+        self.timer += 1
+        timer = self.timer
+        self.loop.call_later(self.timeout, lambda: self._timeout(timer))
+
+    def _timeout(self, timer):
+        if timer != self.timer or self.msg is None:
+            return
+        self.tries += 1
+        if self.tries > self.retries:
+            logging.error(f"port {self.port} fragment {self.acked} not acknowledged")
+            self._next()
+            return
+        # Go back to the first unacknowledged fragment (probe if no credits)
+        self.next = self.acked
+        self._send(probe=True)
+
+    def ack(self, frame):
+        if len(frame) < frag_ack.size:
+            return
+        flags, id, seq, window = frag_ack.unpack_from(frame)
+        if self.msg is None or id != self.id or seq < self.acked:
+            return
+        self.acked = seq
+        self.window = window
+        self.tries = 0
+        if self.acked >= self.frags:
+            self._next()
+            return
+        if flags & FRAG_NACK:
+            self.next = self.acked
+        self._send()
+
+
+class FragMux(object):
+    """
+    Checks the CRC (unless crc is false - see FragReceiver) of LOG_TYPE_FRAG
+    frames (port, frame) from MuxDecode and routes them to the receiver or,
+    for ACKs, the sender of the port.
+    """
+
+    def __init__(self, receivers, senders, crc=True):
+        self.receivers = receivers
+        self.senders = senders
+        self.crc = crc
+        self.crc_errors = 0
+
+    def __call__(self, data):
+        p, frame = data
+        if len(frame) < 1 + (FRAG_CRC if self.crc else 0):
+            return
+        if self.crc:
+            frame, crc = frame[:-FRAG_CRC], frame[-FRAG_CRC:]
+            if binascii.crc_hqx(
+                bytes(((p << 2) | LOG_TYPE_FRAG,)) + frame, 0xFFFF
+            ) != struct.unpack("<H", crc)[0]:
+                self.crc_errors += 1
+                logging.warning(f"port {p} fragment CRC error")
+                if p in self.receivers:
+                    self.receivers[p].crc_error()
+                return
+        if frame[0] & FRAG_ACK:
+            if p in self.senders:
+                self.senders[p].ack(frame)
+        elif p in self.receivers:
+            self.receivers[p](frame)
+
+
+class PortEncode(object):
+    """
+    MuxEncode for messages that fit in a frame, fragments for the rest.
+    Every message on a reliable port is sent as fragments.
+    """
+
+    def __init__(self, port, sender, reliable=False):
+        self.port = port
+        self.sender = sender
+        self.reliable = reliable
+        self.on_data = None
+
+    def __call__(self, frame):
+        if self.reliable or len(frame) + 1 > LOG_MAX_PACKET_SIZE:
+            self.sender(frame)
+        elif self.on_data:
+            self.on_data(bytes(((self.port << 2) | LOG_TYPE_PORT,)) + frame)
+
+
 class LogDecode(object):
-    def __init__(self, dec):
-        self.dec = dec
+    """
+    Decodes log messages to LogRecords (LogData.lazy()), which are only
+    formatted as text if a consumer reads them, or to typed records
+    (LogData.record()) with records
+    """
+
+    def __init__(self, dec, cache=None, clock=None, records=False):
+        self.dec = dict(dec)
+        self.cache = cache
+        self.clock = clock
+        self.records = records
         self.on_data = None
+        # Target of messages without a target digit (--callsite-ids) - the
+        # image last announced, or the only decoder
+        self.current = next(iter(self.dec)) if len(self.dec) == 1 else None
+
+    def set_app_hash(self, app_hash):
+        # Target (re)announced itself - switch to the matching decoder, and
+        # a rebuilt image's tables if it's now running it
+        for d in set(self.dec.values()):
+            d.set_app_hash(app_hash)
+        if self.cache is None:
+            return
+        try:
+            d = self.cache.get(app_hash)
+        except Exception:
+            logging.error("exception ", exc_info=1)
+            d = None
+        if d is None:
+            # Records without a target digit are passed through raw rather
+            # than decoded with the previous image's tables
+            print(f"----- No cached logdata for: {app_hash.hex()} -----")
+            self.current = None
+            return
+        self.current = d.target()
+        if self.dec.get(d.target()) is not d:
+            self.dec[d.target()] = d
+            print(f"----- Using logdata: {d.filename} -----")
 
     def __call__(self, item):
         try:
-            target, _, _ = item
-            if target in self.dec:
-                r = self.dec[target].decode(item)
+            target, addr, frame = item
+            if target is None and self.current is not None:
+                target = self.current
+                item = (target, addr, frame)
+            ts = self.clock() if self.clock else None
+            if target in self.dec and self.records:
+                r = self.dec[target].record(item, ts)
+            elif target in self.dec:
+                r = self.dec[target].lazy(item, ts)
             else:
                 r = item
         except Exception:
@@ -179,6 +740,38 @@ class LogDecode(object):
             self.on_data(r)
 
 
+class LogRedecode(object):
+    """
+    Client side decoding of the binary form of the log port (see
+    LogPortServer) - the app hashes select decoders from the cache as on the
+    server, and the messages keep the server's record numbers and times
+    """
+
+    def __init__(self, dec, cache=None, records=False):
+        self.n = None
+        self.ts = None
+        self.log_decode = LogDecode(dec, cache, lambda: self.ts, records)
+        self.log_decode.on_data = self._decoded
+        self.on_data = None
+
+    def __call__(self, item):
+        if isinstance(item, bytes):
+            self.log_decode.set_app_hash(item)
+        elif len(item) == 5:
+            self.n, self.ts, target, addr, args = item
+            self.log_decode((target, addr, args))
+        elif self.on_data:
+            self.on_data(item)
+
+    def _decoded(self, r):
+        if isinstance(r, LogRecord):
+            r.n = self.n
+        elif isinstance(r, dict):
+            r["n"] = self.n
+        if self.on_data:
+            self.on_data(r)
+
+
 class LogDisplay(object):
     def __init__(self):
         pass
@@ -197,6 +790,274 @@ class LogDisplay(object):
             print(item)
 
 
+def json_default(v):
+    return v.hex() if isinstance(v, (bytes, bytearray)) else str(v)
+
+
+class LogJsonDisplay(object):
+    """
+    Prints each record as a line of JSON (see LogData.record()), bytes as
+    hex.  Messages from images without a decoder are given as their target,
+    call site address and raw argument bytes.
+    """
+
+    records = True
+
+    def __call__(self, item):
+        if isinstance(item, dict):
+            pass
+        elif len(item) == 6:
+            # Text from a LogServer log port
+            item = dict(zip(("n", "ts", "level", "file", "line", "text"), item))
+        else:
+            item = dict(zip(("target", "addr", "raw"), item[-3:]))
+        print(json.dumps(item, default=json_default))
+
+
+# Raw capture file format
+#
+#   file   := header chunk* [index trailer]
+#   header := "UCLOGCAP" version:u16 reserved:u16
+#   chunk  := chunk_header data
+#   data   := record*  (zstd compressed if codec == CAPTURE_ZSTD)
+#   record := ts:f64 n:u32 frame[n]
+#
+# Version 1 files have n:u16, which can't hold the streamed replies
+# (log_tx_begin()) LOG_MAX_MESSAGE_SIZE allows - they are still read.
+#
+# Frames are stored COBS decoded, i.e. starting with the type/port byte, and
+# ts is the host receive time (seconds since epoch).  Every frame in a chunk
+# was sent by the image identified by the chunk app hash; a new chunk is
+# started when the target announces a different hash.  Chunks are closed
+# every CAPTURE_CHUNK_SIZE bytes or CAPTURE_CHUNK_SECS seconds so a crashed
+# capture loses little, and so the reader can seek without decompressing
+# everything before the time of interest.
+#
+# The index is written on close.  If it is missing (capture was killed) the
+# reader rebuilds it by walking the chunk headers.
+CAPTURE_MAGIC = b"UCLOGCAP"
+CAPTURE_END = b"UCLOGEND"
+CAPTURE_VERSION = 2
+CAPTURE_RAW = 0
+CAPTURE_ZSTD = 1
+CAPTURE_CHUNK_SIZE = 256 * 1024
+CAPTURE_CHUNK_SECS = 5.0
+CAPTURE_HASH_PORT = 63
+
+capture_header = struct.Struct("<8sHH")
+# magic, codec, raw size, data size, first seq, frame count, first ts, last ts, app hash
+chunk_header = struct.Struct("<4sB3xIIQIdd64s")
+record_header = struct.Struct("<dI")
+record_header_v1 = struct.Struct("<dH")
+# chunk offset, first seq, frame count, first ts, last ts
+index_entry = struct.Struct("<QQIdd")
+index_trailer = struct.Struct("<QI8s")
+
+
+class CaptureWriter(object):
+    """
+    Pipeline stage that records every COBS decoded frame and passes it on.
+    """
+
+    def __init__(self, fname, compress=False):
+        if compress and zstandard is None:
+            raise Exception("zstandard module required for compressed capture")
+        self.f = open(fname, "wb")
+        self.f.write(capture_header.pack(CAPTURE_MAGIC, CAPTURE_VERSION, 0))
+        self.codec = CAPTURE_ZSTD if compress else CAPTURE_RAW
+        self.zc = zstandard.ZstdCompressor() if compress else None
+        self.lock = threading.Lock()
+        self.on_data = None
+        self.app_hash = bytes(64)
+        self.index = []
+        self.seq = 0
+        self._new_chunk()
+
+    def _new_chunk(self):
+        self.records = []
+        self.n = 0
+        self.first_seq = self.seq
+        self.first_ts = None
+        self.last_ts = None
+
+    def _flush(self):
+        if len(self.records) == 0:
+            return
+        raw = b"".join(self.records)
+        data = self.zc.compress(raw) if self.zc else raw
+        offset = self.f.tell()
+        self.f.write(
+            chunk_header.pack(
+                b"CHNK",
+                self.codec,
+                len(raw),
+                len(data),
+                self.first_seq,
+                len(self.records) // 2,
+                self.first_ts,
+                self.last_ts,
+                self.app_hash,
+            )
+        )
+        self.f.write(data)
+        self.f.flush()
+        self.index.append(
+            (offset, self.first_seq, len(self.records) // 2, self.first_ts, self.last_ts)
+        )
+        self._new_chunk()
+
+    def __call__(self, frame):
+        ts = time.time()
+        with self.lock:
+            if self.f is not None:
+                if (
+                    len(frame) == 1 + 64
+                    and frame[0] == (CAPTURE_HASH_PORT << 2) | LOG_TYPE_PORT
+                    and frame[1:] != self.app_hash
+                ):
+                    self._flush()
+                    self.app_hash = bytes(frame[1:])
+                if self.first_ts is None:
+                    self.first_ts = ts
+                self.last_ts = ts
+                self.records.append(record_header.pack(ts, len(frame)))
+                self.records.append(bytes(frame))
+                self.n += record_header.size + len(frame)
+                self.seq += 1
+                if (
+                    self.n >= CAPTURE_CHUNK_SIZE
+                    or ts - self.first_ts >= CAPTURE_CHUNK_SECS
+                ):
+                    self._flush()
+        if self.on_data:
+            self.on_data(frame)
+
+    def close(self):
+        with self.lock:
+            if self.f is None:
+                return
+            self._flush()
+            offset = self.f.tell()
+            for entry in self.index:
+                self.f.write(index_entry.pack(*entry))
+            self.f.write(index_trailer.pack(offset, len(self.index), CAPTURE_END))
+            self.f.close()
+            self.f = None
+
+
+class CaptureReader(object):
+    def __init__(self, fname):
+        self.f = open(fname, "rb")
+        magic, version, _ = capture_header.unpack(self.f.read(capture_header.size))
+        if magic != CAPTURE_MAGIC or version not in (1, CAPTURE_VERSION):
+            raise Exception(f"{fname} is not a uclog capture file")
+        self.record_header = record_header if version > 1 else record_header_v1
+        self.index = self._read_index()
+        self.last_ts = [x[4] for x in self.index]
+
+    def close(self):
+        self.f.close()
+
+    def _read_index(self):
+        self.f.seek(0, os.SEEK_END)
+        size = self.f.tell()
+        if size >= capture_header.size + index_trailer.size:
+            self.f.seek(size - index_trailer.size)
+            offset, n, magic = index_trailer.unpack(self.f.read(index_trailer.size))
+            if magic == CAPTURE_END:
+                self.f.seek(offset)
+                data = self.f.read(n * index_entry.size)
+                return [x for x in index_entry.iter_unpack(data)]
+
+        # No index - walk the chunk headers
+        index = []
+        offset = capture_header.size
+        while offset + chunk_header.size <= size:
+            self.f.seek(offset)
+            h = chunk_header.unpack(self.f.read(chunk_header.size))
+            if h[0] != b"CHNK" or offset + chunk_header.size + h[3] > size:
+                break
+            index.append((offset, h[4], h[5], h[6], h[7]))
+            offset += chunk_header.size + h[3]
+        return index
+
+    def start_time(self):
+        return self.index[0][3] if len(self.index) > 0 else None
+
+    def _chunk(self, offset):
+        self.f.seek(offset)
+        _, codec, raw_n, data_n, seq, _, _, _, app_hash = chunk_header.unpack(
+            self.f.read(chunk_header.size)
+        )
+        data = self.f.read(data_n)
+        if codec == CAPTURE_ZSTD:
+            if zstandard is None:
+                raise Exception("zstandard module required for compressed capture")
+            data = zstandard.ZstdDecompressor().decompress(data, max_output_size=raw_n)
+        return seq, app_hash, data
+
+    def frames(self, start=None, end=None):
+        """
+        Yields (ts, seq, app_hash, frame) for frames received in [start, end]
+        """
+        i = 0 if start is None else bisect.bisect_left(self.last_ts, start)
+        for offset, _, _, first_ts, _ in self.index[i:]:
+            if end is not None and first_ts > end:
+                break
+            seq, app_hash, data = self._chunk(offset)
+            rh = self.record_header
+            idx = 0
+            while idx + rh.size <= len(data):
+                ts, n = rh.unpack_from(data, idx)
+                idx += rh.size
+                frame = data[idx : idx + n]
+                idx += n
+                if end is not None and ts > end:
+                    return
+                if start is None or ts >= start:
+                    yield ts, seq, app_hash, frame
+                seq += 1
+
+
+def replay(
+    fname,
+    decoders,
+    cache=None,
+    start=None,
+    end=None,
+    display=None,
+    callsite_ids=False,
+):
+    """
+    Re-decode a capture with the given decoders (and/or the logdata cache
+    when the capture records app hashes).  start/end are seconds relative to
+    the start of the capture.  callsite_ids as for MuxDecode.
+    """
+    reader = CaptureReader(fname)
+    t0 = reader.start_time()
+    if t0 is None:
+        return
+    now = [0.0]
+    display = display or LogDisplay()
+    records = getattr(display, "records", False)
+    log_decode = LogDecode(decoders, cache, clock=lambda: now[0], records=records)
+    rx = {"log": chain([log_decode, display])}
+    mux = MuxDecode(rx, callsite_ids)
+    app_hash = None
+    try:
+        for ts, _, h, frame in reader.frames(
+            None if start is None else t0 + start, None if end is None else t0 + end
+        ):
+            if h != app_hash:
+                app_hash = h
+                if any(h):
+                    log_decode.set_app_hash(h)
+            now[0] = ts - t0
+            mux(frame)
+    finally:
+        reader.close()
+
+
 class Network(threading.Thread):
     def __init__(self, addr):
         threading.Thread.__init__(self)
@@ -261,46 +1122,535 @@ class Client(Network):
                 self.conn.close()
 
 
-class Server(Network):
-    def __init__(self, addr):
-        Network.__init__(self, addr)
+class EventLoop(threading.Thread):
+    """
+    Single selector based loop that services the serial device and every
+    listening/connected socket of a LogServer.  All callbacks run on this
+    thread so the pipeline stages need no locking.
+    """
 
-    def run(self):
-        sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
-        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
-        self.conn = None
+    def __init__(self):
+        threading.Thread.__init__(self, daemon=True)
+        self.sel = selectors.DefaultSelector()
+        self.alive = True
+        self.wake_write, self.wake_read = socket.socketpair()
+        self.wake_read.setblocking(False)
+        self.sel.register(self.wake_read, selectors.EVENT_READ, self._wakeup)
+        self.pending = collections.deque()
+        self.timers = []
+        self.timer_seq = 0
+
+    def _wakeup(self, sock, mask):
         try:
-            logging.debug(f"server starting on: {self.addr}")
-            sock.bind(self.addr)
-            sock.listen(1)  # Each server can only have one client
-            while self.alive:
+            sock.recv(4096)
+        except BlockingIOError:
+            pass
+
+    def register(self, fileobj, events, cb):
+        self.sel.register(fileobj, events, cb)
+
+    def modify(self, fileobj, events, cb):
+        self.sel.modify(fileobj, events, cb)
+
+    def unregister(self, fileobj):
+        try:
+            self.sel.unregister(fileobj)
+        except (KeyError, ValueError):
+            pass
+
+    def call_soon(self, fn, *args):
+        # Safe to call from any thread
+        self.pending.append((fn, args))
+        if threading.current_thread() is not self:
+            try:
+                self.wake_write.send(b"\x00")
+            except OSError:
+                pass
+
+    def call_later(self, delay, fn, period=None):
+        # Only call from the loop thread (or before it starts)
+        self.timer_seq += 1
+        heapq.heappush(self.timers, (time.time() + delay, self.timer_seq, fn, period))
+
+    def shutdown(self):
+        if self.alive:
+            self.alive = False
+            self.wake_write.send(b"\x00")
+            if self.is_alive():
+                self.join()
+            self.sel.close()
+            self.wake_write.close()
+            self.wake_read.close()
+
+    def run(self):
+        while self.alive:
+            timeout = None
+            if self.timers:
+                timeout = max(0, self.timers[0][0] - time.time())
+            for key, mask in self.sel.select(timeout):
                 try:
-                    r, _, _ = select.select((sock, self.wake_read), (), (), 0.1)
-                    for z in r:
-                        if z == sock:
-                            self.conn, self.client = sock.accept()
-                            logging.debug(
-                                f"accepting connection on: {self.addr} from: {self.client}"
-                            )
-                            self.process()
-                        elif z == self.wake_read:
-                            # Local request to terminate
-                            self.wake_read.recv(4096)
-                            self.wake_read.close()
-                except Exception as e:
+                    key.data(key.fileobj, mask)
+                except Exception:
                     logging.error("exception ", exc_info=1)
-                    raise e
-                finally:
-                    with self.lock:
-                        if self.conn:
-                            logging.debug(
-                                f"closing connection on: {self.addr} from: {self.client}"
-                            )
-                            self.conn.close()
-                        self.conn = None
-        finally:
-            logging.debug(f"server stopping on: {self.addr}")
-            sock.close()
+            while self.pending:
+                fn, args = self.pending.popleft()
+                try:
+                    fn(*args)
+                except Exception:
+                    logging.error("exception ", exc_info=1)
+            now = time.time()
+            while self.timers and self.timers[0][0] <= now:
+                _, _, fn, period = heapq.heappop(self.timers)
+                # Re-armed even if it fails so one bad tick doesn't stop it
+                if period is not None:
+                    self.call_later(period, fn, period)
+                try:
+                    fn()
+                except Exception:
+                    logging.error("exception ", exc_info=1)
+
+
+class Connection(object):
+    """
+    One subscriber on a PortServer.  Outgoing frames are queued and written
+    as the socket drains.  If the client falls more than LOG_CLIENT_QUEUE
+    bytes behind whole frames are dropped for that client only, so a slow
+    subscriber never stalls the target or the other subscribers.
+    """
+
+    def __init__(self, server, conn, addr):
+        self.server = server
+        self.loop = server.loop
+        self.conn = conn
+        self.addr = addr
+        self.queue = collections.deque()
+        self.queued = 0
+        self.dropped = 0
+        self.conn.setblocking(False)
+        self.events = 0
+        self.update()
+
+    def send(self, data):
+        if self.queued + len(data) > LOG_CLIENT_QUEUE:
+            if self.dropped == 0:
+                logging.warning(f"client {self.addr} on {self.server.addr} is slow")
+            self.dropped += 1
+            return
+        if self.dropped > 0:
+            logging.warning(
+                f"dropped {self.dropped} frames for {self.addr} on {self.server.addr}"
+            )
+            self.dropped = 0
+        self.queue.append(data)
+        self.queued += len(data)
+        if self.events & selectors.EVENT_WRITE == 0:
+            self._write()
+
+    def _write(self):
+        while self.queue:
+            data = self.queue[0]
+            try:
+                n = self.conn.send(data)
+            except BlockingIOError:
+                break
+            except OSError:
+                self.close()
+                return
+            self.queued -= n
+            if n < len(data):
+                self.queue[0] = data[n:]
+                break
+            self.queue.popleft()
+        self.update()
+        if not self.queue and self.server.on_drain:
+            self.server.on_drain()
+
+    def update(self):
+        events = 0 if self.server.paused else selectors.EVENT_READ
+        if self.queue:
+            events |= selectors.EVENT_WRITE
+        if events != self.events:
+            if self.events == 0:
+                self.loop.register(self.conn, events, self._ready)
+            elif events == 0:
+                self.loop.unregister(self.conn)
+            else:
+                self.loop.modify(self.conn, events, self._ready)
+            self.events = events
+
+    def _ready(self, conn, mask):
+        if mask & selectors.EVENT_WRITE:
+            self._write()
+        if mask & selectors.EVENT_READ and self.conn is not None:
+            try:
+                data = self.conn.recv(4096)
+            except BlockingIOError:
+                return
+            except OSError:
+                data = b""
+            if len(data) == 0:
+                logging.debug(f"peer closed connection {self.addr}")
+                self.close()
+            else:
+                self.server.received(self, data)
+
+    def close(self):
+        if self.conn is not None:
+            logging.debug(
+                f"closing connection on: {self.server.addr} from: {self.addr}"
+            )
+            self.loop.unregister(self.conn)
+            self.conn.close()
+            self.conn = None
+            self.server.closed(self)
+
+
+class PortServer(object):
+    """
+    Listening socket on the EventLoop.  Any number of clients may connect;
+    data from the target is fanned out to all of them and data from any of
+    them is passed to on_data.
+    """
+
+    def __init__(self, loop, addr):
+        self.loop = loop
+        self.addr = addr
+        self.on_data = None
+        self.on_drain = None
+        self.paused = False
+        self.clients = set()
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        logging.debug(f"server starting on: {self.addr}")
+        self.sock.bind(self.addr)
+        self.sock.listen(LOG_LISTEN_BACKLOG)
+        self.sock.setblocking(False)
+        self.loop.register(self.sock, selectors.EVENT_READ, self._accept)
+
+    def _accept(self, sock, mask):
+        try:
+            conn, addr = sock.accept()
+        except BlockingIOError:
+            return
+        logging.debug(f"accepting connection on: {self.addr} from: {addr}")
+        self.clients.add(Connection(self, conn, addr))
+
+    def received(self, conn, data):
+        if self.on_data:
+            self.on_data(data)
+
+    def closed(self, conn):
+        self.clients.discard(conn)
+
+    def __call__(self, data):
+        for c in list(self.clients):
+            c.send(data)
+
+    def backlog(self):
+        # Bytes queued for the slowest client
+        return max((c.queued for c in self.clients), default=0)
+
+    def pause(self, paused):
+        # Stop/start reading from clients (flow control towards the target)
+        if paused != self.paused:
+            self.paused = paused
+            for c in list(self.clients):
+                c.update()
+
+    def is_alive(self):
+        return self.loop.is_alive()
+
+    def shutdown(self):
+        # Called after the loop has stopped
+        logging.debug(f"server stopping on: {self.addr}")
+        for c in list(self.clients):
+            c.close()
+        self.sock.close()
+
+
+class FramePortServer(PortServer):
+    """
+    A port whose clients send COBS framed messages, passed to on_data a
+    frame at a time.  Each connection has its own decoder so the frames of
+    clients sending at the same time aren't mixed up.
+    """
+
+    def __init__(self, loop, addr, max_frame=LOG_MAX_MESSAGE_SIZE):
+        super().__init__(loop, addr)
+        self.max_frame = max_frame
+
+    def received(self, conn, data):
+        if not hasattr(conn, "frames"):
+            conn.frames = CobsDecode(self.max_frame)
+            conn.frames.on_data = self._frame
+        conn.frames(data)
+
+    def _frame(self, frame):
+        if self.on_data:
+            self.on_data(frame)
+
+
+class LogFilter(object):
+    """
+    A log port client's filter, from the map it sends as {"filter": {...}}.
+    Every part given must match:
+
+      "level": lowest level, by name ("WARN") or number (2)
+      "file": fnmatch pattern of the source file name
+      "callsites": call site IDs (see callsite_id()) or "file:line"s
+      "args": [[field, op, value], ...] with op one of == != < <= > >= glob,
+              on the raw argument values (enums are numbers) by field name
+              (see field_names())
+
+    The level, file and call site parts, and which arguments the predicates
+    test, are worked out once per call site (site()), so only the argument
+    predicates are left for each record (test()).  Records from unknown call
+    sites only pass an empty filter.  Raises ValueError for a bad filter.
+    """
+
+    OPS = {
+        "==": operator.eq,
+        "!=": operator.ne,
+        "<": operator.lt,
+        "<=": operator.le,
+        ">": operator.gt,
+        ">=": operator.ge,
+        "glob": lambda v, p: fnmatch.fnmatchcase(str(v), p),
+    }
+    # Level names -> numbers, from logdata's level2str on first use (logdata
+    # isn't needed to import uclog)
+    LEVELS = None
+
+    def __init__(self, spec):
+        if not isinstance(spec, dict) or not set(spec) <= {
+            "level",
+            "file",
+            "callsites",
+            "args",
+        }:
+            raise ValueError(f"bad filter {spec!r}")
+        level = spec.get("level")
+        if isinstance(level, str):
+            if LogFilter.LEVELS is None:
+                LogFilter.LEVELS = {v.strip(): int(k) for k, v in level2str.items()}
+            level = LogFilter.LEVELS.get(level.upper())
+            if level is None:
+                raise ValueError(f"bad level {spec['level']!r}")
+        elif level is not None and not isinstance(level, int):
+            raise ValueError(f"bad level {level!r}")
+        self.level = level
+        self.file = spec.get("file")
+        if self.file is not None and not isinstance(self.file, str):
+            raise ValueError(f"bad file {self.file!r}")
+        self.callsites = set(spec.get("callsites") or ())
+        self.args = []
+        for a in spec.get("args") or ():
+            if len(a) != 3 or a[1] not in self.OPS:
+                raise ValueError(f"bad argument predicate {a!r}")
+            self.args.append((a[0], self.OPS[a[1]], a[2]))
+        self.empty = (
+            self.level is None
+            and self.file is None
+            and not self.callsites
+            and not self.args
+        )
+
+    def site(self, tables, addr, kind, fmt):
+        """
+        The argument predicates, as (index, op, value), for records from the
+        call site, or None if none of its records can pass
+        """
+        if fmt is None or len(fmt) != 5:
+            return None if not self.empty else []
+        level, fname, line, _, parser = fmt
+        if self.level is not None and not (
+            level.isdigit() and int(level) >= self.level
+        ):
+            return None
+        if self.file is not None and not fnmatch.fnmatch(fname, self.file):
+            return None
+        if (
+            self.callsites
+            and tables.ids.get(addr) not in self.callsites
+            and f"{fname}:{line}" not in self.callsites
+        ):
+            return None
+        preds = []
+        if self.args:
+            if kind != LOG_TYPE_BASIC:
+                return None
+            names = field_names(tables.keys.get(addr), len(parser))
+            for name, op, value in self.args:
+                if name not in names:
+                    return None
+                preds.append((names.index(name), op, value))
+        return preds
+
+    @staticmethod
+    def test(record, preds):
+        # Whether a record passes its call site's argument predicates
+        r = record.values()
+        if r is None:
+            return False
+        vals = r[2]
+        try:
+            return all(op(vals[i], value) for i, op, value in preds)
+        except TypeError:
+            return False
+
+
+class RequestPortServer(PortServer):
+    """
+    A port whose clients send requests, each a COBS framed CBOR map, to
+    _request(), and are sent COBS framed CBOR (_encode())
+    """
+
+    def received(self, conn, data):
+        if not hasattr(conn, "requests"):
+            cbor_decode = CborDecode()
+            conn.requests = chain([CobsDecode(), cbor_decode])
+            cbor_decode.on_data = lambda req: (
+                self._request(conn, req) if isinstance(req, dict) else None
+            )
+        conn.requests(data)
+
+    def _request(self, conn, req):
+        pass
+
+    def _encode(self, item):
+        return b"\x00" + cobs.enc(cbor2.dumps(item)) + b"\x00"
+
+
+class LogPortServer(RequestPortServer):
+    """
+    The log port.  Clients get each log record as a COBS framed CBOR array,
+    by default the text tuple (see LogRecord).  A client that sends the CBOR
+    frame {"format": "binary"} gets records in their compact binary form
+    (n, ts, target, addr, args) instead, and each app hash the target
+    announces (64 bytes), to decode for itself (LogClient binary=True).  A
+    client that sends {"filter": {...}} only gets the records that pass it
+    (see LogFilter), and {"filter": None} drops the filter.  A record is only
+    formatted if a text client wants it, and once however many there are.
+
+    The clients a call site's records go to, with the argument predicates
+    each still has to test, are worked out on its first record and kept
+    until a client connects, leaves or changes its filter, so a record only
+    costs anything for the clients that may want it.
+    """
+
+    def __init__(self, loop, addr):
+        super().__init__(loop, addr)
+        self.last_hash = None
+        # tables -> {call site: [(client, predicates)]}, None for records
+        # that aren't LogRecords
+        self.routes = {}
+
+    def _accept(self, sock, mask):
+        super()._accept(sock, mask)
+        self.routes = {}
+
+    def closed(self, conn):
+        super().closed(conn)
+        self.routes = {}
+
+    def _request(self, conn, req):
+        if "filter" in req:
+            try:
+                conn.filter = LogFilter(req["filter"]) if req["filter"] else None
+                self.routes = {}
+            except (ValueError, TypeError) as e:
+                logging.warning(f"log port: {e}")
+        if req.get("format") in ("text", "binary"):
+            conn.binary = req["format"] == "binary"
+            if conn.binary and self.last_hash is not None:
+                conn.send(self._encode(self.last_hash))
+
+    def app_hash(self, app_hash):
+        self.last_hash = app_hash
+        data = None
+        for c in list(self.clients):
+            if getattr(c, "binary", False):
+                data = data or self._encode(app_hash)
+                c.send(data)
+
+    def _route(self, tables, addr, kind, fmt):
+        route = []
+        for c in self.clients:
+            f = getattr(c, "filter", None)
+            preds = f.site(tables, addr, kind, fmt) if f is not None else []
+            if preds is not None:
+                route.append((c, preds))
+        return route
+
+    def __call__(self, record):
+        if isinstance(record, LogRecord):
+            tables, addr, kind, fmt = record.site()
+        else:
+            tables, addr, kind, fmt = None, None, None, None
+        routes = self.routes.get(tables)
+        if routes is None:
+            # Records only come from one image's tables at a time
+            if tables is not None:
+                self.routes = {t: r for t, r in self.routes.items() if t is None}
+            routes = self.routes[tables] = {}
+        route = routes.get(addr)
+        if route is None:
+            route = routes[addr] = self._route(tables, addr, kind, fmt)
+        text = binary = None
+        for c, preds in route:
+            if preds and not LogFilter.test(record, preds):
+                continue
+            if not getattr(c, "binary", False):
+                text = text or self._encode(tuple(record))
+                c.send(text)
+            else:
+                if binary is None:
+                    raw = record.raw() if isinstance(record, LogRecord) else record
+                    binary = self._encode(tuple(raw))
+                c.send(binary)
+
+
+class LogStatsServer(RequestPortServer):
+    """
+    The call site statistics port (see logstats.py).  A client sends
+
+      {"query": {"callsites": [ID or "file:line", ...], "quantiles": [q, ...]}}
+
+    (both optional) for one snapshot, or {"every": seconds, "query": {...}}
+    for a snapshot that often (checked once a second) until it sends
+    {"every": 0}.
+    """
+
+    def __init__(self, loop, addr, stats):
+        super().__init__(loop, addr)
+        self.stats = stats
+        self.loop.call_later(1, self._tick, 1)
+
+    def _request(self, conn, req):
+        query = req.get("query") or {}
+        try:
+            args = {
+                "callsites": set(query.get("callsites") or ()),
+                "quantiles": [float(q) for q in query.get("quantiles") or QUANTILES],
+            }
+        except (TypeError, ValueError):
+            logging.warning(f"stats port: bad query {query!r}")
+            return
+        if "every" in req:
+            every = req["every"]
+            conn.every = every if isinstance(every, (int, float)) and every > 0 else 0
+            conn.query = args
+            conn.next = time.time()
+            self._tick()
+        else:
+            conn.send(self._encode(self.stats.snapshot(**args)))
+
+    def _tick(self):
+        now = time.time()
+        for c in list(self.clients):
+            if getattr(c, "every", 0) and now >= c.next:
+                c.next = now + c.every
+                c.send(self._encode(self.stats.snapshot(**c.query)))
 
 
 class Serial(threading.Thread):
@@ -390,6 +1740,145 @@ class Serial(threading.Thread):
                         pass
 
 
+class LoopSerial(Serial):
+    """
+    Serial device serviced by an EventLoop rather than its own thread.
+    Reads whatever is buffered in one call instead of a byte at a time.
+
+    selectors can't wait on a serial port on Windows, so there a thread
+    reads the port and hands the data to the loop with call_soon().  Writes
+    are made on the loop thread in order; the STLINK work around's pause is
+    a timer rather than a sleep so the loop keeps serving sockets (the
+    write itself still blocks until pyserial has queued the data).
+    """
+
+    def __init__(self, loop, dev, baudrate, status_change_cb=None):
+        Serial.__init__(self, dev, baudrate, status_change_cb)
+        self.loop = loop
+        self.selectable = os.name == "posix"
+        self.timeout = 0 if self.selectable else 0.1
+        self.serial.timeout = self.timeout
+        self.fd = None
+        self.reader = None
+        self.tx = collections.deque()
+        self.tx_paused = False
+
+    def start(self):
+        self.loop.call_soon(self._start)
+
+    def _start(self):
+        self._watch()
+        self.loop.call_later(0.5, self._pulse, 0.5)
+
+    def _watch(self):
+        if self.selectable:
+            self.fd = self.serial.fileno()
+            self.loop.register(self.fd, selectors.EVENT_READ, self._ready)
+        else:
+            self.reader = threading.Thread(
+                target=self._read_thread, args=(self.serial,), daemon=True
+            )
+            self.reader.start()
+
+    def is_alive(self):
+        return self.loop.is_alive()
+
+    def shutdown(self):
+        # Called after the loop has stopped
+        self.alive = False
+        self.serial.close()
+        if self.reader is not None:
+            self.reader.join(1)
+
+    def __call__(self, data):
+        if threading.current_thread() is self.loop:
+            self._send(data)
+        else:
+            self.loop.call_soon(self._send, data)
+
+    def _send(self, data):
+        self.tx.append(data)
+        if not self.tx_paused:
+            self._flush()
+
+    def _flush(self):
+        while self.tx:
+            data = self.tx.popleft()
+            self.last_send = time.time()
+            # STLINK work around, see Serial.__call__
+            if len(data) % 8 == 0:
+                if len(data) - 1 != self.serial.write(data[:-1]):
+                    logging.error("Error sending cmd to target")
+                self.tx.appendleft(data[-1:])
+                self.tx_paused = True
+                self.loop.call_later(0.01, self._resume)
+                return
+            if len(data) != self.serial.write(data):
+                logging.error("Error sending cmd to target")
+
+    def _resume(self):
+        self.tx_paused = False
+        if self.alive and self.serial.is_open:
+            self._flush()
+
+    def _pulse(self):
+        if self.alive and self.serial.is_open:
+            try:
+                self.send_pulse()
+            except (serial.serialutil.SerialException, OSError):
+                pass
+
+    def _data(self, c):
+        if self.on_data:
+            self.on_data(c)
+        else:
+            print(f"dropped (no on_data): {c.hex()}")
+
+    def _ready(self, fd, mask):
+        try:
+            c = self.serial.read(max(1, self.serial.in_waiting))
+        except (serial.serialutil.SerialException, OSError):
+            self._lost()
+            return
+        if len(c) > 0:
+            self._data(c)
+
+    def _read_thread(self, port):
+        while self.alive:
+            try:
+                c = port.read(max(1, port.in_waiting))
+            except Exception:
+                # The port has gone, or shutdown() closed it under the read
+                if self.alive:
+                    self.loop.call_soon(self._lost)
+                return
+            if len(c) > 0:
+                self.loop.call_soon(self._data, c)
+
+    def _lost(self):
+        print("connection lost ...", end="", flush=True)
+        if self.selectable:
+            self.loop.unregister(self.fd)
+        self.serial.close()
+        self.tx.clear()
+        self.set_target_status(target_online=False)
+        self.loop.call_later(0.1, self._reconnect)
+
+    def _reconnect(self):
+        if not self.alive:
+            return
+        try:
+            self.serial = serial.Serial(
+                self.dev, baudrate=self.baudrate, stopbits=1, timeout=self.timeout
+            )
+        except (serial.serialutil.SerialException, OSError):
+            self.loop.call_later(0.1, self._reconnect)
+            return
+        print("\r... connection restored", flush=True)
+        self.set_target_status(target_online=True, target_device=self.dev)
+        self._watch()
+
+
 # Utitlity to chain a list of processes together
 def chain(items):
     for src, dst in zip(items[:-1], items[1:], strict=True):
@@ -438,13 +1927,14 @@ class Target(threading.Thread):
         threading.Thread.__init__(self)
         self.threads = {}
         self.alive = True
-        self.threads["serial"] = Serial(
-            target, baudrate, status_change_cb=status_change_cb
-        )
+        self.threads["serial"] = self.make_serial(target, baudrate, status_change_cb)
         self.init()
         self.threads["serial"].start()  # needs to be after self.init()
         self.start()
 
+    def make_serial(self, target, baudrate, status_change_cb):
+        return Serial(target, baudrate, status_change_cb=status_change_cb)
+
     def init(self):
         pass
 
@@ -485,47 +1975,194 @@ class Target(threading.Thread):
 
 
 class LogServer(Target):
-    def __init__(self, target, hostport, decoders, baudrate=DEFAULT_BR, display=None):
+    def __init__(
+        self,
+        target,
+        hostport,
+        decoders,
+        baudrate=DEFAULT_BR,
+        display=None,
+        cache=None,
+        capture=None,
+        reliable=(),
+        crc=0,
+        compress=False,
+        callsite_ids=False,
+        stats=None,
+        stats_file=None,
+        stats_period=LOG_STATS_PERIOD,
+        max_frame=LOG_MAX_MESSAGE_SIZE,
+    ):
         self.hostport = hostport
         self.decoders = decoders
         self.display = display
+        # LogStats of the records, served on the stats port and appended to
+        # stats_file as JSON lines every stats_period seconds
+        self.stats = stats
+        self.stats_file = open(stats_file, "a") if stats_file else None
+        self.stats_period = stats_period
+        self.cache = cache
+        self.capture = capture
+        self.reliable = set(reliable)
+        self.crc = crc
+        self.cobs_decode = CobsDecode(max_frame)
+        self.crc_decode = CrcDecode(crc)
+        self.callsite_ids = callsite_ids
+        self.log_expand = LogExpand(callsite_ids) if compress else None
+        self.frag_mux = FragMux({}, {})
+        self.reported = None
+        self.loop = EventLoop()
         Target.__init__(self, target, baudrate)
 
+    def make_serial(self, target, baudrate, status_change_cb):
+        return LoopSerial(self.loop, target, baudrate, status_change_cb)
+
+    def shutdown(self):
+        # Stop the loop first so the ports/serial can be closed from here
+        self.loop.shutdown()
+        super().shutdown()
+        if self.capture:
+            self.capture.close()
+        if self.stats_file:
+            self._write_stats()
+            self.stats_file.close()
+        self._report()
+
+    def metrics(self):
+        """
+        Frames received from the target and the link errors seen since start
+        """
+        return {
+            "frames": self.crc_decode.frames,
+            "crc_errors": self.crc_decode.crc_errors,
+            "resyncs": self.crc_decode.resyncs,
+            "cobs_errors": self.cobs_decode.errors,
+            "overruns": self.cobs_decode.overruns,
+            "frag_crc_errors": self.frag_mux.crc_errors,
+            "log_lost": self.log_expand.lost if self.log_expand else 0,
+        }
+
+    def link_report(self):
+        """
+        metrics() as one line, None if there have been no link errors
+        """
+        m = self.metrics()
+        if not any(v for k, v in m.items() if k != "frames"):
+            return None
+        return "target link: " + ", ".join(f"{k} {v}" for k, v in m.items())
+
+    def _write_stats(self):
+        snapshot = dict(self.stats.snapshot(), time=time.time())
+        self.stats_file.write(json.dumps(snapshot, default=json_default) + "\n")
+        self.stats_file.flush()
+
+    def _report(self):
+        # Logged when the error counts change
+        errors = {k: v for k, v in self.metrics().items() if k != "frames"}
+        if errors != self.reported:
+            self.reported = errors
+            report = self.link_report()
+            if report:
+                logging.warning(report)
+
     def init(self):
         try:
             host, port = self.hostport
             self.threads.update(
-                {i: Server((host, port + i + 1)) for i in range(LOG_PORT_MAX)}
+                {
+                    i: FramePortServer(self.loop, (host, port + i + 1))
+                    for i in range(LOG_PORT_MAX)
+                }
             )
             self.rx = {
                 i: chain([CobsEncode(), self.threads[i]]) for i in range(LOG_PORT_MAX)
             }
+            # Large messages in either direction, and every message on a
+            # reliable port, are fragmented.  Slow subscribers hold back the
+            # target (no credits) and a slow target stops the clients being
+            # read, rather than frames being dropped.
+            frag_tx = chain(
+                [CrcEncode(self.crc), CobsEncode(), self.threads["serial"]]
+            )
+            receivers = {}
+            senders = {}
+            # The link frame check, if on, stands in for the fragment CRC
+            frag_crc = not self.crc
+            for i in range(LOG_PORT_MAX):
+                ps = self.threads[i]
+                receivers[i] = FragReceiver(i, frag_tx, crc=frag_crc)
+                receivers[i].on_data = self.rx[i]
+                if i in self.reliable:
+                    # Plain frames can't be trusted (no CRC) - e.g. a
+                    # fragment with a corrupted type
+                    self.rx[i] = lambda frame, i=i: logging.warning(
+                        f"port {i} is reliable - dropped unfragmented frame"
+                    )
+                receivers[i].busy = lambda ps=ps: ps.backlog() > LOG_CLIENT_QUEUE // 2
+                ps.on_drain = receivers[i].resume
+                senders[i] = FragSender(self.loop, i, crc=frag_crc)
+                senders[i].on_data = frag_tx
+                senders[i].on_queue = lambda n, ps=ps: ps.pause(n > LOG_CLIENT_QUEUE)
+            self.frag_mux = FragMux(receivers, senders, crc=frag_crc)
+            self.rx["frag"] = self.frag_mux
             self.tx = {
                 i: chain(
                     [
                         self.threads[i],
-                        CobsDecode(),
-                        MuxEncode(i),
+                        PortEncode(i, senders[i], i in self.reliable),
+                        CrcEncode(self.crc),
                         CobsEncode(),
                         self.threads["serial"],
                     ]
                 )
                 for i in range(LOG_PORT_MAX)
             }
+            records = getattr(self.display, "records", False)
+            log_decode = LogDecode(self.decoders, self.cache, records=records)
+            self.rx["hash"] = log_decode.set_app_hash
             if self.display:
-                self.rx["log"] = chain([LogDecode(self.decoders), self.display])
+                sink = self.display
             else:
-                self.threads["log"] = Server((host, port))
-                self.rx["log"] = chain(
-                    [
-                        LogDecode(self.decoders),
-                        CborEncode(),
-                        CobsEncode(),
-                        self.threads["log"],
-                    ]
+                # Records are formatted, if at all, by the port
+                self.threads["log"] = LogPortServer(self.loop, (host, port))
+                sink = self.threads["log"]
+
+                def on_hash(app_hash):
+                    log_decode.set_app_hash(app_hash)
+                    self.threads["log"].app_hash(app_hash)
+
+                self.rx["hash"] = on_hash
+            if self.stats is not None:
+                self.threads["stats"] = LogStatsServer(
+                    self.loop, (host, port + LOG_STATS_PORT + 1), self.stats
                 )
 
-            self.rx = chain([self.threads["serial"], CobsDecode(), MuxDecode(self.rx)])
+                def stats_sink(record, stats=self.stats, sink=sink):
+                    # Statistics must never stop records being forwarded
+                    sink(record)
+                    try:
+                        stats(record)
+                    except Exception:
+                        logging.error("exception ", exc_info=1)
+
+                sink = stats_sink
+                if self.stats_file:
+                    self.loop.call_later(
+                        self.stats_period, self._write_stats, self.stats_period
+                    )
+            self.rx["log"] = chain([log_decode, sink])
+
+            # Captures hold checked, expanded frames - as with neither
+            self.rx = chain(
+                [self.threads["serial"], self.cobs_decode, self.crc_decode]
+                + ([self.log_expand] if self.log_expand else [])
+                + ([self.capture] if self.capture else [])
+                + [MuxDecode(self.rx, self.callsite_ids)]
+            )
+            self.loop.call_later(
+                LOG_METRICS_PERIOD, self._report, LOG_METRICS_PERIOD
+            )
+            self.loop.start()
             super().init()
         except Exception as e:
             self.shutdown()
@@ -533,10 +2170,23 @@ class LogServer(Target):
 
 
 class LogClient(threading.Thread):
-    def __init__(self, hostport, rx):
+    """
+    Client of a LogServer's ports.  With binary the log port sends records
+    in their binary form, decoded here with decoders and cache, and with
+    filter (a LogFilter map) only the records that pass it (see
+    LogPortServer).
+    """
+
+    def __init__(
+        self, hostport, rx, binary=False, decoders=None, cache=None, filter=None
+    ):
         threading.Thread.__init__(self)
         self.hostport = hostport
         self.rx = rx
+        self.binary = binary
+        self.filter = filter
+        self.decoders = decoders or {}
+        self.cache = cache
         self.alive = True
         self.init()
         self.start()
@@ -562,14 +2212,22 @@ class LogClient(threading.Thread):
             }
             rx = self.rx.copy()
             self.rx = {
-                i: chain([self.threads[i], CobsDecode(), v])
+                i: chain([self.threads[i], CobsDecode(LOG_MAX_MESSAGE_SIZE), v])
                 for i, v in rx.items()
                 if i not in ["log"]
             }
             if "log" in rx:
                 self.threads["log"] = Client((host, port))
+                records = getattr(rx["log"], "records", False)
+                redecode = (
+                    [LogRedecode(self.decoders, self.cache, records)]
+                    if self.binary
+                    else []
+                )
                 self.rx["log"] = chain(
-                    [self.threads["log"], CobsDecode(), CborDecode(), rx["log"]]
+                    [self.threads["log"], CobsDecode(), CborDecode()]
+                    + redecode
+                    + [rx["log"]]
                 )
 
             start = time.time()
@@ -579,6 +2237,13 @@ class LogClient(threading.Thread):
                 time.sleep(0.1)
             if not self.ready():
                 raise Exception("unable to connect to service")
+            req = {}
+            if self.binary:
+                req["format"] = "binary"
+            if self.filter:
+                req["filter"] = self.filter
+            if "log" in rx and req:
+                chain([CborEncode(), CobsEncode(), self.threads["log"]])(req)
             logging.debug(
                 f"took {time.time() - start:10.3f} to connect to server: {self.hostport}"
             )
@@ -612,21 +2277,46 @@ class LogClient(threading.Thread):
 
 
 class LogClientServer(Target):
-    def __init__(self, target, decoders, rx):
+    def __init__(
+        self,
+        target,
+        decoders,
+        rx,
+        crc=0,
+        callsite_ids=False,
+        max_frame=LOG_MAX_MESSAGE_SIZE,
+    ):
         self.decoders = decoders
         self.rx = rx
+        self.crc = crc
+        self.max_frame = max_frame
+        self.callsite_ids = callsite_ids
         Target.__init__(self, target)
 
     def start(self):
         try:
             self.tx = {
-                i: chain([MuxEncode(i), CobsEncode(), self.threads["serial"]])
+                i: chain(
+                    [
+                        MuxEncode(i),
+                        CrcEncode(self.crc),
+                        CobsEncode(),
+                        self.threads["serial"],
+                    ]
+                )
                 for i in range(LOG_PORT_MAX)
             }
             rx = self.rx.copy()
             if "log" in rx:
                 self.rx["log"] = chain([LogDecode(self.decoders), rx["log"]])
-            self.rx = chain([self.threads["serial"], CobsDecode(), MuxDecode(self.rx)])
+            self.rx = chain(
+                [
+                    self.threads["serial"],
+                    CobsDecode(self.max_frame),
+                    CrcDecode(self.crc),
+                    MuxDecode(self.rx, self.callsite_ids),
+                ]
+            )
         except Exception as e:
             self.shutdown()
             raise e
@@ -646,7 +2336,8 @@ class StreamClient(object):
     Simple client that only supports single cmd/rsp stream that is cbor coded.
     Stream defaults to 1 - if args.raw, then assumes no log multiplexing.
     Exposes sc.txrx(), sc.tx() and sc.rx() API.
-    Expects args argument to have attributes target, host, raw
+    Expects args argument to have attributes target, host, raw (and crc when
+    connecting to the target directly)
     """
 
     def __init__(self, args, stream=1, cbor_wrap=True):
@@ -678,13 +2369,18 @@ class StreamClient(object):
             self.service = Target(d)
             self.txc = chain([CobsEncode(), self.service.threads["serial"]])
             self.rxc = chain(
-                [self.service.threads["serial"], CobsDecode(), self._ondata]
+                [
+                    self.service.threads["serial"],
+                    CobsDecode(LOG_MAX_MESSAGE_SIZE),
+                    self._ondata,
+                ]
             )
             self.stream = None
             self.service.threads["serial"](b"\x00")
             time.sleep(0.1)
         else:
-            self.service = LogClientServer(d, [], rx)
+            crc = getattr(self.args, "crc", 0)
+            self.service = LogClientServer(d, [], rx, crc)
         self.queue = queue.Queue()
         return self
 
@@ -744,6 +2440,62 @@ def decoders(fnames):
     return {d.target(): d for d in dec}
 
 
+def stats_query(hostport, query, every=None):
+    """
+    Prints call site statistics from a LogServer's stats port as JSON lines
+    - one snapshot, or one every so many seconds until interrupted
+    """
+    host, port = hostport
+    req = {"query": query}
+    if every:
+        req["every"] = every
+    with socket.create_connection((host, port + LOG_STATS_PORT + 1)) as sock:
+        sock.sendall(b"\x00" + cobs.enc(cbor2.dumps(req)) + b"\x00")
+        buf = b""
+        try:
+            while True:
+                data = sock.recv(65536)
+                if not data:
+                    return
+                *frames, buf = (buf + data).split(b"\x00")
+                for f in frames:
+                    if f:
+                        snapshot = cbor2.loads(cobs.dec(f))
+                        print(json.dumps(snapshot, default=json_default), flush=True)
+                        if not every:
+                            return
+        except KeyboardInterrupt:
+            pass
+
+
+def where(s):
+    """
+    --where "field op value" as a LogFilter argument predicate - value is a
+    number if it reads as one, and ~ is a glob
+    """
+    m = re.fullmatch(r"\s*(\w+)\s*(==|!=|<=|>=|<|>|=|~)\s*(.*?)\s*", s)
+    if m is None:
+        raise argparse.ArgumentTypeError(f"bad predicate {s!r}")
+    name, op, value = m.groups()
+    op = {"=": "==", "~": "glob"}.get(op, op)
+    if op == "glob":
+        return [name, op, value]
+    for conv in (lambda x: int(x, 0), float):
+        try:
+            return [name, op, conv(value)]
+        except ValueError:
+            pass
+    return [name, op, value]
+
+
+def callsite(s):
+    # Call site ID, or file:line
+    try:
+        return int(s, 0)
+    except ValueError:
+        return s
+
+
 if __name__ == "__main__":
     parser = argparse.ArgumentParser("LOG server/viewer")
     parser.add_argument("--target", help="use serial interface when connecting")
@@ -754,24 +2506,169 @@ if __name__ == "__main__":
     parser.add_argument("-s", action="store_true", help="server only mode")
     parser.add_argument("-c", action="store_true", help="client")
     parser.add_argument("-e", action="append", help="ELF to use for decoding")
+    parser.add_argument(
+        "--cache-size",
+        type=int,
+        default=8,
+        help="number of decoders from ~/.cache/uclog to keep loaded (0 disables)",
+    )
+    parser.add_argument("--capture", help="record raw target frames to file")
+    parser.add_argument(
+        "--zstd", action="store_true", help="zstd compress the capture file"
+    )
+    parser.add_argument("--replay", help="decode a capture file and exit")
+    parser.add_argument(
+        "--reliable",
+        type=lambda x: [int(p) for p in x.split(",")],
+        default=[],
+        help="comma separated ports to send as acknowledged fragments",
+    )
+    parser.add_argument(
+        "--crc",
+        type=int,
+        choices=LOG_CRC_BITS,
+        default=0,
+        help="frame check bits (target CONFIG_UC_LOG_CRC16/32)",
+    )
+    parser.add_argument(
+        "--compress",
+        action="store_true",
+        help="expand compressed log messages (target CONFIG_UC_LOG_COMPRESS)",
+    )
+    parser.add_argument(
+        "--callsite-ids",
+        action="store_true",
+        help="call sites sent as indices (target CONFIG_UC_LOG_CALLSITE_ID)",
+    )
+    parser.add_argument(
+        "--max-frame",
+        type=int,
+        default=LOG_MAX_MESSAGE_SIZE,
+        help="largest frame (streamed reply) taken from the target, in bytes",
+    )
+    parser.add_argument(
+        "--binary",
+        action="store_true",
+        help="client: get log records from the server undecoded and decode here",
+    )
+    parser.add_argument("--level", help="client: lowest level to get, e.g. WARN")
+    parser.add_argument("--file", help="client: only from source files matching")
+    parser.add_argument(
+        "--callsite",
+        action="append",
+        help="client: only from the call site (ID or file:line), also for --stats",
+    )
+    parser.add_argument(
+        "--where",
+        action="append",
+        type=where,
+        default=[],
+        help="client: only with the argument matching, e.g. 'mv>=3300'",
+    )
+    parser.add_argument(
+        "--stats",
+        action="store_true",
+        help="keep call site statistics (stats port), print them with -c or "
+        "--replay",
+    )
+    parser.add_argument(
+        "--stats-file", help="append call site statistics to file as JSON lines"
+    )
+    parser.add_argument(
+        "--stats-period",
+        type=float,
+        help=f"seconds between --stats-file (default {LOG_STATS_PERIOD}) or -c "
+        "--stats snapshots",
+    )
+    parser.add_argument(
+        "--json",
+        action="store_true",
+        help="print records as JSON lines of typed fields rather than text",
+    )
+    parser.add_argument(
+        "--start", type=float, help="replay from seconds after capture start"
+    )
+    parser.add_argument(
+        "--end", type=float, help="replay until seconds after capture start"
+    )
 
     args = parser.parse_args()
-    if args.s:
+    cache = LogDataCache(size=args.cache_size) if args.cache_size > 0 else None
+    capture = CaptureWriter(args.capture, args.zstd) if args.capture else None
+    display = LogJsonDisplay() if args.json else LogDisplay()
+    callsites = [callsite(c) for c in args.callsite or []]
+    stats = None
+    if args.stats or args.stats_file:
+        stats = LogStats(None if args.replay else time.time)
+    if args.replay:
+        replay(
+            args.replay,
+            decoders(args.e),
+            cache,
+            args.start,
+            args.end,
+            stats if args.stats else display,
+            callsite_ids=args.callsite_ids,
+        )
+        if args.stats:
+            snapshot = stats.snapshot(callsites)
+            print(json.dumps(snapshot, default=json_default, indent=2))
+        exit(0)
+    elif args.c and args.stats:
+        stats_query(hostport(args.host), {"callsites": callsites}, args.stats_period)
+        exit(0)
+    elif args.s:
         o = LogServer(
             target(args.target),
             hostport(args.host),
             decoders(args.e),
             baudrate=args.baudrate,
+            cache=cache,
+            capture=capture,
+            reliable=args.reliable,
+            crc=args.crc,
+            compress=args.compress,
+            callsite_ids=args.callsite_ids,
+            stats=stats,
+            stats_file=args.stats_file,
+            stats_period=args.stats_period or LOG_STATS_PERIOD,
+            max_frame=args.max_frame,
         )
     elif args.c:
-        o = LogClient(hostport(args.host), {"log": LogDisplay()})
+        o = LogClient(
+            hostport(args.host),
+            {"log": display},
+            binary=args.binary,
+            decoders=decoders(args.e) if args.binary else None,
+            cache=cache,
+            filter={
+                k: v
+                for k, v in [
+                    ("level", args.level),
+                    ("file", args.file),
+                    ("callsites", callsites),
+                    ("args", args.where),
+                ]
+                if v
+            },
+        )
     else:
         o = LogServer(
             target(args.target),
             hostport(args.host),
             decoders(args.e),
-            display=LogDisplay(),
+            display=display,
             baudrate=args.baudrate,
+            cache=cache,
+            capture=capture,
+            reliable=args.reliable,
+            crc=args.crc,
+            compress=args.compress,
+            callsite_ids=args.callsite_ids,
+            stats=stats,
+            stats_file=args.stats_file,
+            stats_period=args.stats_period or LOG_STATS_PERIOD,
+            max_frame=args.max_frame,
         )
     try:
         while True:
@@ -782,3 +2679,6 @@ if __name__ == "__main__":
         logging.error("exception ", exc_info=1)
     finally:
         o.shutdown()
+        report = o.link_report() if isinstance(o, LogServer) else None
+        if report:
+            print(report)